@@ -1,14 +1,29 @@
 #include "Animation.h"
 #include "FreeStack.h"
 #include "csv_helpers.h"
+#include "FrameGenerator.h"
+#include "MotionTrack.h"
+#include "Catalog.h"
 #include <string.h>
 
 File sdFile;
+
 //Constructor
-Frame::Frame(uint16_t *duty_cycle, int cols, int rows)
+/*
+\brief Constructor
+
+\param duty_cycle Array of cols*rows pixel intensities, row by row. A zeroed array is allocated if this is nullptr. Default = nullptr
+\param cols The number of columns in the frame. Default = COLS
+\param rows The number of rows in the frame. Default = ROWS
+\param borrow_duty_cycle If true, the frame does not take ownership of "duty_cycle" and will not delete it. 
+    Used when many frames are stored in one shared array (e.g. SpriteAtlas). Default = false
+*/
+Frame::Frame(uint16_t *duty_cycle, int cols, int rows, bool borrow_duty_cycle)
 {
     _cols = cols;
     _rows = rows;
+    _reset_view();
+    _owns_duty_cycle = (duty_cycle == nullptr) || !borrow_duty_cycle;
     if (duty_cycle == nullptr)
     {
         int tolerance = 10000;
@@ -60,22 +75,63 @@ Frame* Frame::get_copy_of_frame()
             new_duty_cycle[y * _cols + x] = this->get_pixel_intensity_at(x, y);
         }
     }
-    return new Frame(new_duty_cycle,_cols,_rows);
+    Frame *copy = new Frame(new_duty_cycle,_cols,_rows);
+    copy->write_duration(_duration);
+    return copy;
+}
+/*
+*  Returns a view of this frame: a new Frame that shares the pixels of this frame
+*  but reads (and writes) them mirrored and/or moved by (offset_x, offset_y).
+*  Pixels that are moved outside of the frame are dropped, and the pixels that are
+*  uncovered read as zero. No pixels are copied, so a view only costs the Frame object itself.
+*
+*  The view is only valid as long as the frame it was made from is. 
+*  Deleting the view does not delete the pixels it borrows.
+*/
+Frame *Frame::get_view(FrameTransform transform, int offset_x, int offset_y)
+{
+    Frame *view = new Frame(_duty_cycle, _cols, _rows, true);
+    view->_duration = _duration;
+    view->_view_of = this;
+
+    bool mirror_x = (transform == TRANSFORM_MIRROR_X || transform == TRANSFORM_ROTATE_180);
+    bool mirror_y = (transform == TRANSFORM_MIRROR_Y || transform == TRANSFORM_ROTATE_180);
+    view->_layout = frame_layout_view(_layout, _cols, _rows, mirror_x, mirror_y, offset_x, offset_y);
+    return view;
+}
+// True for frames made by get_view(). Frames that borrow their pixels (e.g. atlas sprites) are not views
+bool Frame::is_view()
+{
+    return _view_of != nullptr;
 }
 // Public Methods
 void Frame::delete_frame(void)
 {
     _delete_duty_cycle();
 }
+/*
+*  Returns the stored pixels of this frame. For views this is the
+*  untransformed storage of the frame they were made from,
+*  use copy_pixel_intensities_to() to get the pixels as the view sees them.
+*/
 uint16_t *Frame::get_pixel_intensities()
 {
     return _duty_cycle;
 }
+/*
+*  Writes the pixels of this frame, as seen through any view transform, 
+*  to "output" (row by row, _cols*_rows values).
+*/
+void Frame::copy_pixel_intensities_to(uint16_t *output)
+{
+    frame_layout_copy(_layout, _duty_cycle, _cols, _rows, output);
+}
 uint16_t Frame::get_pixel_intensity_at(int x, int y)
 {
-    if (x < _cols && x >= 0 && y < _rows && y >= 0)
+    int idx = _index_of(x, y);
+    if (idx >= 0)
     {
-        return _duty_cycle[y*_cols + x];
+        return _duty_cycle[idx];
     }
     return 0; //This means that any Frame is technically infinitely large (surrounded by zeros). Used when merging together frames.
 }
@@ -84,11 +140,18 @@ void Frame::overwrite_pixel_intensities(uint16_t *duty_cycle)
 {
     _delete_duty_cycle();
     _duty_cycle = duty_cycle;
+    //The new pixels belong to this frame, so it is no longer a view
+    _owns_duty_cycle = true;
+    _view_of = nullptr;
+    _reset_view();
+    _power_valid = false; //get_revision() no longer comes from the frame it was a view of
+    mark_modified();
 }
 
 void Frame::write_pixel_intensity_at(int x, int y, uint16_t duty_cycle)
 {
-    if (x < _cols && x >= 0 && y < _rows && y >= 0)
+    int idx = _index_of(x, y);
+    if (idx >= 0)
     {
         if (duty_cycle > DUTY_CYCLE_RESOLUTION)
         {
@@ -97,75 +160,232 @@ void Frame::write_pixel_intensity_at(int x, int y, uint16_t duty_cycle)
         if(duty_cycle < 0){
             duty_cycle = 0;
         }
-        _duty_cycle[x + y * _cols] = duty_cycle;
+        _duty_cycle[idx] = duty_cycle;
+        mark_modified();
     }// if the coordinates are outside of the frame, ignore them. TODO: return an error message if necessary.
 }
 
 void Frame::merge_pixel_intensity_at(int x, int y, uint16_t other_pixel_intensity){
+    int idx = _index_of(x, y);
+    if (idx < 0)
+    {
+        return; //Pixels outside of this frame are ignored
+    }
     //Merge is done by adding together the two duty cycle values for now.
-    uint16_t new_pixel_intensity = this->get_pixel_intensity_at(x,y) + other_pixel_intensity;
-    //this->write_pixel_intensity_at(x,y,new_pixel_intensity); //We don't want to max out the pixel intensity at 4096 because going past that value means we can "unmerge" frames by subracting them from each other.
-    if (new_pixel_intensity < 0)
+    //We don't want to max out the pixel intensity at 4096 because going past that value means we can "unmerge" frames by subracting them from each other.
+    //The same blend as merge_with_frame(), so merging pixel by pixel gives the same result.
+    _duty_cycle[idx] = BlendAdd()(_duty_cycle[idx], other_pixel_intensity);
+    mark_modified();
+}
+
+/*
+*  Places the other frame inside this one with the offset given by "other_bottom_left" coordinates,
+*  combining the pixels they share with "mode" (see BlendModes.h). "weight" is only used by
+*  BLEND_WEIGHTED: the share of "other" in the result, DUTY_CYCLE_RESOLUTION being only "other".
+*/
+void Frame::merge_with_frame(int other_bottom_left_x, int other_bottom_left_y, Frame *other, BlendMode mode, uint16_t weight){
+    int rtn = blend_frames_with_mode(_duty_cycle, _layout, _cols, other->_duty_cycle, other->_layout, other->_cols,
+                                     other_bottom_left_x, other_bottom_left_y, mode, weight);
+    if (rtn > 0)
     {
-        new_pixel_intensity = 0;
+        mark_modified();
+    }
+    else if (rtn < 0)
+    {
+        Serial.printf("Unknown blend mode: %d\n", mode);
     }
-    _duty_cycle[x + y * _cols] = new_pixel_intensity;
 }
 
-void Frame::merge_with_frame(int other_bottom_left_x, int other_bottom_left_y, Frame *other){
-    uint16_t other_pixel_intensity;
-    //Iterate through the other frame and place it inside this one with the offset given by "other_bottom_left" coordinates.
-    for (int x = 0; x < other->get_width(); x++)
+/*
+*  Like merge_with_frame(), but the position is given in 1/16 pixels (Q4) and every pixel of "other"
+*  is multiplied by scale/MOTION_SCALE_ONE first. When the position is between pixels,
+*  every pixel of "other" is shared between the four pixels it covers, weighted by how much of
+*  it each one covers, so that slow movement looks smooth. The shares always add up to the
+*  scaled pixel, so the total intensity stays the same at any position.
+*/
+void Frame::merge_with_frame_scaled(int other_bottom_left_x_q4, int other_bottom_left_y_q4, Frame *other, uint16_t scale)
+{
+    int x = floor_div(other_bottom_left_x_q4, Q4_ONE);
+    int y = floor_div(other_bottom_left_y_q4, Q4_ONE);
+    uint32_t fx = other_bottom_left_x_q4 - x * Q4_ONE;
+    uint32_t fy = other_bottom_left_y_q4 - y * Q4_ONE;
+    if (fx == 0 && fy == 0 && scale == MOTION_SCALE_ONE)
+    {
+        _blend_frame(x, y, other, BlendAdd());
+        return;
+    }
+    //Shares of the right, top and top right neighbours, in 1/256
+    const uint32_t w_right = fx * (Q4_ONE - fy);
+    const uint32_t w_top = (Q4_ONE - fx) * fy;
+    const uint32_t w_top_right = fx * fy;
+    for (int oy = 0; oy < other->_rows; oy++)
     {
-        for (int y = 0; y < other->get_height(); y++)
+        for (int ox = 0; ox < other->_cols; ox++)
         {
-            other_pixel_intensity = other->get_pixel_intensity_at(x, y);
-            if (other_pixel_intensity > 0)
+            uint32_t value = ((uint32_t)other->get_pixel_intensity_at(ox, oy) * scale) >> 12;
+            if (value == 0)
             {
-                // This will cause a change, therefore merge in the pixel.
-                this->merge_pixel_intensity_at(x + other_bottom_left_x, y + other_bottom_left_y, other_pixel_intensity);
-            }//else: no change. Ignore this pixel
+                continue;
+            }
+            if (value > UINT16_MAX)
+            {
+                value = UINT16_MAX; //Scaled up past what a pixel holds. The shares below are passed on as uint16_t.
+            }
+            uint32_t right = (value * w_right) >> 8;
+            uint32_t top = (value * w_top) >> 8;
+            uint32_t top_right = (value * w_top_right) >> 8;
+            merge_pixel_intensity_at(x + ox, y + oy, value - right - top - top_right);
+            if (right > 0)
+            {
+                merge_pixel_intensity_at(x + ox + 1, y + oy, right);
+            }
+            if (top > 0)
+            {
+                merge_pixel_intensity_at(x + ox, y + oy + 1, top);
+            }
+            if (top_right > 0)
+            {
+                merge_pixel_intensity_at(x + ox + 1, y + oy + 1, top_right);
+            }
         }
     }
 }
 
 void Frame::unmerge_pixel_intensity_at(int x, int y, uint16_t other_pixel_intensity)
 {
-    //Merge is done by adding together the two duty cycle values for now.
-    uint16_t new_pixel_intensity = this->get_pixel_intensity_at(x, y) - other_pixel_intensity;
-    //this->write_pixel_intensity_at(x,y,new_pixel_intensity); //We don't want to max out the pixel intensity at 4096 because going past that value means we can "unmerge" frames by subracting them from each other.
-    if (new_pixel_intensity < 0)
+    int idx = _index_of(x, y);
+    if (idx < 0)
     {
-        new_pixel_intensity = 0;
+        return; //Pixels outside of this frame are ignored
     }
-    _duty_cycle[x + y * _cols] = new_pixel_intensity;
+    _duty_cycle[idx] = BlendUnmerge()(_duty_cycle[idx], other_pixel_intensity);
+    mark_modified();
 }
 
 void Frame::unmerge_frame(int other_bottom_left_x, int other_bottom_left_y, Frame *other)
 {
-    uint16_t other_pixel_intensity;
-    //Iterate through the other frame and place it inside this one with the offset given by "other_bottom_left" coordinates.
-    for (int x = 0; x < other->get_width(); x++)
+    //Remove the other frame from this one, given that it was merged in at the "other_bottom_left" coordinates.
+    _blend_frame(other_bottom_left_x, other_bottom_left_y, other, BlendUnmerge());
+}
+
+int Frame::get_width()
+{
+    return _cols;
+}
+int Frame::get_height()
+{
+    return _rows;
+}
+/*
+*  Returns the number of ticks (calls to Animation::goto_next_frame()) 
+*  this frame is held before the animation moves on to the next frame.
+*/
+uint16_t Frame::get_duration()
+{
+    return _duration;
+}
+void Frame::write_duration(uint16_t ticks)
+{
+    if (ticks < 1)
+    {
+        ticks = 1; //A frame has to be shown for at least one tick
+    }
+    if (ticks != _duration)
+    {
+        _duration = ticks;
+        mark_modified();
+    }
+}
+/*
+*  Returns true if both frames have the same size and pixel intensities.
+*  The duration of the frames is not compared.
+*/
+bool Frame::equals(Frame *other)
+{
+    if (other->get_width() != _cols || other->get_height() != _rows)
+    {
+        return false;
+    }
+    for (int y = 0; y < _rows; y++)
     {
-        for (int y = 0; y < other->get_height(); y++)
+        for (int x = 0; x < _cols; x++)
         {
-            other_pixel_intensity = other->get_pixel_intensity_at(x, y);
-            if (other_pixel_intensity > 0)
+            if (get_pixel_intensity_at(x, y) != other->get_pixel_intensity_at(x, y))
             {
-                // This will cause a change, therefore merge in the pixel.
-                this->unmerge_pixel_intensity_at(x + other_bottom_left_x, y + other_bottom_left_y, other_pixel_intensity);
-            } //else: no change. Ignore this pixel
+                return false;
+            }
         }
     }
+    return true;
 }
 
-int Frame::get_width()
+/*
+*  A frame is modified when its pixels or duration have changed since it was last read from
+*  or saved to the SD card (new frames count as modified). Animation::save_modified_to_SD_card()
+*  only writes the modified frames.
+*  Writes straight into get_pixel_intensities() can not be seen, call mark_modified() after them.
+*/
+bool Frame::is_modified()
 {
-    return _cols;
+    return _modified;
 }
-int Frame::get_height()
+void Frame::mark_modified()
 {
-    return _rows;
+    _modified = true;
+    _revision++;
+    if (_view_of != nullptr)
+    {
+        _view_of->mark_modified(); //The pixels belong to the frame the view was made from
+    }
+}
+void Frame::clear_modified()
+{
+    _modified = false;
+}
+/*
+*  Returns a number that changes every time the pixels or duration of the frame change
+*  (views return the number of the frame they were made from). Used to tell whether
+*  something worked out from the frame earlier is still up to date.
+*/
+uint32_t Frame::get_revision()
+{
+    if (_view_of != nullptr)
+    {
+        return _view_of->get_revision();
+    }
+    return _revision;
+}
+
+/*
+*  Returns how much power the frame draws (see AnimFramePower in AnimationFormat.h).
+*  The pixels are only looked at the first time after the frame has changed, and not at all
+*  for frames read from a data file with a power table.
+*/
+const AnimFramePower *Frame::get_power()
+{
+    if (!_power_valid || _power_revision != get_revision())
+    {
+        if (frame_layout_is_plain(_layout, _cols, _rows))
+        {
+            anim_frame_power(_duty_cycle, _cols, _rows, &_power);
+        }
+        else
+        {
+            uint16_t pixels[_cols * _rows]; //Views are read through their transform
+            copy_pixel_intensities_to(pixels);
+            anim_frame_power(pixels, _cols, _rows, &_power);
+        }
+        _power_valid = true;
+        _power_revision = get_revision();
+    }
+    return &_power;
+}
+//Sets the power of the frame, when it is already known (e.g. from the data file)
+void Frame::write_power(const AnimFramePower *power)
+{
+    _power = *power;
+    _power_valid = true;
+    _power_revision = get_revision();
 }
 
 void Frame::print_to_terminal(int pretty){
@@ -242,10 +462,45 @@ void Frame::print_to_terminal(int pretty){
 
 inline void Frame::_delete_duty_cycle()
 {
-    delete _duty_cycle;
+    if (_owns_duty_cycle)
+    {
+        delete[] _duty_cycle;
+    }
     _duty_cycle = nullptr;
 }
 
+/*
+*  Makes this frame read its own pixels directly (no mirroring or translation).
+*/
+void Frame::_reset_view()
+{
+    _layout = frame_layout(_cols, _rows);
+}
+
+/*
+*  Returns the index in _duty_cycle of pixel (x,y), or -1 if the pixel is outside
+*  of the frame (or, for views, maps to a pixel outside of the borrowed frame).
+*/
+inline int Frame::_index_of(int x, int y)
+{
+    return frame_layout_index(_layout, _cols, x, y);
+}
+
+/*
+*  Blends every pixel of "other" into the pixels of this frame it overlaps (see BlendModes.h).
+*  blend_frames() (FrameLayout.h) only visits the overlapping rectangle, and steps through
+*  the stored pixels of both frames directly so that views cost the same as normal frames.
+*/
+template <typename Blend>
+void Frame::_blend_frame(int other_bottom_left_x, int other_bottom_left_y, Frame *other, Blend blend)
+{
+    if (blend_frames(_duty_cycle, _layout, _cols, other->_duty_cycle, other->_layout, other->_cols,
+                     other_bottom_left_x, other_bottom_left_y, blend))
+    {
+        mark_modified();
+    }
+}
+
 //Constructor
 /*
 \brief Constructor
@@ -286,8 +541,8 @@ Animation::Animation(Frame **frames, int num_frames, int cols, int rows, int ori
 // Public Methods
 void Animation::delete_anim(void)
 {
-    
-    for (int frame = 0; frame < _num_frames; frame++)
+    _delete_generated_frames();
+    for (int frame = 0; _frames != nullptr && frame < _num_frames; frame++)
     {
         _frames[frame]->delete_frame();
     }
@@ -299,18 +554,39 @@ void Animation::delete_anim(void)
         delete _blank_frame;
         _blank_frame = nullptr;
     }
+    delete _limited_frame;
+    _limited_frame = nullptr;
+    _limited_src = nullptr;
+    delete _resampled_frame;
+    _resampled_frame = nullptr;
+    _resampled_src = nullptr;
 }
 
 Frame *Animation::get_frame(int frame_num)
 {
+    if (_generator != nullptr)
+    {
+        return _render_generated_frame(frame_num);
+    }
     return _frames[frame_num];
 }
 void Animation::write_frame(int frame_num, Frame *frame)
 {
+    if (_generator != nullptr)
+    {
+        return; //Generated animations have no stored frames to replace
+    }
     _frames[frame_num] = frame;
+    frame->mark_modified(); //It may have been saved before, but not as this frame of this animation
+    _limited_src = nullptr;
+    _resampled_src = nullptr;
 }
 void Animation::load_frames_from_array(uint16_t **duty_cycle)
 {
+    if (_generator != nullptr)
+    {
+        return;
+    }
     for (int frame = 0; frame < _num_frames; frame++)
     {
         _frames[frame]->overwrite_pixel_intensities(duty_cycle[frame]);
@@ -325,45 +601,90 @@ int Animation::get_current_frame_num()
 int Animation::get_num_frames(){
     return _num_frames;
 }
-
-void Animation::goto_next_frame()
-{
-    if (_current_frame_is_on_edge())
+/*
+*   Returns the number of ticks it takes to play through every frame once,
+*   taking the duration of each frame into account.
+*/
+uint32_t Animation::get_total_duration(){
+    if (_generator != nullptr)
+    {
+        return _num_frames; //Every generated frame is shown for one tick
+    }
+    uint32_t total = 0;
+    for (int f = 0; f < _num_frames; f++)
     {
-        //Current frame IS on the edge
-        switch (_playback_type)
+        total += _frames[f]->get_duration();
+    }
+    return total;
+}
+/*
+*   Replaces runs of identical frames with a single frame that is held for the 
+*   combined duration of the run. Playback looks the same afterwards, but the 
+*   animation uses less memory and is smaller when saved to the SD card.
+*   Playback is reset to the first frame.
+*
+*   Returns the new number of frames.
+*/
+int Animation::collapse_repeated_frames(){
+    if (_num_frames < 2 || _generator != nullptr)
+    {
+        return _num_frames;
+    }
+    int kept = 0;
+    for (int f = 1; f < _num_frames; f++)
+    {
+        Frame *last = _frames[kept];
+        uint32_t combined = (uint32_t)last->get_duration() + _frames[f]->get_duration();
+        if (combined <= UINT16_MAX && last->equals(_frames[f]))
         {
-        case LOOP:
-            if (_current_frame == _start_idx)
+            last->write_duration(combined);
+            if (_frames[f] == _limited_src)
             {
-                _loop_iteration++;
+                _limited_src = nullptr;
             }
-            break;
-        case ONCE:
-            break;
-        case BOUNCE:
-            _loop_iteration++; //not checked for current_frame vs start_idx because we want to bounce on both ends of the array
-            if (_loop_iteration != 1)
+            if (_frames[f] == _resampled_src)
             {
-                //First iteration we do not want to toggle
-                _dir_fwd = !_dir_fwd;
+                _resampled_src = nullptr;
             }
-            break;
-        case LOOP_N_TIMES:
-            if (_current_frame == _start_idx)
+            delete _frames[f];
+        }
+        else
+        {
+            _frames[++kept] = _frames[f];
+            if (kept != f)
             {
-                _loop_iteration++;
+                _frames[kept]->mark_modified(); //Moved to another place in the data file
             }
+        }
+    }
+    _num_frames = kept + 1;
 
-            break;
-        default:
-            _playback_state = ERROR;
-            break;
+    _current_frame = 0;
+    _prev_frame = -1;
+    _hold_ticks = 0;
+    _start_idx = 0;
+    return _num_frames;
+}
+
+void Animation::goto_next_frame()
+{
+    _motion_tick++;
+    if (_playback_state == RUNNING && _current_frame != -1)
+    {
+        //Hold the current frame until it has been shown for its full duration.
+        //The loop counting below only happens when we actually move to a new frame,
+        //so BOUNCE and LOOP_N_TIMES count the same way regardless of the durations.
+        if (++_hold_ticks < get_frame(_current_frame)->get_duration())
+        {
+            return;
         }
     }
+    _hold_ticks = 0;
 
+    //Loop counting and turning around at the ends (see Playback.h)
     _prev_frame = _current_frame;
-    _current_frame = _get_next_frame_idx();
+    _current_frame = playback_next_frame(_playback_type, _current_frame, _start_idx, _num_frames,
+                                         _max_iterations, &_loop_iteration, &_dir_fwd);
 
     if(_playback_state == ERROR){
         //TODO: Handle this error. Letting it slip to IDLE for now.
@@ -387,7 +708,16 @@ Frame *Animation::get_current_frame(){
     {
         return _blank_frame;
     }
-    return _frames[_current_frame];
+    Frame *frame = get_frame(_current_frame);
+    if (_resample_map != nullptr)
+    {
+        frame = _resample(frame);
+    }
+    if (_max_duty_sum != 0 || _max_row_sum != 0)
+    {
+        return _limit_power(frame);
+    }
+    return frame;
 }
 Frame *Animation::get_next_frame(){
     int idx = _get_next_frame_idx();
@@ -395,7 +725,7 @@ Frame *Animation::get_next_frame(){
     {
         return _blank_frame;
     }
-    return _frames[idx];
+    return get_frame(idx);
 }
 Frame *Animation::get_prev_frame(){
     if (_prev_frame == -1 || _playback_state == IDLE)
@@ -403,7 +733,7 @@ Frame *Animation::get_prev_frame(){
         return _blank_frame;
     }
     
-    return _frames[_prev_frame];
+    return get_frame(_prev_frame);
 }
 
 // Start new functionality added with Fetch V2.0
@@ -464,102 +794,200 @@ int* Animation::get_bottom_left_location(int* output)
     return output;
 }
 
-int Animation::merge_with(Animation* other){
+/*
+*  Merges every frame of "other" into the frame with the same number in this animation, at the
+*  location of "other", blending the pixels with "mode" (see Frame::merge_with_frame()).
+*  This animation is extended with blank frames if "other" is longer.
+*  Returns 1, or -1 if "other" is entirely outside of this animation.
+*/
+int Animation::merge_with(Animation* other, BlendMode mode, uint16_t weight){
+    if (_generator != nullptr)
+    {
+        Serial.println("Can not merge into a generated animation.");
+        return -1;
+    }
     // Before merging, verify that "other" is contained within the frame of "this"
     // If the entire "other" animation is outside the canvas of "this", then ignore it.
     // If the "other" animation is partially outside, only pixels that are inside "this" canvas
     // will be considered.
-    int *bottom_left_loc_other = new int[2];
-    int *size_other = new int[2];
-
-    int *origin_this = new int[2];
-    int *size_this = new int[2];
-    if (bottom_left_loc_other != nullptr && size_other != nullptr && origin_this != nullptr && size_this != nullptr)
-    {
-        bottom_left_loc_other = other->get_bottom_left_location(bottom_left_loc_other);
-        size_other = other->get_size(size_other); //width, height
-        int other_x = bottom_left_loc_other[0];
-        int other_y = bottom_left_loc_other[1];
-        int other_width = size_other[0];
-        int other_height = size_other[1];
-        
+    int bottom_left_loc_other[2];
+    int size_other[2];
+    int origin_this[2];
+    int size_this[2];
+    other->get_bottom_left_location(bottom_left_loc_other);
+    other->get_size(size_other); //width, height
+    int other_x = bottom_left_loc_other[0];
+    int other_y = bottom_left_loc_other[1];
+    int other_width = size_other[0];
+    int other_height = size_other[1];
+    
 
-        origin_this = this->get_origin(origin_this);
-        size_this = this->get_size(size_this); //width, height
-        int this_x = origin_this[0];
-        int this_y = origin_this[1];
-        int this_width = size_this[0];
-        int this_height = size_this[1];
-
-        int this_leftborder = -this_x;
-        int this_rightborder = this_width - this_x;
-        int this_bottomborder = -this_y;
-        int this_topborder = this_height - this_y;
-
-        //check if outside left border of canvas
-        if (other_x + other_width < this_leftborder)
-            return -1;
-        //check if outside bottom border of canvas
-        if (other_y + other_height < this_bottomborder)
-            return -1;
-        //check if outside right border of canvas
-        if (other_x > this_rightborder)
-            return -1;
-        //check if outside top border of canvas
-        if (other_y > this_topborder)
-            return -1;
+    this->get_origin(origin_this);
+    this->get_size(size_this); //width, height
+    int this_x = origin_this[0];
+    int this_y = origin_this[1];
+    int this_width = size_this[0];
+    int this_height = size_this[1];
 
-        
-        // Determine the number of frames necessary to complete both animations.
-        if (other->get_num_frames() > _num_frames)
-        {
-            //Allocate new memory for this animation to expand until it has the same length as the other animation
-            int difference = other->get_num_frames() - _num_frames;
-            //Add blank frames at the end of this animation
+    int this_leftborder = -this_x;
+    int this_rightborder = this_width - this_x;
+    int this_bottomborder = -this_y;
+    int this_topborder = this_height - this_y;
 
-            const int cols = _cols;
-            const int rows = _rows;
-            const int new_num_frames = _num_frames + difference;
+    //check if outside left border of canvas
+    if (other_x + other_width < this_leftborder)
+        return -1;
+    //check if outside bottom border of canvas
+    if (other_y + other_height < this_bottomborder)
+        return -1;
+    //check if outside right border of canvas
+    if (other_x > this_rightborder)
+        return -1;
+    //check if outside top border of canvas
+    if (other_y > this_topborder)
+        return -1;
 
-            Frame** new_frames = new Frame *[new_num_frames];
-            Serial.printf("frames:%d,cols:%d,rows:%d\n", new_num_frames, cols, rows);
-            
-            for (int f = 0; f < new_num_frames; f++)
-            {
-                if (f < _num_frames){
-                    new_frames[f] = _frames[f];
-                }else{
-                    new_frames[f] = new Frame();
-                }
-            }
-            
-            _num_frames = new_num_frames;
-            delete _frames; //Delete the old _frames array, 
-            _frames = new_frames;
+    
+    // Determine the number of frames necessary to complete both animations.
+    if (other->get_num_frames() > _num_frames)
+    {
+        //Allocate new memory for this animation to expand until it has the same length as the other animation
+        int difference = other->get_num_frames() - _num_frames;
+        //Add blank frames at the end of this animation
 
-        }
+        const int cols = _cols;
+        const int rows = _rows;
+        const int new_num_frames = _num_frames + difference;
 
-        // Duty cycle values need to be ADDED together (I think) and clamped to min and max duty cycle
-        Frame* this_frame_ptr;
-        Frame* other_frame_ptr;
-        int iterations = (other->get_num_frames() < _num_frames) ? other->get_num_frames() : _num_frames; //iterate through the lowest possible number of frames
-        for (int f = 0; f < iterations; f++)
+        Frame** new_frames = new Frame *[new_num_frames];
+        Serial.printf("frames:%d,cols:%d,rows:%d\n", new_num_frames, cols, rows);
+        
+        for (int f = 0; f < new_num_frames; f++)
         {
-            this_frame_ptr = this->get_frame(f);
-            other_frame_ptr = other->get_frame(f);
-            
-            //Serial.printf("Other w: %d, Origin h:%d, this w: %d, this h: %d\n", other_width, other_height, this_width, this_height);
-            for (int x = 0; x < other_width; x++)
-            {
-                //Serial.printf("Other_x: %d, Origin_X:%d, Other_Y: %d, Origin_y: %d\n", other_x, _origin_x, other_y, _origin_y);
-                this_frame_ptr->merge_with_frame(other_x,other_y,other_frame_ptr);
+            if (f < _num_frames){
+                new_frames[f] = _frames[f];
+            }else{
+                new_frames[f] = new Frame();
             }
         }
+        
+        _num_frames = new_num_frames;
+        delete[] _frames; //Delete the old _frames array, 
+        _frames = new_frames;
+
+    }
+
+    // Duty cycle values need to be ADDED together (I think) and clamped to min and max duty cycle
+    Frame* this_frame_ptr;
+    Frame* other_frame_ptr;
+    int iterations = (other->get_num_frames() < _num_frames) ? other->get_num_frames() : _num_frames; //iterate through the lowest possible number of frames
+    for (int f = 0; f < iterations; f++)
+    {
+        this_frame_ptr = this->get_frame(f);
+        other_frame_ptr = other->get_frame(f);
+        
+        //Serial.printf("Other w: %d, Origin h:%d, this w: %d, this h: %d\n", other_width, other_height, this_width, this_height);
+        //Serial.printf("Other_x: %d, Origin_X:%d, Other_Y: %d, Origin_y: %d\n", other_x, _origin_x, other_y, _origin_y);
+        this_frame_ptr->merge_with_frame(other_x, other_y, other_frame_ptr, mode, weight);
+    }
+    return 1;
+}
+/*
+*  Returns a new animation where every frame is a view (see Frame::get_view()) of the
+*  corresponding frame in this animation. Mirrored, flipped or moved variants of an 
+*  animation can be played or merged this way without copying any pixels.
+*  The new animation is only valid as long as this animation is.
+*/
+Animation *Animation::get_transformed_view(FrameTransform transform, int offset_x, int offset_y)
+{
+    if (_generator != nullptr)
+    {
+        return nullptr; //The generated frames are reused, so views of them would change under the caller
+    }
+    Frame **views = new Frame *[_num_frames];
+    for (int f = 0; f < _num_frames; f++)
+    {
+        views[f] = _frames[f]->get_view(transform, offset_x, offset_y);
+    }
+    Animation *view = new Animation(views, _num_frames, _cols, _rows, _origin_x, _origin_y, _location_x, _location_y);
+    view->write_playback_type(_playback_type);
+    view->write_playback_dir(_dir_fwd);
+    view->write_max_loop_count(_max_iterations);
+    return view;
+}
+/*
+*  Turns this into a generated animation: instead of storing frames, every frame is 
+*  computed by "generator" when it is needed, with the frame number as the time.
+*  Any stored frames are deleted. The animation has "num_frames" frames and is played
+*  with the same playback types as a stored animation. The generator is not copied, so
+*  its parameters can be changed while the animation plays.
+*  Pass nullptr as generator to go back to an animation with "num_frames" blank frames.
+*/
+void Animation::set_generator(FrameGenerator *generator, int num_frames)
+{
+    _delete_frames();
+    _delete_generated_frames();
+    _generator = generator;
+    _num_frames = num_frames;
+    if (generator == nullptr)
+    {
+        _frames = new Frame *[num_frames];
+        for (int frame = 0; frame < num_frames; frame++)
+        {
+            _frames[frame] = new Frame(nullptr, _cols, _rows);
+        }
+    }
+    else
+    {
+        for (int i = 0; i < 2; i++)
+        {
+            _generated_frames[i] = new Frame(nullptr, _cols, _rows);
+        }
+    }
+    _current_frame = _dir_fwd ? 0 : _num_frames - 1;
+    _start_idx = _current_frame;
+    _prev_frame = -1;
+    _hold_ticks = 0;
+    _loop_iteration = 0;
+}
+FrameGenerator *Animation::get_generator()
+{
+    return _generator;
+}
+/*
+*  Moves the animation along "track" while it plays: every tick, the location (and intensity
+*  scale) used by composite_onto() is read from the track instead of set_location().
+*  The track is not deleted with the animation and can be shared by several animations.
+*  Pass nullptr to go back to the static location.
+*/
+void Animation::set_motion_track(MotionTrack *track)
+{
+    _motion = track;
+}
+MotionTrack *Animation::get_motion_track()
+{
+    return _motion;
+}
+/*
+*  Merges the current frame into "canvas" at the location of this animation, like merge_with()
+*  does for a single frame. With a motion track the location and intensity scale come from the
+*  track at the current tick, so a sprite can glide across the canvas with sub-pixel steps.
+*/
+void Animation::composite_onto(Frame *canvas)
+{
+    if (_current_frame == -1 || _playback_state == IDLE)
+    {
+        return;
+    }
+    Frame *frame = get_frame(_current_frame);
+    int x_q4 = _location_x * Q4_ONE;
+    int y_q4 = _location_y * Q4_ONE;
+    uint16_t scale = MOTION_SCALE_ONE;
+    if (_motion != nullptr)
+    {
+        _motion->evaluate(_motion_tick, &x_q4, &y_q4, &scale);
     }
-    delete bottom_left_loc_other;
-    delete size_other;
-    delete origin_this;
-    delete size_this;
+    canvas->merge_with_frame_scaled(x_q4 - _origin_x * Q4_ONE, y_q4 - _origin_y * Q4_ONE, frame, scale);
 }
 // End new functionality added with Fetch V2.0
 
@@ -571,7 +999,9 @@ void Animation::start_animation_at(int start_frame){
     _playback_state = RUNNING;
     _start_idx = start_frame;
     _current_frame = start_frame;
+    _hold_ticks = 0;
     _loop_iteration = 0;
+    _motion_tick = 0;
 }
 void Animation::start_animation(){
     // Starts animation according to the configured playback direction.
@@ -600,63 +1030,127 @@ void Animation::write_playback_type(PlaybackType type){
 PlaybackType Animation::get_playback_type(){
     return _playback_type;
 }
-
-/*\brief Saves two corresponding files to the SD card.
-    One that provides info about the animation settings, the other who contains the actual data.
-    filename format: "A000_C.txt" for config files
-    filename format: "A000_D.bin" for data files
-    
-    \param[in] file_index is a maximum 5 digit number that will be added to the filename. 
-        If the number is not unique, the previous file (with the same index) will be overwritten.
- */
-int Animation::save_to_SD_card(SdFatSdioEX sd, uint16_t file_index)
+/*
+*  Copies the playback position (current frame, how long it has been held, loop count and direction)
+*  into "output". Only the playback fields are filled in, see PlaybackCheckpoint for the rest.
+*/
+void Animation::get_checkpoint(AnimCheckpoint *output)
 {
-    if(!sd.begin()){
-        Serial.println("SD initialitization failed. Save unsucessful.");
+    output->current_frame = _current_frame;
+    output->prev_frame = _prev_frame;
+    output->start_idx = _start_idx;
+    output->hold_ticks = _hold_ticks;
+    output->loop_iteration = _loop_iteration;
+    output->playback_state = _playback_state;
+    output->dir_fwd = _dir_fwd ? 1 : 0;
+}
+/*
+*  Continues playback from a checkpoint taken with get_checkpoint(), without touching the frames.
+*  The animation must already hold the frames the checkpoint was taken with.
+*  Returns -1 (and changes nothing) if the checkpoint does not fit this animation.
+*/
+int Animation::restore_checkpoint(const AnimCheckpoint *checkpoint)
+{
+    if (checkpoint->current_frame < -1 || checkpoint->current_frame >= _num_frames ||
+        checkpoint->prev_frame < -1 || checkpoint->prev_frame >= _num_frames ||
+        checkpoint->start_idx < 0 || checkpoint->start_idx >= max(_num_frames, 1) ||
+        checkpoint->playback_state > ERROR)
+    {
+        Serial.printf("Checkpoint (frame %d) does not fit animation with %d frames\n", checkpoint->current_frame, _num_frames);
+        return -1;
+    }
+    _current_frame = checkpoint->current_frame;
+    _prev_frame = checkpoint->prev_frame;
+    _start_idx = checkpoint->start_idx;
+    _loop_iteration = checkpoint->loop_iteration;
+    _playback_state = (PlaybackState)checkpoint->playback_state;
+    _dir_fwd = checkpoint->dir_fwd != 0;
+    _hold_ticks = checkpoint->hold_ticks;
+    //The frame durations may have been changed since the checkpoint was taken
+    if (_current_frame != -1 && _hold_ticks >= get_frame(_current_frame)->get_duration())
+    {
+        _hold_ticks = get_frame(_current_frame)->get_duration() - 1;
+    }
+    return 1;
+}
+
+/*
+*  Limits the power the frames returned by get_current_frame() draw from the supply.
+*  A frame whose duty cycles add up to more than "max_duty_sum", or that has a row (magnet driver
+*  board) adding up to more than "max_row_sum", is scaled down until it fits. Frames within the
+*  budget are returned as they are. The power of every frame is only worked out once (or read
+*  from the data file), so frames that fit cost nothing extra per tick.
+*  The sums are in duty cycle units: 40 magnets at full intensity is 40*DUTY_CYCLE_RESOLUTION.
+*  0 means no limit, set both to 0 to turn the limiter off.
+*/
+void Animation::set_power_budget(uint32_t max_duty_sum, uint32_t max_row_sum)
+{
+    _max_duty_sum = max_duty_sum;
+    _max_row_sum = max_row_sum;
+    _limited_src = nullptr;
+}
+const AnimFramePower *Animation::get_frame_power(int frame_num)
+{
+    return get_frame(frame_num)->get_power();
+}
+
+/*
+*  Makes get_current_frame() return its frames scaled by "map", to show an animation made for
+*  one panel size on another. The map can be shared by every animation of the same size.
+*  Frames of another size than the source size of the map are returned as they are.
+*  The stored frames are not changed; nullptr turns resampling off.
+*  Power limiting (set_power_budget()) is applied to the scaled frames.
+*/
+void Animation::set_resample_map(const ResampleMap *map)
+{
+    _resample_map = map;
+    _resampled_src = nullptr;
+}
+
+/*\brief Saves two corresponding files to the SD card.
+    One that provides info about the animation settings, the other who contains the actual data.
+    filename format: "A000_C.txt" for config files
+    filename format: "A000_D.bin" for data files
+    
+    If any frame is held for more than one tick, the frame durations are stored after the pixel data
+    in the data file (see AnimationFormat.h), followed by the power table of the frames,
+    so that the power limiter (see set_power_budget()) does not have to look at the pixels after a read.
+    The config file is written last, so a save that is cut short never leaves a config
+    file that describes data that was not written.
+    
+    \param[in] file_index is a maximum 5 digit number that will be added to the filename. 
+        If the number is not unique, the previous file (with the same index) will be overwritten.
+ */
+int Animation::save_to_SD_card(SdFatSdioEX sd, uint16_t file_index)
+{
+    if(!sd.begin()){
+        Serial.println("SD initialitization failed. Save unsucessful.");
         return -1;
     }
-    //Write ASCII config file:
-    //(Using ASCII here because we as users are more likely to 
-    // change these parameters manually than the animation itself.
-    // The animation will mainly be updated through a GUI program)
     //filename format: "A000_C.txt" for config files
     //filename format: "A000_D.bin" for data files
-    const int cfg_len = 150;
     const int cols = _cols;
     const int rows = _rows;
     const int frames = _num_frames;
-    static char config_str[cfg_len]; //The data that will be written to the .txt file
     uint16_t duty_buf[frames*cols*rows];
 
-    char full_filename[11]; //Max length of filename is 8 chars +".ext"
-    sprintf(full_filename,"A%u_C.txt",file_index);
-    if (!sdFile.open(full_filename, O_RDWR | O_CREAT)) {
-        Serial.printf("open file: '%s' failed\n",full_filename);
-        sd.errorHalt("open failed");
-        return -1;
+    //Frame durations are only stored if at least one frame is held for more than one tick
+    int data_flags = ANIM_DATA_POWER;
+    for (int f = 0; f < frames; f++)
+    {
+        if (get_frame(f)->get_duration() != ANIM_DEFAULT_FRAME_DURATION)
+        {
+            data_flags |= ANIM_DATA_DURATIONS;
+            break;
+        }
     }
-    sprintf(config_str,"%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d",
-        _cols,
-        _rows,
-        _num_frames,
-        _playback_type,
-        _playback_state,
-        _dir_fwd ? 1:0,
-        _current_frame,
-        _prev_frame,
-        _loop_iteration,
-        _max_iterations,
-        _start_idx);//TODO: Add origin, location, height/width etc.
-    sdFile.write(config_str);
-    //sdFile.write(transport_animation, transport_anim_count*COLS*4);
-    sdFile.flush();
-    sdFile.close();
-    Serial.printf("Config-file saved to SD card as: '%s'.\n",full_filename);
+
+    char full_filename[13]; //Max length of filename is 8 chars +".ext" + string terminator
 
     //Write binary datafile:
-    sprintf(full_filename,"A%u_D.bin",file_index);
+    sprintf(full_filename,ANIM_DATA_FILENAME_FMT,file_index);
 
-    if (!sdFile.open(full_filename, O_RDWR | O_CREAT)) {
+    if (!sdFile.open(full_filename, O_RDWR | O_CREAT | O_TRUNC)) {
         Serial.printf("open file: '%s' failed\n",full_filename);
         sd.errorHalt("open failed");
         return -1;
@@ -674,8 +1168,18 @@ int Animation::save_to_SD_card(SdFatSdioEX sd, uint16_t file_index)
         }
     }
     
-    sdFile.write(duty_buf,frames*cols*rows);
-    sdFile.flush();
+    bool ok = sdFile.write(duty_buf, anim_frame_offset(frames, cols, rows)) == anim_frame_offset(frames, cols, rows);
+    if (ok && (data_flags & ANIM_DATA_DURATIONS))
+    {
+        uint16_t durations[frames];
+        for (int f = 0; f < frames; f++)
+        {
+            durations[f] = get_frame(f)->get_duration();
+        }
+        ok = sdFile.write(durations, sizeof(durations)) == sizeof(durations);
+    }
+    ok = ok && _write_power_table();
+    ok = sdFile.sync() && ok;
 
     /*
     Serial.printf("Duty buffer before save:\n");
@@ -693,20 +1197,143 @@ int Animation::save_to_SD_card(SdFatSdioEX sd, uint16_t file_index)
     */
 
     sdFile.close();
+    if (!ok)
+    {
+        Serial.printf("Write to '%s' failed\n", full_filename);
+        return -1;
+    }
     Serial.printf("Data-file saved to SD card as: '%s'.\n",full_filename);
-    
+
+    if (_save_config_file(file_index, data_flags) != 1)
+    {
+        sd.errorHalt("open failed");
+        return -1;
+    }
+    _saved_file_index = file_index;
+    _clear_modified_frames();
+    _update_catalog(sd, file_index, data_flags);
+
     Serial.println("Save sucessful.");
     return 1;
 }
 
+/*\brief Saves only the frames that have been modified (see Frame::is_modified()) since the
+    animation was last read from or saved to the same file index.
+    Every modified frame is written in place, together with its entries in the duration
+    and power tables, and the config file is written last, like in save_to_SD_card().
+
+    The tables after the frames move whenever the number of frames changes, so patching is
+    only safe when the file on the card has exactly the layout of the animation in memory:
+    same size, same number of frames and same tables. Anything else (frames added or deleted,
+    durations added, frames from another file index) falls back to save_to_SD_card().
+ */
+int Animation::save_modified_to_SD_card(SdFatSdioEX sd, uint16_t file_index)
+{
+    if (_generator != nullptr || _saved_file_index != file_index)
+    {
+        return save_to_SD_card(sd, file_index);
+    }
+    const int cols = _cols;
+    const int rows = _rows;
+    const int frames = _num_frames;
+    int data_flags = ANIM_DATA_POWER;
+    for (int f = 0; f < frames; f++)
+    {
+        if (_frames[f]->get_duration() != ANIM_DEFAULT_FRAME_DURATION)
+        {
+            data_flags |= ANIM_DATA_DURATIONS;
+        }
+    }
+
+    //Layout of the animation that is on the card now
+    char full_filename[13]; //Max length of filename is 8 chars +".ext" + string terminator
+    sprintf(full_filename, ANIM_CONFIG_FILENAME_FMT, file_index);
+    if (!sdFile.open(full_filename, O_RDONLY))
+    {
+        return save_to_SD_card(sd, file_index);
+    }
+    //cols,rows,frames,type,state,dir,cur,prev,loop,max,start,data_flags (see _save_config_file())
+    int saved_config[12] = {0};
+    char delim = ',';
+    for (int i = 0; i < 12; i++)
+    {
+        if (csvReadInt(&sdFile, &saved_config[i], delim) <= 0)
+        {
+            break; //Files saved before the data flags were added end after "start"
+        }
+    }
+    sdFile.close();
+    if (saved_config[0] != cols || saved_config[1] != rows || saved_config[2] != frames ||
+        saved_config[11] != data_flags)
+    {
+        return save_to_SD_card(sd, file_index);
+    }
+
+    sprintf(full_filename, ANIM_DATA_FILENAME_FMT, file_index);
+    if (!sdFile.open(full_filename, O_RDWR))
+    {
+        return save_to_SD_card(sd, file_index);
+    }
+    if (sdFile.fileSize() != anim_data_file_size(frames, cols, rows, data_flags))
+    {
+        sdFile.close();
+        return save_to_SD_card(sd, file_index);
+    }
+
+    //Every entry of a modified frame is rewritten: its pixels, duration and power
+    const uint32_t durations_offset = anim_durations_offset(frames, cols, rows);
+    const uint32_t power_offset = anim_power_offset(frames, cols, rows, data_flags);
+    int written = 0;
+    uint16_t duty_buf[cols * rows];
+    bool ok = true;
+    for (int f = 0; f < frames && ok; f++)
+    {
+        Frame *curr_f = _frames[f];
+        if (!curr_f->is_modified())
+        {
+            continue;
+        }
+        curr_f->copy_pixel_intensities_to(duty_buf);
+        ok = sdFile.seekSet(anim_frame_offset(f, cols, rows)) &&
+             sdFile.write(duty_buf, anim_frame_size(cols, rows)) == anim_frame_size(cols, rows);
+        if (ok && (data_flags & ANIM_DATA_DURATIONS))
+        {
+            uint16_t duration = curr_f->get_duration();
+            ok = sdFile.seekSet(durations_offset + f * sizeof(uint16_t)) &&
+                 sdFile.write(&duration, sizeof(duration)) == sizeof(duration);
+        }
+        if (ok)
+        {
+            ok = sdFile.seekSet(power_offset + f * anim_power_entry_size(rows)) && _write_power_entry(f);
+        }
+        written++;
+    }
+    ok = sdFile.sync() && ok;
+    sdFile.close();
+    if (!ok)
+    {
+        Serial.printf("Write to '%s' failed\n", full_filename);
+        return -1;
+    }
+
+    if (_save_config_file(file_index, data_flags) != 1)
+    {
+        return -1;
+    }
+    _clear_modified_frames();
+    _update_catalog(sd, file_index, data_flags);
+    Serial.printf("Saved %d of %d frames to: '%s'.\n", written, frames, full_filename);
+    return 1;
+}
+
 int Animation::read_from_SD_card(SdFatSdioEX sd, uint16_t file_index){
     /*if(!sd.begin()){
         Serial.println("SD initialitization failed. Read unsucessful.");
         return -1;
     }*/
     //Serial.printf("numframes:%d\n",_num_frames);
-    char full_filename[11]; //Max length of filename is 8 chars +".ext"
-    sprintf(full_filename, "A%u_C.txt", file_index);
+    char full_filename[13]; //Max length of filename is 8 chars +".ext" + string terminator
+    sprintf(full_filename, ANIM_CONFIG_FILENAME_FMT, file_index);
     
     /*
     Serial.println("Test");
@@ -718,14 +1345,8 @@ int Animation::read_from_SD_card(SdFatSdioEX sd, uint16_t file_index){
     */
    
     //Clear memory of old frames
-    //TODO: is it necessary to check for null-pointers?
-    for (int i = 0; i < _num_frames; i++)
-    {
-        //Serial.printf("i:%d\n",i);
-        _frames[i]->delete_frame();
-    }
-    delete _frames;
-    _frames = nullptr;
+    _delete_generated_frames();
+    _delete_frames();
 
     //Read ASCII config file:
     //(Using ASCII here because we as users are more likely to
@@ -754,6 +1375,12 @@ int Animation::read_from_SD_card(SdFatSdioEX sd, uint16_t file_index){
     csvReadInt(&sdFile,&_loop_iteration,delim);
     csvReadInt(&sdFile,&_max_iterations,delim);
     csvReadInt(&sdFile,&_start_idx,delim);
+    int data_flags = 0;
+    if (csvReadInt(&sdFile,&data_flags,delim) < 0)
+    {
+        data_flags = 0; //Config files saved before the data flags were added
+    }
+    _hold_ticks = 0;
     
     sdFile.close();
     Serial.printf("Config-file read from SD card: '%s'.\n",full_filename);
@@ -781,15 +1408,25 @@ int Animation::read_from_SD_card(SdFatSdioEX sd, uint16_t file_index){
         //Serial.printf("Pointer to duty_buf: %p,%d\n",duty_buf,duty_buf);
         //Serial.printf("Pointer to _frame_buf: %p\n",_frame_buf);
     }
-    sprintf(full_filename,"A%u_D.bin",file_index);
+    sprintf(full_filename,ANIM_DATA_FILENAME_FMT,file_index);
     if (!sdFile.open(full_filename, O_RDONLY)) {
         Serial.printf("open file: '%s' failed\n",full_filename);
         sd.errorHalt("open failed");
         return -1;
     }
 
-    sdFile.read(duty_buf,frames*cols*rows*sizeof(uint16_t));
-    
+    const int data_size = anim_frame_offset(frames, cols, rows);
+    int read_size = sdFile.read(duty_buf, data_size);
+    read_size = max(read_size, 0);
+    if (read_size < data_size)
+    {
+        //The first version of the display saved only half of the pixels. Keep what is there,
+        //like tools/anim_migrate.cpp does, and leave the rest dark.
+        Serial.printf("Data-file '%s' is short: %d of %d frames intact, the rest are dark.\n",
+                      full_filename, read_size / (int)anim_frame_size(cols, rows), frames);
+        memset((uint8_t *)duty_buf + read_size, 0, data_size - read_size);
+    }
+
 
     /*Serial.printf("Frame buffer after read:\n");
     for(int f = 0; f<frames;f++){
@@ -831,6 +1468,34 @@ int Animation::read_from_SD_card(SdFatSdioEX sd, uint16_t file_index){
         }
         _frames[frame] = new Frame(new_duty_array,cols,rows);
     }
+    delete[] duty_buf;
+
+    if (data_flags & ANIM_DATA_DURATIONS)
+    {
+        uint16_t durations[frames];
+        if (sdFile.read(durations, sizeof(durations)) == (int)sizeof(durations))
+        {
+            for (int frame = 0; frame < frames; frame++)
+            {
+                _frames[frame]->write_duration(durations[frame]);
+            }
+        }
+    }
+    if (data_flags & ANIM_DATA_POWER)
+    {
+        //Only the totals are kept, the row sums are for tools that want to know which board is loaded
+        uint32_t row_sums[rows];
+        for (int frame = 0; frame < frames; frame++)
+        {
+            AnimFramePower power;
+            if (sdFile.read(&power, sizeof(power)) != sizeof(power) ||
+                sdFile.read(row_sums, sizeof(row_sums)) != sizeof(row_sums))
+            {
+                break; //The rest is worked out from the pixels when it is needed
+            }
+            _frames[frame]->write_power(&power);
+        }
+    }
     
     /* The below was needed when duty_cycle was stored differently in this method and in the frame object.
     Therefore it should now be irrelevant because we have changed how the Frame object stores duty cycles
@@ -852,104 +1517,464 @@ int Animation::read_from_SD_card(SdFatSdioEX sd, uint16_t file_index){
     sdFile.flush();
     sdFile.close();
     Serial.printf("Data-file: '%s' read from SD card.\n",full_filename);
+    _saved_file_index = file_index;
+    _clear_modified_frames();
 
     Serial.println("Read sucessful.");
     return 1;
 }
 
-// Private Methods
+/*\brief Saves the frames as a CSV file that can be edited in a spreadsheet.
+    The first line holds cols,rows,frames. Every following line holds one row of a frame:
+    frame,row,intensity of column 0,...,intensity of the last column
+    Rows are listed from the top of the display down, but are read back by their row number.
+    Frames that are held for more than one tick get an extra line: frame,-1,duration
 
-int Animation::_get_next_frame_idx()
+    filename format: "A000_F.csv"
+ */
+int Animation::save_to_CSV_file(SdFatSdioEX sd, uint16_t file_index)
 {
-    //NOTE TO SELF: This function should not modify any variables!
-    if (!_current_frame_is_on_edge())
+    char full_filename[13]; //Max length of filename is 8 chars +".ext" + string terminator
+    sprintf(full_filename, ANIM_CSV_FILENAME_FMT, file_index);
+    if (!sdFile.open(full_filename, O_RDWR | O_CREAT | O_TRUNC))
     {
-        //Current frame is NOT on the edge
-        if(_dir_fwd){
-            return _current_frame + 1;
-        }else{
-            return _current_frame - 1;
-        }
-
-        //TODO: Add case for "ONCE" where the animation does not start at 0 or num_frames - 1
-        //When that is done, the case of how to handle "edges" in the frame array for the "ONCE" case 
-        //also needs to be changed.
+        Serial.printf("open file: '%s' failed\n", full_filename);
+        return -1;
     }
-    else
+    const char delim = ',';
+    CsvWriter writer;
+    csvWriterBegin(&writer, &sdFile);
+    csvWriteInt(&writer, _cols, delim);
+    csvWriteInt(&writer, _rows, delim);
+    csvWriteInt(&writer, _num_frames, '\n');
+    for (int f = 0; f < _num_frames; f++)
     {
-        //Current frame IS on the edge
-        switch (_playback_type)
+        Frame *frame = get_frame(f);
+        if (frame->get_duration() != ANIM_DEFAULT_FRAME_DURATION)
         {
-        case LOOP:
-            if (_dir_fwd)
+            csvWriteInt(&writer, f, delim);
+            csvWriteInt(&writer, -1, delim);
+            csvWriteInt(&writer, frame->get_duration(), '\n');
+        }
+        for (int y = _rows - 1; y >= 0; y--)
+        {
+            csvWriteInt(&writer, f, delim);
+            csvWriteInt(&writer, y, delim);
+            for (int x = 0; x < _cols; x++)
             {
-                if(_current_frame != 0){
-                    return 0;
-                }
-                return _current_frame + 1;
-            }
-            if(_current_frame == 0){
-                return _num_frames - 1;
-            }
-            return _current_frame - 1;
-            
-        case ONCE:
-            if(_current_frame != _start_idx){
-                return -1; //signals that an "empty frame" should be returned from the function calling this
-            }
-            if(_dir_fwd){
-                if(_current_frame == 0){
-                    return _current_frame + 1;
-                }
-                return 0; //the start condition was the last frame but direction forward
+                csvWriteInt(&writer, frame->get_pixel_intensity_at(x, y), (x == _cols - 1) ? '\n' : delim);
             }
-            if(_current_frame != 0){
-                return _current_frame - 1;
-            }
-            return _num_frames - 1;//The start condition was 0 but direction backward
-        case BOUNCE:
-            if (_dir_fwd)
+        }
+    }
+    bool ok = csvWriterEnd(&writer);
+    sdFile.close();
+    if (!ok)
+    {
+        Serial.printf("write to '%s' failed\n", full_filename);
+        return -1;
+    }
+    Serial.printf("CSV-file saved to SD card as: '%s'.\n", full_filename);
+    return 1;
+}
+
+/*\brief Replaces the frames of this animation with the frames in a CSV file (see save_to_CSV_file()).
+    The values are parsed directly into the pixel arrays of the new frames. 
+    Cells that are missing or empty are left at zero, and empty lines are skipped, so the
+    file can be saved from a spreadsheet. Playback settings are kept, but playback starts over.
+    The frames are only replaced if the whole file could be read.
+ */
+int Animation::read_from_CSV_file(SdFatSdioEX sd, uint16_t file_index)
+{
+    char full_filename[13]; //Max length of filename is 8 chars +".ext" + string terminator
+    sprintf(full_filename, ANIM_CSV_FILENAME_FMT, file_index);
+    if (!sdFile.open(full_filename, O_RDONLY))
+    {
+        Serial.printf("open file: '%s' failed\n", full_filename);
+        return -1;
+    }
+    const char delim = ',';
+    CsvReader reader;
+    csvReaderBegin(&reader, &sdFile);
+    int cols = 0, rows = 0, frames = 0;
+    int line = 1;
+    int rtn;
+    if (csvSkipEmptyLines(&reader, delim, &line) < 0 ||
+        csvReadNextInt(&reader, &cols, delim) != delim ||
+        csvReadNextInt(&reader, &rows, delim) != delim ||
+        (rtn = csvReadNextInt(&reader, &frames, delim)) < 0 ||
+        cols <= 0 || rows <= 0 || frames <= 0)
+    {
+        Serial.printf("Could not read the size of the animation in: '%s'\n", full_filename);
+        sdFile.close();
+        return -1;
+    }
+    //Ignore empty cells after the size, added by spreadsheets to square up the columns
+    while (rtn == delim)
+    {
+        long ignored;
+        rtn = csvReadNextInt(&reader, &ignored, delim);
+    }
+
+    int tolerance = 10000;
+    if (!(FreeStack() > (int)(frames * cols * rows * sizeof(uint16_t) + tolerance)))
+    {
+        Serial.printf("Not enough memory to store animation of size: %d\n"
+                      "Available space in RAM: %d\n", frames * cols * rows * sizeof(uint16_t), FreeStack());
+        sdFile.close();
+        return -2;
+    }
+    Frame **new_frames = new Frame *[frames];
+    for (int f = 0; f < frames; f++)
+    {
+        new_frames[f] = new Frame(new uint16_t[cols * rows](), cols, rows);
+    }
+
+    while (rtn > 0)
+    {
+        line++;
+        int f, y;
+        rtn = csvSkipEmptyLines(&reader, delim, &line);
+        if (rtn == 0)
+        {
+            rtn = csvReadNextInt(&reader, &f, delim);
+            if (rtn == 0)
             {
-                return _current_frame + 1;
+                break; //End of file
             }
-            return _current_frame - 1;
-            
-            
-        case LOOP_N_TIMES:
-            if (_loop_iteration >= _max_iterations)
+        }
+        if (rtn != delim || csvReadNextInt(&reader, &y, delim) != delim || f < 0 || f >= frames || y < -1 || y >= rows)
+        {
+            Serial.printf("Invalid frame or row number on line %d of: '%s'\n", line, full_filename);
+            rtn = -1;
+            break;
+        }
+        if (y == -1)
+        {
+            int duration = ANIM_DEFAULT_FRAME_DURATION;
+            rtn = csvReadNextInt(&reader, &duration, delim);
+            if (rtn < 0 || duration < 1 || duration > UINT16_MAX)
             {
-                //using >= in case _max_iterations has illegal value (negative value)
-                return -1; //signals that an "empty frame" should be returned from the function calling this
+                Serial.printf("Invalid duration on line %d of: '%s'\n", line, full_filename);
+                rtn = -1;
+                break;
             }
-            if (_dir_fwd)
+            new_frames[f]->write_duration(duration);
+        }
+        else
+        {
+            uint16_t *row = &new_frames[f]->get_pixel_intensities()[y * cols];
+            for (int x = 0; x < cols; x++)
             {
-                if (_current_frame != 0)
+                long value = 0;
+                rtn = csvReadNextInt(&reader, &value, delim);
+                if (rtn < 0)
                 {
-                    return 0;
+                    Serial.printf("Invalid value on line %d of: '%s'\n", line, full_filename);
+                    break;
+                }
+                row[x] = value < 0 ? 0 : (value > DUTY_CYCLE_RESOLUTION ? DUTY_CYCLE_RESOLUTION : value);
+                if (rtn != delim)
+                {
+                    break; //End of line (or file), the remaining cells stay at zero
                 }
-                return _current_frame + 1;
-            }
-            if (_current_frame == 0)
-            {
-                return _num_frames - 1;
             }
-            return _current_frame - 1;
+        }
+        //Ignore any extra cells at the end of the line
+        while (rtn == delim)
+        {
+            long ignored;
+            rtn = csvReadNextInt(&reader, &ignored, delim);
+        }
+    }
+    sdFile.close();
+    if (rtn < 0)
+    {
+        //Keep the frames that were there
+        for (int f = 0; f < frames; f++)
+        {
+            delete new_frames[f];
+        }
+        delete[] new_frames;
+        return -1;
+    }
+
+    _delete_generated_frames();
+    _delete_frames();
+    _cols = cols;
+    _rows = rows;
+    _num_frames = frames;
+    _frames = new_frames;
+    _current_frame = _dir_fwd ? 0 : _num_frames - 1;
+    _start_idx = _current_frame;
+    _prev_frame = -1;
+    _hold_ticks = 0;
+    _loop_iteration = 0;
+    Serial.printf("CSV-file: '%s' read from SD card.\n", full_filename);
+    return 1;
+}
+
+// Private Methods
 
-        default:
-            _playback_state = ERROR;
-            return -1;
+/*
+*  Returns the generated frame "frame_num", rendering it only if it is not one of
+*  the two frames that were rendered last (or the generator has changed since).
+*/
+Frame *Animation::_render_generated_frame(int frame_num)
+{
+    uint32_t revision = _generator->get_revision();
+    for (int i = 0; i < 2; i++)
+    {
+        if (_generated_idx[i] == frame_num && _generated_revision[i] == revision)
+        {
+            return _generated_frames[i];
         }
     }
+    int slot = _oldest_generated;
+    _oldest_generated = 1 - slot;
+    _generator->render(_generated_frames[slot], frame_num);
+    _generated_frames[slot]->mark_modified(); //Generators write the pixels directly
+    _generated_idx[slot] = frame_num;
+    _generated_revision[slot] = revision;
+    return _generated_frames[slot];
 }
 
-int Animation::_get_prev_frame_idx()
+void Animation::_delete_generated_frames()
 {
-   return _prev_frame;
+    for (int i = 0; i < 2; i++)
+    {
+        delete _generated_frames[i];
+        _generated_frames[i] = nullptr;
+        _generated_idx[i] = -1;
+    }
+    _limited_src = nullptr;
+    _resampled_src = nullptr;
+    _generator = nullptr;
 }
 
-bool Animation::_current_frame_is_on_edge(){
-    if ((_current_frame > 0) && (_current_frame < (_num_frames - 1)) ){
-        return false;
+void Animation::_delete_frames()
+{
+    if (_frames == nullptr)
+    {
+        return;
     }
-    return true;
+    for (int i = 0; i < _num_frames; i++)
+    {
+        delete _frames[i];
+    }
+    delete[] _frames;
+    _frames = nullptr;
+    _saved_file_index = -1;
+    _limited_src = nullptr;
+    _resampled_src = nullptr;
+}
+
+//Writes the ASCII config file. Returns 1 on success, -1 if the file could not be opened.
+int Animation::_save_config_file(uint16_t file_index, int data_flags)
+{
+    //(Using ASCII here because we as users are more likely to
+    // change these parameters manually than the animation itself.
+    // The animation will mainly be updated through a GUI program)
+    const int cfg_len = 150;
+    static char config_str[cfg_len]; //The data that will be written to the .txt file
+    char full_filename[13]; //Max length of filename is 8 chars +".ext" + string terminator
+    sprintf(full_filename,ANIM_CONFIG_FILENAME_FMT,file_index);
+    if (!sdFile.open(full_filename, O_RDWR | O_CREAT | O_TRUNC)) {
+        Serial.printf("open file: '%s' failed\n",full_filename);
+        return -1;
+    }
+    sprintf(config_str,"%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d",
+        _cols,
+        _rows,
+        _num_frames,
+        _playback_type,
+        _playback_state,
+        _dir_fwd ? 1:0,
+        _current_frame,
+        _prev_frame,
+        _loop_iteration,
+        _max_iterations,
+        _start_idx,
+        data_flags);//TODO: Add origin, location, height/width etc.
+    sdFile.write(config_str);
+    sdFile.flush();
+    sdFile.close();
+    Serial.printf("Config-file saved to SD card as: '%s'.\n",full_filename);
+    return 1;
+}
+
+/*
+*  Returns "frame" if it is within the power budget, otherwise a copy scaled down to fit it.
+*  The copy is kept, and only made again when another frame (or a changed frame) is over the budget.
+*/
+Frame *Animation::_limit_power(Frame *frame)
+{
+    uint32_t scale = anim_power_scale(frame->get_power(), _max_duty_sum, _max_row_sum);
+    if (scale >= ANIM_POWER_SCALE_ONE)
+    {
+        return frame;
+    }
+    if (frame == _limited_src && frame->get_revision() == _limited_revision)
+    {
+        return _limited_frame;
+    }
+    if (_limited_frame == nullptr || _limited_frame->get_width() != frame->get_width() ||
+        _limited_frame->get_height() != frame->get_height())
+    {
+        delete _limited_frame;
+        _limited_frame = new Frame(nullptr, frame->get_width(), frame->get_height());
+    }
+    uint16_t *pixels = _limited_frame->get_pixel_intensities();
+    frame->copy_pixel_intensities_to(pixels);
+    anim_scale_pixels(pixels, frame->get_width() * frame->get_height(), scale);
+    _limited_frame->write_duration(frame->get_duration());
+    _limited_frame->mark_modified();
+    _limited_src = frame;
+    _limited_revision = frame->get_revision();
+    return _limited_frame;
+}
+
+Frame *Animation::_resample(Frame *frame)
+{
+    const ResampleMap *map = _resample_map;
+    if (frame->get_width() != map->get_src_cols() || frame->get_height() != map->get_src_rows())
+    {
+        return frame;
+    }
+    if (frame == _resampled_src && frame->get_revision() == _resampled_revision)
+    {
+        return _resampled_frame;
+    }
+    if (_resampled_frame == nullptr || _resampled_frame->get_width() != map->get_dst_cols() ||
+        _resampled_frame->get_height() != map->get_dst_rows())
+    {
+        delete _resampled_frame;
+        _resampled_frame = new Frame(nullptr, map->get_dst_cols(), map->get_dst_rows());
+    }
+    if (frame->is_view())
+    {
+        //The map gathers from the stored layout, so views are copied out first
+        uint16_t pixels[frame->get_width() * frame->get_height()];
+        frame->copy_pixel_intensities_to(pixels);
+        map->apply(pixels, _resampled_frame->get_pixel_intensities());
+    }
+    else
+    {
+        map->apply(frame->get_pixel_intensities(), _resampled_frame->get_pixel_intensities());
+    }
+    _resampled_frame->write_duration(frame->get_duration());
+    _resampled_frame->mark_modified();
+    _resampled_src = frame;
+    _resampled_revision = frame->get_revision();
+    return _resampled_frame;
+}
+
+/*
+*  Writes the power table (ANIM_DATA_POWER) of every frame to sdFile, at its current position.
+*  The power of each frame is worked out again, since the file also needs the sum of every row.
+*/
+bool Animation::_write_power_table()
+{
+    bool ok = true;
+    for (int f = 0; f < _num_frames && ok; f++)
+    {
+        ok = _write_power_entry(f);
+    }
+    return ok;
+}
+
+// Computes the power entry of frame "f" and writes it to sdFile, at the current position
+bool Animation::_write_power_entry(int f)
+{
+    const int cols = _cols;
+    const int rows = _rows;
+    uint16_t pixels[cols * rows];
+    uint32_t row_sums[rows];
+    Frame *frame = get_frame(f);
+    AnimFramePower power;
+    frame->copy_pixel_intensities_to(pixels);
+    anim_frame_power(pixels, cols, rows, &power, row_sums);
+    frame->write_power(&power);
+    return sdFile.write(&power, sizeof(power)) == sizeof(power) &&
+           sdFile.write(row_sums, sizeof(row_sums)) == sizeof(row_sums);
 }
+
+/*
+*  Writes the catalog entry of the animation that was just saved (if the card has a catalog).
+*  The checksum is computed from the frames in RAM, in the order they are laid out in the
+*  data file, so the file does not have to be read back.
+*/
+void Animation::_update_catalog(SdFatSdioEX sd, uint16_t file_index, int data_flags)
+{
+    if (!sd.exists(CATALOG_FILENAME))
+    {
+        return; //Most cards have no catalog, do not spend a pass over the frames on it
+    }
+    const int cols = _cols;
+    const int rows = _rows;
+    uint16_t pixels[cols * rows];
+    uint32_t crc = 0;
+    for (int f = 0; f < _num_frames; f++)
+    {
+        get_frame(f)->copy_pixel_intensities_to(pixels);
+        crc = anim_crc32(pixels, anim_frame_size(cols, rows), crc);
+    }
+    if (data_flags & ANIM_DATA_DURATIONS)
+    {
+        for (int f = 0; f < _num_frames; f++)
+        {
+            uint16_t duration = get_frame(f)->get_duration();
+            crc = anim_crc32(&duration, sizeof(duration), crc);
+        }
+    }
+    if (data_flags & ANIM_DATA_POWER)
+    {
+        uint32_t row_sums[rows];
+        for (int f = 0; f < _num_frames; f++)
+        {
+            AnimFramePower power;
+            get_frame(f)->copy_pixel_intensities_to(pixels);
+            anim_frame_power(pixels, cols, rows, &power, row_sums);
+            crc = anim_crc32(&power, sizeof(power), crc);
+            crc = anim_crc32(row_sums, sizeof(row_sums), crc);
+        }
+    }
+    AnimCatalogEntry entry;
+    memset(&entry, 0, sizeof(entry));
+    entry.anim_index = file_index;
+    entry.in_use = 1;
+    entry.data_flags = data_flags;
+    entry.cols = cols;
+    entry.rows = rows;
+    entry.num_frames = _num_frames;
+    entry.playback_type = _playback_type;
+    entry.total_duration = get_total_duration();
+    entry.data_size = anim_data_file_size(_num_frames, cols, rows, data_flags);
+    entry.data_crc = crc;
+    if (AnimCatalog::update_entry(sd, &entry) < 0)
+    {
+        Serial.println("Catalog update failed, rebuild it with AnimCatalog::rebuild()");
+    }
+}
+
+void Animation::_clear_modified_frames()
+{
+    for (int f = 0; _frames != nullptr && f < _num_frames; f++)
+    {
+        _frames[f]->clear_modified();
+    }
+}
+
+int Animation::_get_next_frame_idx()
+{
+    //NOTE TO SELF: This function should not modify any variables!
+    int loop_iteration = _loop_iteration;
+    bool dir_fwd = _dir_fwd;
+    return playback_next_frame(_playback_type, _current_frame, _start_idx, _num_frames,
+                               _max_iterations, &loop_iteration, &dir_fwd);
+}
+
+int Animation::_get_prev_frame_idx()
+{
+   return _prev_frame;
+}
+
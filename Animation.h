@@ -9,8 +9,12 @@
 
 #include <Arduino.h>
 #include "SdFat.h"
+#include "AnimationFormat.h"
+#include "BlendModes.h"
+#include "FrameLayout.h"
+#include "Playback.h"
+#include "Resample.h"
 
-#define DUTY_CYCLE_RESOLUTION 4096
 //holders for infromation you're going to pass to shifting function
 const int ALL_ROWS = 12;   //The total number of rows in the actual hardware
 const int ALL_COLS = 21;   //The total number of columns in the actual hardware
@@ -20,14 +24,6 @@ const int COLS = 19; //21; //The number of cols that are in use in the current p
 //const int REGISTERS = ROWS;       // no of register series (indicating no of magnet-driver-PCBs connected to the Arduino)
 //const int BYTES_PER_REGISTER = 4; // no of 8-bit shift registers in series per line (4 = 32 bits(/magnets))
 
-enum PlaybackType
-{
-    ONCE,
-    LOOP,
-    BOUNCE,
-    LOOP_N_TIMES //Add "STATIC_IMAGE" here?
-};
-
 enum PlaybackState
 {
     IDLE, //could be called "DONE", but until a "MagnetMatrix" class controls playbacks (and can change from "done" to "not started" when ending an animation), the name may be confusing.
@@ -41,20 +37,35 @@ enum PlaybackProcess
     FADE_IN_FADE_OUT //Fade between frames. Artsy effect that should be used with caution.
 };
 
+enum FrameTransform
+{
+    TRANSFORM_NONE,      //Only translation (if any)
+    TRANSFORM_MIRROR_X,  //Mirrored left to right
+    TRANSFORM_MIRROR_Y,  //Flipped upside down
+    TRANSFORM_ROTATE_180 //Mirrored in both directions
+};
+
+class FrameGenerator;
+class MotionTrack;
+
 class Frame
 {
 public:
-    Frame(uint16_t *duty_cycle = nullptr, int cols = COLS, int rows = ROWS);
+    Frame(uint16_t *duty_cycle = nullptr, int cols = COLS, int rows = ROWS, bool borrow_duty_cycle = false);
     ~Frame();
     Frame      *get_copy_of_frame();
+    Frame      *get_view(FrameTransform transform, int offset_x = 0, int offset_y = 0);
+    bool        is_view();
     void        delete_frame(void);
     uint16_t   *get_pixel_intensities();
+    void        copy_pixel_intensities_to(uint16_t *output);
     uint16_t    get_pixel_intensity_at(int x, int y);
     void        overwrite_pixel_intensities(uint16_t *duty_cycle);
     void        write_pixel_intensity_at(int x, int y, uint16_t duty_cycle);
 
     void        merge_pixel_intensity_at(int x, int y, uint16_t other_pixel_intensity);
-    void        merge_with_frame(int other_bottom_left_x, int other_bottom_left_y, Frame *other);
+    void        merge_with_frame(int other_bottom_left_x, int other_bottom_left_y, Frame *other, BlendMode mode = BLEND_ADD, uint16_t weight = DUTY_CYCLE_RESOLUTION);
+    void        merge_with_frame_scaled(int other_bottom_left_x_q4, int other_bottom_left_y_q4, Frame *other, uint16_t scale);
 
     void        unmerge_pixel_intensity_at(int x, int y, uint16_t other_pixel_intensity);
     void        unmerge_frame(int other_bottom_left_x, int other_bottom_left_y, Frame *other);
@@ -62,14 +73,42 @@ public:
     int         get_width();
     int         get_height();
 
+    uint16_t    get_duration();
+    void        write_duration(uint16_t ticks);
+    bool        equals(Frame *other);
+
+    bool        is_modified();
+    void        mark_modified();
+    void        clear_modified();
+    uint32_t    get_revision();
+
+    const AnimFramePower *get_power();
+    void        write_power(const AnimFramePower *power);
+
     void        print_to_terminal(int pretty=true);
 private : 
     int         _cols;
     int         _rows;
+    uint16_t    _duration = ANIM_DEFAULT_FRAME_DURATION; //Number of ticks (calls to Animation::goto_next_frame) this frame is shown
 
     uint16_t  *  _duty_cycle;
+    bool        _owns_duty_cycle = true; //false for views and frames made with borrow_duty_cycle
+    bool        _modified = true; //Changed since it was last read from or saved to the SD card
+    Frame      *_view_of = nullptr; //The frame a view was made from, so that writes through the view mark it as modified
+    uint32_t    _revision = 0; //Increases every time the frame is modified
+    AnimFramePower _power; //Only valid while _power_valid is true and _power_revision is get_revision()
+    bool        _power_valid = false;
+    uint32_t    _power_revision = 0;
+
+    //Where pixel (x,y) is stored (see FrameLayout.h). Normal frames store it at y*_cols + x,
+    //views use the layout to mirror and translate without copying.
+    FrameLayout _layout;
 
     void        _delete_duty_cycle();
+    int         _index_of(int x, int y);
+    void        _reset_view();
+    template <typename Blend>
+    void        _blend_frame(int other_bottom_left_x, int other_bottom_left_y, Frame *other, Blend blend);
 };
 
 class Animation
@@ -82,6 +121,8 @@ public:
     void    load_frames_from_array(uint16_t** duty_cycle);
     int     get_current_frame_num();
     int     get_num_frames();
+    uint32_t get_total_duration();
+    int     collapse_repeated_frames();
     void    goto_next_frame();
     void    goto_prev_frame();
     Frame*  get_current_frame();
@@ -94,7 +135,13 @@ public:
     int*    get_location(int *output);
     int*    get_size(int* output);
     int*    get_bottom_left_location(int *output);
-    int     merge_with(Animation *other);
+    int     merge_with(Animation *other, BlendMode mode = BLEND_ADD, uint16_t weight = DUTY_CYCLE_RESOLUTION);
+    Animation* get_transformed_view(FrameTransform transform, int offset_x = 0, int offset_y = 0);
+    void    set_generator(FrameGenerator *generator, int num_frames);
+    FrameGenerator* get_generator();
+    void    set_motion_track(MotionTrack *track);
+    MotionTrack* get_motion_track();
+    void    composite_onto(Frame *canvas);
     // End new functionality added with Fetch V2.0
 
     void    start_animation_at(int start_frame = 0);
@@ -105,9 +152,17 @@ public:
     bool    anim_done();
     void    write_playback_type(PlaybackType type);
     PlaybackType get_playback_type();
+    void    get_checkpoint(AnimCheckpoint *output);
+    int     restore_checkpoint(const AnimCheckpoint *checkpoint);
+    void    set_power_budget(uint32_t max_duty_sum, uint32_t max_row_sum = 0);
+    const AnimFramePower* get_frame_power(int frame_num);
+    void    set_resample_map(const ResampleMap *map);
 
     int     save_to_SD_card(SdFatSdioEX sd, uint16_t file_index);
+    int     save_modified_to_SD_card(SdFatSdioEX sd, uint16_t file_index);
     int     read_from_SD_card(SdFatSdioEX sd, uint16_t file_index);
+    int     save_to_CSV_file(SdFatSdioEX sd, uint16_t file_index);
+    int     read_from_CSV_file(SdFatSdioEX sd, uint16_t file_index);
 
 private:
     int             _cols;
@@ -121,6 +176,7 @@ private:
     bool            _dir_fwd = true;
     int             _current_frame = 0;
     int             _prev_frame = -1;
+    int             _hold_ticks = 0; //Number of ticks the current frame has been shown for
     int             _loop_iteration = 0;
     int             _max_iterations = -1;
     int             _start_idx = 0; //Where the animation started (not necessarily first index in array)
@@ -129,14 +185,45 @@ private:
     int             _origin_y = 0;
     int             _location_x = 0;
     int             _location_y = 0;
+    MotionTrack    *_motion = nullptr;
+    uint32_t        _motion_tick = 0; //Ticks since the animation was started, for the motion track
     // End new functionality added with Fetch V2.0
+    int             _saved_file_index = -1; //File index the frames were last read from or saved to, -1 if none
+    //Power limiting (see set_power_budget()). Frames over the budget are scaled into _limited_frame,
+    //which is reused for as long as the same version of the same frame is shown.
+    uint32_t        _max_duty_sum = 0;
+    uint32_t        _max_row_sum = 0;
+    Frame          *_limited_frame = nullptr;
+    Frame          *_limited_src = nullptr;
+    uint32_t        _limited_revision = 0;
+    //Resampling (see set_resample_map()), cached the same way as the power limiting
+    const ResampleMap *_resample_map = nullptr;
+    Frame          *_resampled_frame = nullptr;
+    Frame          *_resampled_src = nullptr;
+    uint32_t        _resampled_revision = 0;
 
 
     Frame         **_frames;
+    // Generated animations (see set_generator()) have no stored frames. Instead, the two
+    // most recently used frames are rendered into these reusable frames.
+    FrameGenerator *_generator = nullptr;
+    Frame          *_generated_frames[2] = {nullptr, nullptr};
+    int             _generated_idx[2] = {-1, -1};
+    uint32_t        _generated_revision[2] = {0, 0};
+    int             _oldest_generated = 0;
     Frame          *_blank_frame = new Frame(nullptr); //used as return statement when playback_state is DONE
     int             _get_next_frame_idx();
     int             _get_prev_frame_idx();
-    bool            _current_frame_is_on_edge();
+    void            _delete_frames();
+    int             _save_config_file(uint16_t file_index, int data_flags);
+    void            _clear_modified_frames();
+    void            _update_catalog(SdFatSdioEX sd, uint16_t file_index, int data_flags);
+    bool            _write_power_table();
+    bool            _write_power_entry(int f);
+    Frame          *_limit_power(Frame *frame);
+    Frame          *_resample(Frame *frame);
+    Frame          *_render_generated_frame(int frame_num);
+    void            _delete_generated_frames();
 };
 
 #endif
\ No newline at end of file
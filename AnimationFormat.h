@@ -0,0 +1,267 @@
+/*
+  AnimationFormat.h - on-card file layout used by Animation
+  Copyright (c) 2019 Simen E. Sørensen.
+
+  This header does not depend on Arduino, so that tools running on a PC
+  can read and write the same files as the display.
+*/
+
+#ifndef AnimationFormat_h
+#define AnimationFormat_h
+
+#include <stdint.h>
+
+#define DUTY_CYCLE_RESOLUTION 4096 //Full intensity of a pixel
+
+//filename format: "A000_C.txt" for config files
+//filename format: "A000_D.bin" for data files
+#define ANIM_CONFIG_FILENAME_FMT "A%u_C.txt"
+#define ANIM_DATA_FILENAME_FMT   "A%u_D.bin"
+//Frames as a spreadsheet (see Animation::save_to_CSV_file()): "A000_F.csv"
+#define ANIM_CSV_FILENAME_FMT    "A%u_F.csv"
+//Sprite atlases (see SpriteAtlas.h) and the sprite reference lists used by scenes
+#define ATLAS_CONFIG_FILENAME_FMT "S%u_C.txt"
+#define ATLAS_DATA_FILENAME_FMT   "S%u_D.bin"
+#define SPRITE_REFS_FILENAME_FMT  "R%u_C.txt"
+//Playback checkpoints (see Checkpoint.h): "P000_S.bin"
+#define CHECKPOINT_FILENAME_FMT   "P%u_S.bin"
+//Catalog of every animation on the card (see Catalog.h)
+#define CATALOG_FILENAME          "CATALOG.bin"
+#define CATALOG_TEMP_FILENAME     "CATALOG.tmp"
+
+//Number of comma separated fields in a config file written before the data flags were added.
+//Files with only these fields are read as if the data flags were 0.
+#define ANIM_LEGACY_CONFIG_FIELDS 11
+
+/*
+*  Bit flags stored in the 12th field of the config file.
+*  Every flag that is set adds a table to the end of the data file, right after
+*  the pixel data, in the same order as the flags are listed here.
+*/
+#define ANIM_DATA_DURATIONS 0x01 //One uint16_t per frame: the number of ticks the frame is held
+#define ANIM_DATA_POWER     0x02 //One power entry per frame, see AnimFramePower below
+
+#define ANIM_DEFAULT_FRAME_DURATION 1
+
+// Size in bytes of the pixel data of a single frame
+inline uint32_t anim_frame_size(int cols, int rows)
+{
+    return (uint32_t)cols * rows * sizeof(uint16_t);
+}
+// Offset in bytes of a frame inside the data file
+inline uint32_t anim_frame_offset(int frame, int cols, int rows)
+{
+    return (uint32_t)frame * anim_frame_size(cols, rows);
+}
+// Offset in bytes of the duration table (only present if ANIM_DATA_DURATIONS is set)
+inline uint32_t anim_durations_offset(int frames, int cols, int rows)
+{
+    return anim_frame_offset(frames, cols, rows);
+}
+
+/*
+*  Power drawn by a frame. Every lit magnet draws current in proportion to its duty cycle,
+*  so these sums tell how hard a frame loads the supply (duty_sum) and each magnet driver
+*  board, one per row (max_row_sum). Pixels above DUTY_CYCLE_RESOLUTION (merged frames)
+*  can not be driven harder than full intensity, so they count as DUTY_CYCLE_RESOLUTION.
+*
+*  With ANIM_DATA_POWER the data file holds one entry per frame after the durations:
+*  an AnimFramePower followed by the sum of every row (rows uint32_t, in the same order as the pixels),
+*  so the display gets them without looking at the pixels.
+*/
+struct AnimFramePower
+{
+    uint32_t duty_sum;    //Sum of all pixels
+    uint32_t max_row_sum; //Sum of the heaviest row
+    uint16_t peak_count;  //Pixels at full intensity
+    uint16_t reserved;
+};
+static_assert(sizeof(AnimFramePower) == 12, "AnimFramePower is stored as is, it must not contain padding");
+
+// Size in bytes of the power entry of one frame
+inline uint32_t anim_power_entry_size(int rows)
+{
+    return sizeof(AnimFramePower) + (uint32_t)rows * sizeof(uint32_t);
+}
+// Offset in bytes of the power table (only present if ANIM_DATA_POWER is set)
+inline uint32_t anim_power_offset(int frames, int cols, int rows, int flags)
+{
+    uint32_t offset = anim_durations_offset(frames, cols, rows);
+    if (flags & ANIM_DATA_DURATIONS)
+    {
+        offset += (uint32_t)frames * sizeof(uint16_t);
+    }
+    return offset;
+}
+// Total size in bytes of a data file with the given flags
+inline uint32_t anim_data_file_size(int frames, int cols, int rows, int flags)
+{
+    uint32_t size = anim_power_offset(frames, cols, rows, flags);
+    if (flags & ANIM_DATA_POWER)
+    {
+        size += (uint32_t)frames * anim_power_entry_size(rows);
+    }
+    return size;
+}
+
+// Works out the power of a frame of cols*rows pixels (row by row). "row_sums" (rows entries) may be nullptr.
+inline void anim_frame_power(const uint16_t *pixels, int cols, int rows, AnimFramePower *output, uint32_t *row_sums = nullptr)
+{
+    output->duty_sum = 0;
+    output->max_row_sum = 0;
+    output->peak_count = 0;
+    output->reserved = 0;
+    for (int y = 0; y < rows; y++)
+    {
+        uint32_t row_sum = 0;
+        for (int x = 0; x < cols; x++)
+        {
+            uint32_t value = pixels[y * cols + x];
+            if (value >= DUTY_CYCLE_RESOLUTION)
+            {
+                value = DUTY_CYCLE_RESOLUTION;
+                output->peak_count++;
+            }
+            row_sum += value;
+        }
+        if (row_sums != nullptr)
+        {
+            row_sums[y] = row_sum;
+        }
+        output->duty_sum += row_sum;
+        if (row_sum > output->max_row_sum)
+        {
+            output->max_row_sum = row_sum;
+        }
+    }
+}
+
+/*
+*  Scale (1/65536ths, at most 65536) that brings a frame with "power" within the budget,
+*  or 65536 if it already is. A budget of 0 means no limit.
+*/
+#define ANIM_POWER_SCALE_ONE 65536UL
+inline uint32_t anim_power_scale(const AnimFramePower *power, uint32_t max_duty_sum, uint32_t max_row_sum)
+{
+    uint32_t scale = ANIM_POWER_SCALE_ONE;
+    if (max_duty_sum != 0 && power->duty_sum > max_duty_sum)
+    {
+        scale = (uint32_t)(((uint64_t)max_duty_sum << 16) / power->duty_sum);
+    }
+    if (max_row_sum != 0 && power->max_row_sum > max_row_sum)
+    {
+        uint32_t row_scale = (uint32_t)(((uint64_t)max_row_sum << 16) / power->max_row_sum);
+        if (row_scale < scale)
+        {
+            scale = row_scale;
+        }
+    }
+    return scale;
+}
+
+/*
+*  Multiplies "count" pixels by scale/ANIM_POWER_SCALE_ONE, clamping them to full intensity first.
+*  Rounds down, so the scaled frame never draws more than the budget the scale came from.
+*  The loop has no branches, so the compiler can turn it into vector instructions.
+*/
+inline void anim_scale_pixels(uint16_t *pixels, int count, uint32_t scale)
+{
+    for (int i = 0; i < count; i++)
+    {
+        uint32_t value = pixels[i];
+        value = value < DUTY_CYCLE_RESOLUTION ? value : DUTY_CYCLE_RESOLUTION;
+        pixels[i] = (uint16_t)((value * scale) >> 16);
+    }
+}
+
+// CRC-32 (same as zip and zlib) of "len" bytes. Pass the previous result as "crc" to continue over more data.
+inline uint32_t anim_crc32(const void *data, uint32_t len, uint32_t crc = 0)
+{
+    //Half-byte table: small enough for the Teensy, fast enough for the PC tools
+    static const uint32_t table[16] = {
+        0x00000000UL, 0x1DB71064UL, 0x3B6E20C8UL, 0x26D930ACUL, 0x76DC4190UL, 0x6B6B51F4UL, 0x4DB26158UL, 0x5005713CUL,
+        0xEDB88320UL, 0xF00F9344UL, 0xD6D6A3E8UL, 0xCB61B38CUL, 0x9B64C2B0UL, 0x86D3D2D4UL, 0xA00AE278UL, 0xBDBDF21CUL};
+    const uint8_t *bytes = (const uint8_t *)data;
+    crc = ~crc;
+    for (uint32_t i = 0; i < len; i++)
+    {
+        crc = table[(crc ^ bytes[i]) & 0x0F] ^ (crc >> 4);
+        crc = table[(crc ^ (bytes[i] >> 4)) & 0x0F] ^ (crc >> 4);
+    }
+    return ~crc;
+}
+
+/*
+*  Playback checkpoint: where an animation (and the playlist it belongs to) was in its playback.
+*  A checkpoint file holds CHECKPOINT_SLOTS records, each at the start of its own 512 byte
+*  sector. Every save goes to the next slot, so a save that is cut short by a power loss can
+*  only damage the slot being written, never the newest good one, and the writes are spread
+*  over several sectors. The valid record (right magic and CRC) with the highest sequence wins.
+*/
+#define CHECKPOINT_SLOTS     8
+#define CHECKPOINT_SLOT_SIZE 512
+#define CHECKPOINT_MAGIC     0x4B435046UL //"FPCK" in the file
+
+struct AnimCheckpoint
+{
+    uint32_t magic;
+    uint32_t sequence;       //Increases by one for every save
+    uint16_t playlist_entry; //Position in a playlist, up to the program that plays it
+    uint16_t anim_index;     //File index of the animation that was playing
+    int16_t  current_frame;
+    int16_t  prev_frame;
+    int16_t  start_idx;
+    uint16_t hold_ticks;     //Ticks the current frame had been shown for
+    int32_t  loop_iteration;
+    uint8_t  playback_state;
+    uint8_t  dir_fwd;
+    uint16_t reserved;
+    uint32_t crc;            //anim_crc32() of all the fields above
+};
+static_assert(sizeof(AnimCheckpoint) == 32, "AnimCheckpoint is stored as is, it must not contain padding");
+
+inline uint32_t anim_checkpoint_crc(const AnimCheckpoint *checkpoint)
+{
+    return anim_crc32(checkpoint, sizeof(AnimCheckpoint) - sizeof(checkpoint->crc));
+}
+
+/*
+*  Catalog file: a small header followed by one fixed size entry per animation, in no
+*  particular order. An entry is updated in place when its animation is saved, and a removed
+*  entry (in_use == 0) is reused by the next new one, so a save only writes a single entry.
+*  Every entry has its own CRC: an entry that was cut short by a power loss is simply skipped.
+*/
+#define CATALOG_MAGIC   0x54414346UL //"FCAT" in the file
+#define CATALOG_VERSION 1
+
+struct AnimCatalogHeader
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t entry_size; //sizeof(AnimCatalogEntry), so that entries can grow in later versions
+};
+static_assert(sizeof(AnimCatalogHeader) == 8, "AnimCatalogHeader is stored as is, it must not contain padding");
+
+struct AnimCatalogEntry
+{
+    uint16_t anim_index;     //File index of the animation (A%u_C.txt and A%u_D.bin)
+    uint8_t  in_use;         //0 if the entry is free
+    uint8_t  data_flags;     //Tables in the data file (ANIM_DATA_*)
+    uint16_t cols;
+    uint16_t rows;
+    uint16_t num_frames;
+    uint8_t  playback_type;
+    uint8_t  reserved;
+    uint32_t total_duration; //Ticks to play every frame once
+    uint32_t data_size;      //Bytes of the data file, anim_data_file_size()
+    uint32_t data_crc;       //anim_crc32() of those bytes
+    uint32_t crc;            //anim_crc32() of all the fields above
+};
+static_assert(sizeof(AnimCatalogEntry) == 28, "AnimCatalogEntry is stored as is, it must not contain padding");
+
+inline uint32_t anim_catalog_entry_crc(const AnimCatalogEntry *entry)
+{
+    return anim_crc32(entry, sizeof(AnimCatalogEntry) - sizeof(entry->crc));
+}
+
+#endif
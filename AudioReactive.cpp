@@ -0,0 +1,136 @@
+#include "AudioReactive.h"
+
+/*
+\brief Constructor
+
+\param anim The animation to play. It is started, or not, by the caller as usual
+\param bands Where the band levels come from. Feed it through feed() so the cost is measured
+
+Nothing follows the music until one of the set_*_band() functions is called.
+*/
+AudioDriver::AudioDriver(Animation *anim, AudioBands *bands)
+{
+    _anim = anim;
+    _bands = bands;
+}
+AudioDriver::~AudioDriver()
+{
+    delete _scaled;
+}
+
+/*
+*  Makes the playback rate follow "band": min_rate_q8 frames per tick when the band is
+*  silent, max_rate_q8 when it is as loud as it gets (in 1/256ths, 256 is the normal rate).
+*  Rates above 256 skip frames, rates below hold them. -1 plays at the normal rate again.
+*/
+void AudioDriver::set_rate_band(int band, uint16_t min_rate_q8, uint16_t max_rate_q8)
+{
+    _rate_band = band;
+    _min_rate = min_rate_q8;
+    _max_rate = max(max_rate_q8, min_rate_q8);
+    _rate_phase = 0;
+}
+/*
+*  Makes the frame that is shown follow "band", instead of the playback: the first frame when
+*  the band is silent, the last when it is as loud as it gets. Works best with animations that
+*  grow from a calm first frame to a wild last one. -1 goes back to normal playback.
+*/
+void AudioDriver::set_frame_band(int band)
+{
+    _frame_band = band;
+}
+// Dims the frames to "min_scale" (in 1/ANIM_POWER_SCALE_ONE) when "band" is silent, full intensity when it is loud. -1 turns it off.
+void AudioDriver::set_intensity_band(int band, uint32_t min_scale)
+{
+    _intensity_band = band;
+    _min_scale = min(min_scale, ANIM_POWER_SCALE_ONE);
+}
+
+/*
+*  Passes "count" samples (every "stride"th value of "samples") to the band analysis.
+*  Returns the number of blocks that were analyzed.
+*/
+int AudioDriver::feed(const int16_t *samples, int count, int stride)
+{
+    uint32_t start = micros();
+    int blocks = _bands->feed(samples, count, stride);
+    if (blocks > 0)
+    {
+        _feed_micros = micros() - start;
+        if (_feed_micros > _max_feed_micros)
+        {
+            _max_feed_micros = _feed_micros;
+        }
+    }
+    return blocks;
+}
+
+// Call once per tick, instead of Animation::goto_next_frame()
+void AudioDriver::tick()
+{
+    if (_frame_band >= 0)
+    {
+        int last = _anim->get_num_frames() - 1;
+        int frame = (int)((uint32_t)_bands->get_level(_frame_band) * last / AUDIO_LEVEL_ONE);
+        if (frame != _anim->get_current_frame_num())
+        {
+            _anim->start_animation_at(frame);
+        }
+        return;
+    }
+    if (_rate_band < 0)
+    {
+        _anim->goto_next_frame();
+        return;
+    }
+    uint32_t level = _bands->get_level(_rate_band);
+    _rate_phase += _min_rate + (uint32_t)(_max_rate - _min_rate) * level / AUDIO_LEVEL_ONE;
+    //A whole number of frames per tick; the rest is carried over to the next tick
+    for (; _rate_phase >= 256; _rate_phase -= 256)
+    {
+        _anim->goto_next_frame();
+    }
+}
+
+// The frame to show, dimmed if the intensity follows a band
+Frame *AudioDriver::get_current_frame()
+{
+    Frame *frame = _anim->get_current_frame();
+    if (_intensity_band < 0)
+    {
+        return frame;
+    }
+    uint32_t level = _bands->get_level(_intensity_band);
+    uint32_t scale = _min_scale + (ANIM_POWER_SCALE_ONE - _min_scale) * level / AUDIO_LEVEL_ONE;
+    if (scale >= ANIM_POWER_SCALE_ONE)
+    {
+        return frame;
+    }
+    if (_scaled == nullptr || _scaled->get_width() != frame->get_width() || _scaled->get_height() != frame->get_height())
+    {
+        delete _scaled;
+        _scaled = new Frame(nullptr, frame->get_width(), frame->get_height());
+    }
+    uint16_t *pixels = _scaled->get_pixel_intensities();
+    frame->copy_pixel_intensities_to(pixels);
+    anim_scale_pixels(pixels, frame->get_width() * frame->get_height(), scale);
+    _scaled->write_duration(frame->get_duration());
+    _scaled->mark_modified();
+    return _scaled;
+}
+
+// Level of a band after the last analyzed block, 0 ... AUDIO_LEVEL_ONE
+uint16_t AudioDriver::get_level(int band)
+{
+    return _bands->get_level(band);
+}
+
+// Time the last call to feed() that analyzed a block took
+uint32_t AudioDriver::get_feed_micros()
+{
+    return _feed_micros;
+}
+uint32_t AudioDriver::get_max_feed_micros()
+{
+    return _max_feed_micros;
+}
@@ -0,0 +1,62 @@
+/*
+  AudioReactive.h - plays an animation in time with music
+  Copyright (c) 2019 Simen E. Sørensen.
+*/
+
+// ensure this library description is only included once
+#ifndef AudioReactive_h
+#define AudioReactive_h
+
+#include <Arduino.h>
+#include "Animation.h"
+#include "FixedFFT.h"
+
+/*
+*  Drives the playback of an animation from the band levels of an AudioBands (FixedFFT.h).
+*  Each of these follows the level of a band of its own choosing, or is left alone (-1):
+*      rate      - how many frames the animation moves per tick
+*      frame     - which frame is shown: quiet is the first frame, loud the last
+*      intensity - how bright the frame is shown
+*  For generated animations, or anything else, get_level() gives the level of every band:
+*      ripple.set_amplitude(driver.get_level(0)); //Levels are in pixel intensity units
+*
+*  In the main loop, feed() the samples that have arrived (e.g. from an ADC buffer filled by
+*  DMA), call tick() instead of Animation::goto_next_frame(), and show get_current_frame().
+*  feed() analyzes at most one block per block of samples given, and times itself, so the
+*  cost can be checked next to the rest of the loop (see get_max_feed_micros()).
+*/
+class AudioDriver
+{
+public:
+    AudioDriver(Animation *anim, AudioBands *bands);
+    ~AudioDriver();
+    void     set_rate_band(int band, uint16_t min_rate_q8 = 64, uint16_t max_rate_q8 = 4 * 256);
+    void     set_frame_band(int band);
+    void     set_intensity_band(int band, uint32_t min_scale = ANIM_POWER_SCALE_ONE / 8);
+
+    int      feed(const int16_t *samples, int count, int stride = 1);
+    void     tick();
+    Frame*   get_current_frame();
+    uint16_t get_level(int band);
+
+    uint32_t get_feed_micros();
+    uint32_t get_max_feed_micros();
+
+private:
+    Animation  *_anim;
+    AudioBands *_bands;
+    Frame      *_scaled = nullptr; //Returned by get_current_frame() when the intensity is turned down
+
+    int         _rate_band = -1;
+    uint16_t    _min_rate = 256;   //Frames per tick, in 1/256ths
+    uint16_t    _max_rate = 256;
+    uint32_t    _rate_phase = 0;   //Part of a frame moved so far, in 1/256ths
+    int         _frame_band = -1;
+    int         _intensity_band = -1;
+    uint32_t    _min_scale = ANIM_POWER_SCALE_ONE;
+
+    uint32_t    _feed_micros = 0;
+    uint32_t    _max_feed_micros = 0;
+};
+
+#endif
@@ -0,0 +1,103 @@
+/*
+  BlendModes.h - ways of combining the pixels of two frames
+  Copyright (c) 2019 Simen E. Sørensen.
+
+  This header does not depend on Arduino, so that the host tools blend exactly
+  like Frame::merge_with_frame() does on the display.
+
+  Every mode is a small policy struct whose operator() blends a single pixel. The loops that
+  walk the frames are templates taking the policy as a parameter, so every mode gets its own
+  copy of the loop with the blend inlined: no switch or function pointer per pixel.
+*/
+
+#ifndef BlendModes_h
+#define BlendModes_h
+
+#include <stdint.h>
+#include "AnimationFormat.h"
+
+enum BlendMode
+{
+    BLEND_ADD,      //dst + src, not clamped to DUTY_CYCLE_RESOLUTION, so that unmerging gives back the original (the default)
+    BLEND_MAX,      //The brightest of the two
+    BLEND_REPLACE,  //src, also where src is zero
+    BLEND_MULTIPLY, //dst scaled by src, used as a mask: DUTY_CYCLE_RESOLUTION keeps dst, 0 clears it
+    BLEND_SUBTRACT, //dst - src, but never below zero
+    BLEND_WEIGHTED, //Mix of the two: "weight" of src, the rest of dst (DUTY_CYCLE_RESOLUTION is only src)
+    NUM_BLEND_MODES
+};
+
+//Stops at 65535 instead of wrapping around to a dark pixel. Unmerging is exact as long as no sum got that high.
+struct BlendAdd
+{
+    uint16_t operator()(uint16_t dst, uint16_t src) const
+    {
+        uint32_t sum = (uint32_t)dst + src;
+        return sum < UINT16_MAX ? sum : UINT16_MAX;
+    }
+};
+//The inverse of BlendAdd, used to unmerge frames. Stops at zero instead of wrapping around to a bright pixel.
+struct BlendUnmerge
+{
+    uint16_t operator()(uint16_t dst, uint16_t src) const { return dst > src ? dst - src : 0; }
+};
+struct BlendMax
+{
+    uint16_t operator()(uint16_t dst, uint16_t src) const { return dst > src ? dst : src; }
+};
+struct BlendReplace
+{
+    uint16_t operator()(uint16_t /*dst*/, uint16_t src) const { return src; }
+};
+struct BlendMultiply
+{
+    uint16_t operator()(uint16_t dst, uint16_t src) const
+    {
+        uint32_t mask = src < DUTY_CYCLE_RESOLUTION ? src : DUTY_CYCLE_RESOLUTION;
+        return (uint32_t)dst * mask / DUTY_CYCLE_RESOLUTION;
+    }
+};
+struct BlendSubtract
+{
+    uint16_t operator()(uint16_t dst, uint16_t src) const { return dst > src ? dst - src : 0; }
+};
+struct BlendWeighted
+{
+    uint32_t weight; //0 to DUTY_CYCLE_RESOLUTION
+    uint16_t operator()(uint16_t dst, uint16_t src) const
+    {
+        return ((uint32_t)dst * (DUTY_CYCLE_RESOLUTION - weight) + (uint32_t)src * weight) / DUTY_CYCLE_RESOLUTION;
+    }
+};
+
+/*
+*  Blends "count" pixels of src into dst. The steps are 1, or -1 for mirrored frames.
+*  The common case of two plain rows gets a loop of its own, which the compiler can vectorize.
+*/
+template <typename Blend>
+inline void blend_row(uint16_t *dst, int dst_step, const uint16_t *src, int src_step, int count, Blend blend)
+{
+    if (dst_step == 1 && src_step == 1)
+    {
+        for (int i = 0; i < count; i++)
+        {
+            dst[i] = blend(dst[i], src[i]);
+        }
+    }
+    else
+    {
+        for (int i = 0; i < count; i++)
+        {
+            dst[i * dst_step] = blend(dst[i * dst_step], src[i * src_step]);
+        }
+    }
+}
+
+//Name of a mode, as used in scene files
+inline const char *blend_mode_name(BlendMode mode)
+{
+    static const char *names[NUM_BLEND_MODES] = {"add", "max", "replace", "multiply", "subtract", "weighted"};
+    return (mode >= 0 && mode < NUM_BLEND_MODES) ? names[mode] : "?";
+}
+
+#endif
@@ -0,0 +1,355 @@
+#include "Catalog.h"
+#include "csv_helpers.h"
+#include <stdlib.h>
+#include <string.h>
+
+AnimCatalog::AnimCatalog()
+{
+}
+AnimCatalog::~AnimCatalog()
+{
+    delete[] _entries;
+}
+
+static int _compare_entries(const void *a, const void *b)
+{
+    return (int)((const AnimCatalogEntry *)a)->anim_index - (int)((const AnimCatalogEntry *)b)->anim_index;
+}
+
+//Reads and checks the header. Returns false if the file is not a catalog this version can use.
+static bool _read_header(File *file)
+{
+    AnimCatalogHeader header;
+    return file->seekSet(0) && file->read(&header, sizeof(header)) == sizeof(header) &&
+           header.magic == CATALOG_MAGIC && header.version == CATALOG_VERSION &&
+           header.entry_size == sizeof(AnimCatalogEntry);
+}
+
+/*\brief Reads every entry of the catalog into memory.
+    Entries that were damaged (e.g. by a power loss while they were written) are skipped and
+    counted, see get_num_damaged(); rebuild() gets them back.
+    Returns the number of entries, or -1 if there is no (usable) catalog on the card.
+ */
+int AnimCatalog::read(SdFatSdioEX sd)
+{
+    delete[] _entries;
+    _entries = nullptr;
+    _num_entries = 0;
+    _num_damaged = 0;
+
+    File catalogFile;
+    if (!catalogFile.open(CATALOG_FILENAME, O_RDONLY))
+    {
+        Serial.printf("No catalog: '%s'\n", CATALOG_FILENAME);
+        return -1;
+    }
+    if (!_read_header(&catalogFile))
+    {
+        Serial.printf("'%s' is not a catalog of this version\n", CATALOG_FILENAME);
+        catalogFile.close();
+        return -1;
+    }
+    int slots = (catalogFile.fileSize() - sizeof(AnimCatalogHeader)) / sizeof(AnimCatalogEntry);
+    _entries = new AnimCatalogEntry[max(slots, 1)];
+    for (int i = 0; i < slots; i++)
+    {
+        AnimCatalogEntry *entry = &_entries[_num_entries];
+        if (catalogFile.read(entry, sizeof(AnimCatalogEntry)) != sizeof(AnimCatalogEntry))
+        {
+            break;
+        }
+        if (entry->crc != anim_catalog_entry_crc(entry))
+        {
+            _num_damaged++;
+        }
+        else if (entry->in_use)
+        {
+            _num_entries++;
+        }
+    }
+    catalogFile.close();
+    qsort(_entries, _num_entries, sizeof(AnimCatalogEntry), _compare_entries);
+    return _num_entries;
+}
+
+int AnimCatalog::get_num_entries()
+{
+    return _num_entries;
+}
+int AnimCatalog::get_num_damaged()
+{
+    return _num_damaged;
+}
+// Entries are sorted by anim_index
+AnimCatalogEntry *AnimCatalog::get_entry(int idx)
+{
+    if (idx < 0 || idx >= _num_entries)
+    {
+        return nullptr;
+    }
+    return &_entries[idx];
+}
+// Returns the entry of an animation, or nullptr if the catalog does not list it
+AnimCatalogEntry *AnimCatalog::find(uint16_t anim_index)
+{
+    int low = 0;
+    int high = _num_entries - 1;
+    while (low <= high)
+    {
+        int mid = (low + high) / 2;
+        if (_entries[mid].anim_index == anim_index)
+        {
+            return &_entries[mid];
+        }
+        if (_entries[mid].anim_index < anim_index)
+        {
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid - 1;
+        }
+    }
+    return nullptr;
+}
+
+/*\brief Writes the entry of one animation to the catalog on the card, replacing the old entry of
+    that animation (or using a free slot) so that only this entry is written.
+    Only an existing catalog is updated: returns 0 if there is none (see rebuild()), 1 on success
+    and -1 if the catalog could not be written.
+ */
+int AnimCatalog::update_entry(SdFatSdioEX sd, const AnimCatalogEntry *entry)
+{
+    File catalogFile;
+    if (!catalogFile.open(CATALOG_FILENAME, O_RDWR))
+    {
+        return 0;
+    }
+    uint32_t offset;
+    if (_find_slot(&catalogFile, entry->anim_index, &offset) < 0)
+    {
+        catalogFile.close();
+        Serial.printf("'%s' is not a catalog of this version\n", CATALOG_FILENAME);
+        return -1;
+    }
+    AnimCatalogEntry record = *entry;
+    record.in_use = 1;
+    record.crc = anim_catalog_entry_crc(&record);
+    bool ok = catalogFile.seekSet(offset) &&
+              catalogFile.write(&record, sizeof(record)) == sizeof(record);
+    ok = catalogFile.sync() && ok;
+    catalogFile.close();
+    if (!ok)
+    {
+        Serial.printf("Write to '%s' failed\n", CATALOG_FILENAME);
+        return -1;
+    }
+    return 1;
+}
+/*\brief Marks the entry of an animation as free.
+    Returns 1 if it was removed, 0 if the catalog does not list it (or there is no catalog).
+ */
+int AnimCatalog::remove_entry(SdFatSdioEX sd, uint16_t anim_index)
+{
+    File catalogFile;
+    if (!catalogFile.open(CATALOG_FILENAME, O_RDWR))
+    {
+        return 0;
+    }
+    uint32_t offset;
+    int rtn = 0;
+    if (_find_slot(&catalogFile, anim_index, &offset) == 1)
+    {
+        AnimCatalogEntry record;
+        memset(&record, 0, sizeof(record));
+        record.crc = anim_catalog_entry_crc(&record);
+        rtn = (catalogFile.seekSet(offset) && catalogFile.write(&record, sizeof(record)) == sizeof(record)) ? 1 : -1;
+        catalogFile.sync();
+    }
+    catalogFile.close();
+    return rtn;
+}
+
+/*\brief Fills in the catalog entry of an animation from its files on the card, reading the
+    whole data file for its checksum. Returns -1 if the files are missing or do not match.
+ */
+int AnimCatalog::make_entry(SdFatSdioEX sd, uint16_t anim_index, AnimCatalogEntry *output)
+{
+    File animFile;
+    char full_filename[13]; //Max length of filename is 8 chars +".ext" + string terminator
+    sprintf(full_filename, ANIM_CONFIG_FILENAME_FMT, anim_index);
+    if (!animFile.open(full_filename, O_RDONLY))
+    {
+        Serial.printf("open file: '%s' failed\n", full_filename);
+        return -1;
+    }
+    //Same fields as Animation::read_from_SD_card(), only the ones the catalog needs are kept
+    int fields[ANIM_LEGACY_CONFIG_FIELDS + 1];
+    int num_fields = 0;
+    char delim = ',';
+    while (num_fields < ANIM_LEGACY_CONFIG_FIELDS + 1 && csvReadInt(&animFile, &fields[num_fields], delim) >= 0)
+    {
+        num_fields++;
+    }
+    animFile.close();
+    if (num_fields < ANIM_LEGACY_CONFIG_FIELDS || fields[0] <= 0 || fields[1] <= 0 || fields[2] < 0)
+    {
+        Serial.printf("Could not parse '%s'\n", full_filename);
+        return -1;
+    }
+    memset(output, 0, sizeof(AnimCatalogEntry));
+    output->anim_index = anim_index;
+    output->in_use = 1;
+    output->cols = fields[0];
+    output->rows = fields[1];
+    output->num_frames = fields[2];
+    output->playback_type = fields[3];
+    output->data_flags = (num_fields > ANIM_LEGACY_CONFIG_FIELDS) ? fields[ANIM_LEGACY_CONFIG_FIELDS] : 0;
+    output->data_size = anim_data_file_size(output->num_frames, output->cols, output->rows, output->data_flags);
+
+    sprintf(full_filename, ANIM_DATA_FILENAME_FMT, anim_index);
+    if (!animFile.open(full_filename, O_RDONLY) || animFile.fileSize() < output->data_size)
+    {
+        Serial.printf("'%s' is missing or shorter than its config file says\n", full_filename);
+        animFile.close();
+        return -1;
+    }
+    uint8_t buf[512];
+    uint32_t crc = 0;
+    for (uint32_t pos = 0; pos < output->data_size; pos += sizeof(buf))
+    {
+        uint32_t len = min((uint32_t)sizeof(buf), output->data_size - pos);
+        if (animFile.read(buf, len) != (int)len)
+        {
+            animFile.close();
+            return -1;
+        }
+        crc = anim_crc32(buf, len, crc);
+    }
+    output->data_crc = crc;
+
+    output->total_duration = output->num_frames;
+    if (output->data_flags & ANIM_DATA_DURATIONS)
+    {
+        output->total_duration = 0;
+        animFile.seekSet(anim_durations_offset(output->num_frames, output->cols, output->rows));
+        for (int f = 0; f < output->num_frames; f++)
+        {
+            uint16_t duration = ANIM_DEFAULT_FRAME_DURATION;
+            animFile.read(&duration, sizeof(duration));
+            output->total_duration += max(duration, (uint16_t)1);
+        }
+    }
+    animFile.close();
+    return 1;
+}
+
+/*\brief Writes a new catalog from the animations in the root folder of the card.
+    Every config file is parsed and every data file read once, so this takes as long as the
+    startup the catalog is there to avoid; call it on the first boot, or when read() fails.
+    The new catalog is written to a temporary file first, so the old one stays usable until
+    the new one is complete. Returns the number of animations found, or -1.
+ */
+int AnimCatalog::rebuild(SdFatSdioEX sd)
+{
+    File root;
+    if (!root.open("/", O_RDONLY))
+    {
+        Serial.println("open root folder failed");
+        return -1;
+    }
+    File catalogFile;
+    if (!catalogFile.open(CATALOG_TEMP_FILENAME, O_RDWR | O_CREAT | O_TRUNC))
+    {
+        Serial.printf("open file: '%s' failed\n", CATALOG_TEMP_FILENAME);
+        root.close();
+        return -1;
+    }
+    AnimCatalogHeader header;
+    header.magic = CATALOG_MAGIC;
+    header.version = CATALOG_VERSION;
+    header.entry_size = sizeof(AnimCatalogEntry);
+    bool ok = catalogFile.write(&header, sizeof(header)) == sizeof(header);
+
+    int found = 0;
+    File entryFile;
+    char name[32];
+    while (ok && entryFile.openNext(&root, O_RDONLY))
+    {
+        unsigned anim_index = 0;
+        char expected[16];
+        bool is_config = !entryFile.isDir() && entryFile.getName(name, sizeof(name)) &&
+                         sscanf(name, "A%u_", &anim_index) == 1 && anim_index <= UINT16_MAX;
+        entryFile.close();
+        if (is_config)
+        {
+            //Only names exactly like the ones Animation writes (8.3 names may be upper case)
+            sprintf(expected, ANIM_CONFIG_FILENAME_FMT, anim_index);
+            is_config = strcasecmp(name, expected) == 0;
+        }
+        AnimCatalogEntry entry;
+        if (!is_config || make_entry(sd, anim_index, &entry) != 1)
+        {
+            continue;
+        }
+        entry.crc = anim_catalog_entry_crc(&entry);
+        ok = catalogFile.write(&entry, sizeof(entry)) == sizeof(entry);
+        found++;
+    }
+    root.close();
+    ok = catalogFile.sync() && ok;
+    catalogFile.close();
+    if (!ok)
+    {
+        Serial.printf("Write to '%s' failed\n", CATALOG_TEMP_FILENAME);
+        return -1;
+    }
+    if (sd.exists(CATALOG_FILENAME) && !sd.remove(CATALOG_FILENAME))
+    {
+        Serial.printf("remove '%s' failed\n", CATALOG_FILENAME);
+        return -1;
+    }
+    if (!sd.rename(CATALOG_TEMP_FILENAME, CATALOG_FILENAME))
+    {
+        Serial.printf("rename '%s' failed\n", CATALOG_TEMP_FILENAME);
+        return -1;
+    }
+    Serial.printf("Catalog rebuilt with %d animations.\n", found);
+    return found;
+}
+
+/*
+*  Finds where the entry of "anim_index" goes: its current entry if the catalog has one
+*  (returns 1), otherwise the first free or damaged slot, or the end of the file (returns 0).
+*  Returns -1 if the file is not a catalog.
+*/
+int AnimCatalog::_find_slot(File *file, uint16_t anim_index, uint32_t *offset)
+{
+    if (!_read_header(file))
+    {
+        return -1;
+    }
+    uint32_t size = file->fileSize();
+    uint32_t free_offset = 0;
+    uint32_t pos = sizeof(AnimCatalogHeader);
+    for (; pos + sizeof(AnimCatalogEntry) <= size; pos += sizeof(AnimCatalogEntry))
+    {
+        AnimCatalogEntry entry;
+        if (file->read(&entry, sizeof(entry)) != sizeof(entry))
+        {
+            break;
+        }
+        bool valid = entry.crc == anim_catalog_entry_crc(&entry);
+        if (valid && entry.in_use && entry.anim_index == anim_index)
+        {
+            *offset = pos;
+            return 1;
+        }
+        if ((!valid || !entry.in_use) && free_offset == 0)
+        {
+            free_offset = pos;
+        }
+    }
+    *offset = (free_offset != 0) ? free_offset : pos;
+    return 0;
+}
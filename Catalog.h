@@ -0,0 +1,54 @@
+/*
+  Catalog.h - one small file listing every animation on the SD card
+  Copyright (c) 2019 Simen E. Sørensen.
+*/
+
+// ensure this library description is only included once
+#ifndef Catalog_h
+#define Catalog_h
+
+#include <Arduino.h>
+#include "SdFat.h"
+#include "Animation.h"
+
+/*
+*  Finding out which animations are on the card, and how large and long they are, would
+*  otherwise mean opening and parsing every config file. The catalog ("CATALOG.bin", see
+*  AnimCatalogEntry in AnimationFormat.h) holds that for every animation, so startup and
+*  playlist planning only read one file:
+*      AnimCatalog catalog;
+*      if (catalog.read(sd) < 0)
+*      {
+*          AnimCatalog::rebuild(sd); //First boot, or the card was filled on a PC
+*          catalog.read(sd);
+*      }
+*      for (int i = 0; i < catalog.get_num_entries(); i++) ... catalog.get_entry(i)->anim_index ...
+*
+*  Animation::save_to_SD_card() and save_modified_to_SD_card() keep an existing catalog up
+*  to date. tools/anim_scan --catalog writes one for a folder on a PC.
+*/
+class AnimCatalog
+{
+public:
+    AnimCatalog();
+    ~AnimCatalog();
+    int     read(SdFatSdioEX sd);
+    int     get_num_entries();
+    int     get_num_damaged();
+    AnimCatalogEntry* get_entry(int idx);
+    AnimCatalogEntry* find(uint16_t anim_index);
+
+    static int update_entry(SdFatSdioEX sd, const AnimCatalogEntry *entry);
+    static int remove_entry(SdFatSdioEX sd, uint16_t anim_index);
+    static int make_entry(SdFatSdioEX sd, uint16_t anim_index, AnimCatalogEntry *output);
+    static int rebuild(SdFatSdioEX sd);
+
+private:
+    AnimCatalogEntry *_entries = nullptr; //Sorted by anim_index
+    int               _num_entries = 0;
+    int               _num_damaged = 0;
+
+    static int        _find_slot(File *file, uint16_t anim_index, uint32_t *offset);
+};
+
+#endif
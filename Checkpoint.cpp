@@ -0,0 +1,131 @@
+#include "Checkpoint.h"
+
+PlaybackCheckpoint::PlaybackCheckpoint(uint16_t file_index)
+{
+    _file_index = file_index;
+}
+
+/*\brief Saves the playback position of "anim" to the next slot of the checkpoint file.
+    Only the 32 byte record is written (the file is created with all its slots the first time),
+    so this is cheap enough to call every few seconds. The SD card must already be started.
+    \param[in] anim_index is the file index "anim" was read from, so that a restore knows what to load.
+    \param[in] playlist_entry is stored as is, for programs that play several animations after each other.
+ */
+int PlaybackCheckpoint::save(SdFatSdioEX sd, Animation *anim, uint16_t anim_index, uint16_t playlist_entry)
+{
+    File checkpointFile;
+    char full_filename[13]; //Max length of filename is 8 chars +".ext" + string terminator
+    sprintf(full_filename, CHECKPOINT_FILENAME_FMT, _file_index);
+    if (!checkpointFile.open(full_filename, O_RDWR | O_CREAT))
+    {
+        Serial.printf("open file: '%s' failed\n", full_filename);
+        return -1;
+    }
+    if (checkpointFile.fileSize() < (uint32_t)CHECKPOINT_SLOTS * CHECKPOINT_SLOT_SIZE)
+    {
+        //New (or damaged) file: give every slot its own sector up front, so that saves never change the file size
+        uint8_t blank[CHECKPOINT_SLOT_SIZE];
+        memset(blank, 0, sizeof(blank));
+        checkpointFile.seekSet(0);
+        for (int i = 0; i < CHECKPOINT_SLOTS; i++)
+        {
+            checkpointFile.write(blank, sizeof(blank));
+        }
+        _next_slot = 0;
+    }
+    else if (_next_slot == -1)
+    {
+        AnimCheckpoint latest;
+        _read_slots(&checkpointFile, &latest);
+    }
+
+    AnimCheckpoint record;
+    memset(&record, 0, sizeof(record));
+    record.magic = CHECKPOINT_MAGIC;
+    record.sequence = ++_sequence;
+    record.playlist_entry = playlist_entry;
+    record.anim_index = anim_index;
+    anim->get_checkpoint(&record);
+    record.crc = anim_checkpoint_crc(&record);
+
+    bool ok = checkpointFile.seekSet((uint32_t)_next_slot * CHECKPOINT_SLOT_SIZE) &&
+              checkpointFile.write(&record, sizeof(record)) == sizeof(record);
+    ok = checkpointFile.sync() && ok;
+    checkpointFile.close();
+    if (!ok)
+    {
+        Serial.printf("Write to '%s' failed\n", full_filename);
+        return -1;
+    }
+    _next_slot = (_next_slot + 1) % CHECKPOINT_SLOTS;
+    return 1;
+}
+
+/*\brief Reads the newest valid checkpoint into "output".
+    Returns -1 if there is no checkpoint file or none of its slots hold a valid record
+    (for example on the very first boot).
+ */
+int PlaybackCheckpoint::read_latest(SdFatSdioEX sd, AnimCheckpoint *output)
+{
+    File checkpointFile;
+    char full_filename[13]; //Max length of filename is 8 chars +".ext" + string terminator
+    sprintf(full_filename, CHECKPOINT_FILENAME_FMT, _file_index);
+    if (!checkpointFile.open(full_filename, O_RDONLY))
+    {
+        Serial.printf("No checkpoint: '%s'\n", full_filename);
+        return -1;
+    }
+    int rtn = _read_slots(&checkpointFile, output);
+    checkpointFile.close();
+    if (rtn != 1)
+    {
+        Serial.printf("No valid checkpoint in: '%s'\n", full_filename);
+    }
+    return rtn;
+}
+
+/*\brief Continues the playback of "anim" from the newest checkpoint.
+    Use this when "anim" is always the same animation. When the checkpoint decides which
+    animation to load, use read_latest() and Animation::restore_checkpoint() instead.
+ */
+int PlaybackCheckpoint::restore(SdFatSdioEX sd, Animation *anim)
+{
+    AnimCheckpoint checkpoint;
+    if (read_latest(sd, &checkpoint) != 1)
+    {
+        return -1;
+    }
+    return anim->restore_checkpoint(&checkpoint);
+}
+
+//Finds the newest valid record, and sets the slot and sequence of the next save to follow it
+int PlaybackCheckpoint::_read_slots(File *file, AnimCheckpoint *output)
+{
+    int newest = -1;
+    for (int i = 0; i < CHECKPOINT_SLOTS; i++)
+    {
+        AnimCheckpoint record;
+        if (!file->seekSet((uint32_t)i * CHECKPOINT_SLOT_SIZE) ||
+            file->read(&record, sizeof(record)) != sizeof(record))
+        {
+            break;
+        }
+        if (record.magic != CHECKPOINT_MAGIC || record.crc != anim_checkpoint_crc(&record))
+        {
+            continue; //Never written, or the power went while it was written
+        }
+        //Compared as a difference so that it keeps working if the sequence ever wraps around
+        if (newest == -1 || (int32_t)(record.sequence - output->sequence) > 0)
+        {
+            *output = record;
+            newest = i;
+        }
+    }
+    _next_slot = (newest + 1) % CHECKPOINT_SLOTS;
+    if (newest == -1)
+    {
+        return -1;
+    }
+    _sequence = output->sequence;
+    return 1;
+}
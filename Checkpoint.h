@@ -0,0 +1,46 @@
+/*
+  Checkpoint.h - saves and restores where the playback is, without rewriting any frames
+  Copyright (c) 2019 Simen E. Sørensen.
+*/
+
+// ensure this library description is only included once
+#ifndef Checkpoint_h
+#define Checkpoint_h
+
+#include <Arduino.h>
+#include "SdFat.h"
+#include "Animation.h"
+
+/*
+*  Keeps the playback position of an animation (and where in a playlist it is) in a small
+*  checkpoint file, "P000_S.bin", that can be saved every few seconds. Saving writes a single
+*  32 byte record, see AnimCheckpoint in AnimationFormat.h for how the slots are rotated.
+*
+*  Resuming after a power cycle:
+*      AnimCheckpoint checkpoint;
+*      if (show_checkpoint.read_latest(sd, &checkpoint) == 1)
+*      {
+*          anim.read_from_SD_card(sd, checkpoint.anim_index);
+*          anim.restore_checkpoint(&checkpoint);
+*          playlist_pos = checkpoint.playlist_entry;
+*      }
+*  and while playing:
+*      show_checkpoint.save(sd, &anim, anim_index, playlist_pos);
+*/
+class PlaybackCheckpoint
+{
+public:
+    PlaybackCheckpoint(uint16_t file_index = 0);
+    int     save(SdFatSdioEX sd, Animation *anim, uint16_t anim_index = 0, uint16_t playlist_entry = 0);
+    int     read_latest(SdFatSdioEX sd, AnimCheckpoint *output);
+    int     restore(SdFatSdioEX sd, Animation *anim);
+
+private:
+    uint16_t _file_index;
+    uint32_t _sequence = 0;
+    int      _next_slot = -1; //-1 until the file has been read, so that the sequence continues where it left off
+
+    int      _read_slots(File *file, AnimCheckpoint *output);
+};
+
+#endif
@@ -0,0 +1,275 @@
+/*
+  FixedFFT.h - fixed point FFT and the energy of frequency bands, for audio reactive playback
+  Copyright (c) 2019 Simen E. Sørensen.
+
+  This header does not depend on Arduino, so that tools/anim_audio.cpp measures exactly the
+  code that runs on the display.
+
+  Samples and spectra are Q15 (int16_t, 32767 is just below 1.0). Every stage of the FFT
+  halves its results, so the output is the DFT divided by the size and can never overflow.
+  The tables (twiddles, window, band edges) are worked out once, in the constructors; after
+  that only integer multiplies, adds and shifts are used.
+*/
+
+#ifndef FixedFFT_h
+#define FixedFFT_h
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+#include "AnimationFormat.h"
+
+#define FFT_MAX_LOG2_SIZE 10                     //Up to 1024 points
+#define AUDIO_LEVEL_ONE   DUTY_CYCLE_RESOLUTION  //Band levels go from 0 to this, so they can be used as intensities
+
+class FixedFFT
+{
+public:
+    // An FFT of 2^log2_size points (clamped to 2...2^FFT_MAX_LOG2_SIZE)
+    explicit FixedFFT(int log2_size = 8)
+    {
+        _log2_size = (log2_size < 1) ? 1 : (log2_size > FFT_MAX_LOG2_SIZE) ? FFT_MAX_LOG2_SIZE : log2_size;
+        const int size = get_size();
+        _cos = new int16_t[size / 2];
+        _sin = new int16_t[size / 2];
+        for (int k = 0; k < size / 2; k++)
+        {
+            double angle = 2.0 * M_PI * k / size;
+            _cos[k] = (int16_t)lround(cos(angle) * 32767.0);
+            _sin[k] = (int16_t)lround(sin(angle) * 32767.0);
+        }
+    }
+    ~FixedFFT()
+    {
+        delete[] _cos;
+        delete[] _sin;
+    }
+    FixedFFT(const FixedFFT &) = delete;
+    FixedFFT &operator=(const FixedFFT &) = delete;
+
+    int get_size() const { return 1 << _log2_size; }
+    int get_log2_size() const { return _log2_size; }
+
+    // In place forward transform of get_size() points. The result is scaled by 1/get_size().
+    void transform(int16_t *re, int16_t *im) const
+    {
+        const int size = get_size();
+        //Bit reversed order, so the butterflies below can work in place
+        for (int i = 1, j = 0; i < size; i++)
+        {
+            int bit = size >> 1;
+            for (; j & bit; bit >>= 1)
+            {
+                j ^= bit;
+            }
+            j ^= bit;
+            if (i < j)
+            {
+                int16_t t = re[i];
+                re[i] = re[j];
+                re[j] = t;
+                t = im[i];
+                im[i] = im[j];
+                im[j] = t;
+            }
+        }
+        for (int half = 1, step = size / 2; half < size; half *= 2, step /= 2)
+        {
+            for (int k = 0; k < half; k++)
+            {
+                //e^(-2*pi*i*k/(2*half))
+                const int32_t wr = _cos[k * step];
+                const int32_t wi = -_sin[k * step];
+                for (int i = k; i < size; i += 2 * half)
+                {
+                    const int j = i + half;
+                    const int32_t tr = (wr * re[j] - wi * im[j]) >> 15;
+                    const int32_t ti = (wr * im[j] + wi * re[j]) >> 15;
+                    re[j] = (re[i] - tr) >> 1;
+                    im[j] = (im[i] - ti) >> 1;
+                    re[i] = (re[i] + tr) >> 1;
+                    im[i] = (im[i] + ti) >> 1;
+                }
+            }
+        }
+    }
+    // Butterflies per transform: the work is the same for every block, whatever the audio is
+    uint32_t get_num_butterflies() const
+    {
+        return (uint32_t)(get_size() / 2) * _log2_size;
+    }
+
+private:
+    int      _log2_size;
+    int16_t *_cos; //cos(2*pi*k/size) for k < size/2, Q15
+    int16_t *_sin;
+};
+
+/*
+*  Splits audio into blocks of the FFT size and turns every block into the level of a few
+*  frequency bands, spaced evenly on a log scale from the lowest bin to half the sample rate
+*  (band 0 is the bass). Levels follow the loudness in decibels rather than the energy itself,
+*  and are measured against the loudest the band has been lately (automatic gain), so quiet
+*  and loud songs both use the whole range 0...AUDIO_LEVEL_ONE. A level drops back slowly
+*  after a peak (see set_release()), so the display does not flicker with every block.
+*
+*  Feed it samples as they arrive (from a file, a buffer, or the ADC); a block is analyzed
+*  as soon as it is full, so the cost per call is at most one FFT per completed block.
+*/
+class AudioBands
+{
+public:
+    AudioBands(int log2_size = 8, int num_bands = 6) : _fft(log2_size < 4 ? 4 : log2_size) //At least 16 points, for 4 bands
+    {
+        const int size = _fft.get_size();
+        _num_bands = (num_bands < 1) ? 1 : (num_bands > size / 4) ? size / 4 : num_bands;
+        _re = new int16_t[size];
+        _im = new int16_t[size];
+        _window = new int16_t[size];
+        for (int i = 0; i < size; i++)
+        {
+            //Hann window: keeps a strong bass note from leaking into every other band
+            _window[i] = (int16_t)lround((0.5 - 0.5 * cos(2.0 * M_PI * i / size)) * 32767.0);
+        }
+        //Band b is bins _band_first[b] ... _band_first[b + 1] - 1; bin 0 (DC) is left out
+        _band_first = new uint16_t[_num_bands + 1];
+        _band_first[0] = 1;
+        for (int b = 1; b <= _num_bands; b++)
+        {
+            int first = (int)lround(pow(size / 2.0, (double)b / _num_bands));
+            _band_first[b] = (first > _band_first[b - 1]) ? first : _band_first[b - 1] + 1;
+        }
+        _band_first[_num_bands] = size / 2;
+        _level = new uint16_t[_num_bands];
+        _peak = new uint16_t[_num_bands];
+        reset();
+    }
+    ~AudioBands()
+    {
+        delete[] _re;
+        delete[] _im;
+        delete[] _window;
+        delete[] _band_first;
+        delete[] _level;
+        delete[] _peak;
+    }
+    AudioBands(const AudioBands &) = delete;
+    AudioBands &operator=(const AudioBands &) = delete;
+
+    void reset()
+    {
+        _fill = 0;
+        _blocks = 0;
+        for (int b = 0; b < _num_bands; b++)
+        {
+            _level[b] = 0;
+            _peak[b] = 0;
+        }
+    }
+    /*
+    *  How many decibels below the recent peak count as silence, as log2 of the energy in
+    *  1/256ths (256 is about 3 dB). Default: 10 * 256 (30 dB).
+    */
+    void set_range(uint16_t range_log2_q8) { _range = (range_log2_q8 == 0) ? 1 : range_log2_q8; }
+    // How much a level may drop per block, in AUDIO_LEVEL_ONE units. Default: AUDIO_LEVEL_ONE / 16.
+    void set_release(uint16_t per_block) { _release = per_block; }
+    // How much the peak (the loudest the band has been) drops per block, as log2 in 1/256ths. Default: 2.
+    void set_peak_decay(uint16_t per_block) { _peak_decay = per_block; }
+
+    /*
+    *  Adds "count" samples, taking every "stride"th value of "samples" (2 for one channel of
+    *  interleaved stereo). Returns the number of blocks that were completed and analyzed.
+    */
+    int feed(const int16_t *samples, int count, int stride = 1)
+    {
+        const int size = _fft.get_size();
+        int completed = 0;
+        for (int i = 0; i < count; i++)
+        {
+            _re[_fill++] = samples[i * stride];
+            if (_fill == size)
+            {
+                _analyze();
+                _fill = 0;
+                completed++;
+            }
+        }
+        return completed;
+    }
+
+    int      get_num_bands() const { return _num_bands; }
+    int      get_block_size() const { return _fft.get_size(); }
+    uint32_t get_num_blocks() const { return _blocks; }
+    const FixedFFT &get_fft() const { return _fft; }
+    // Level of a band after the last block, 0 (silent) ... AUDIO_LEVEL_ONE (as loud as it gets)
+    uint16_t get_level(int band) const
+    {
+        return (band < 0 || band >= _num_bands) ? 0 : _level[band];
+    }
+    // The FFT bins of a band; bin n is n * sample_rate / get_block_size() Hz
+    void get_band_bins(int band, int *first, int *last) const
+    {
+        *first = _band_first[band];
+        *last = _band_first[band + 1] - 1;
+    }
+
+private:
+    FixedFFT  _fft;
+    int       _num_bands;
+    int16_t  *_re;
+    int16_t  *_im;
+    int16_t  *_window;     //Q15
+    uint16_t *_band_first;
+    uint16_t *_level;
+    uint16_t *_peak;       //Loudest recent energy of every band, log2 in 1/256ths
+    int       _fill = 0;   //Samples in the current block
+    uint32_t  _blocks = 0;
+    uint16_t  _range = 10 * 256;
+    uint16_t  _release = AUDIO_LEVEL_ONE / 16;
+    uint16_t  _peak_decay = 2;
+
+    // log2(value) in 1/256ths, with the fraction taken from the bits below the top one
+    static uint16_t _log2_q8(uint64_t value)
+    {
+        if (value == 0)
+        {
+            return 0;
+        }
+        int top = 63 - __builtin_clzll(value);
+        uint32_t fraction = (top >= 8) ? (uint32_t)(value >> (top - 8)) : (uint32_t)(value << (8 - top));
+        return (uint16_t)(top * 256 + (fraction & 0xFF));
+    }
+
+    void _analyze()
+    {
+        const int size = _fft.get_size();
+        for (int i = 0; i < size; i++)
+        {
+            _re[i] = ((int32_t)_re[i] * _window[i]) >> 15;
+            _im[i] = 0;
+        }
+        _fft.transform(_re, _im);
+        for (int b = 0; b < _num_bands; b++)
+        {
+            uint64_t energy = 0;
+            for (int k = _band_first[b]; k < _band_first[b + 1]; k++)
+            {
+                energy += (uint32_t)((int32_t)_re[k] * _re[k]) + (uint32_t)((int32_t)_im[k] * _im[k]);
+            }
+            //The average per bin, so that wide (high) bands are not louder just for having more bins.
+            //Scaled up first, since the spectrum of quiet audio is only a few units per bin.
+            uint16_t loudness = _log2_q8((energy << 16) / (_band_first[b + 1] - _band_first[b]));
+
+            uint16_t peak = (_peak[b] > _peak_decay) ? _peak[b] - _peak_decay : 0;
+            _peak[b] = (loudness > peak) ? loudness : peak;
+            int32_t above_floor = (int32_t)loudness - ((int32_t)_peak[b] - _range);
+            uint16_t level = (above_floor <= 0) ? 0 : (above_floor >= _range) ? AUDIO_LEVEL_ONE : (uint16_t)(above_floor * AUDIO_LEVEL_ONE / _range);
+            //Rises at once, falls slowly
+            uint16_t released = (_level[b] > _release) ? _level[b] - _release : 0;
+            _level[b] = (level > released) ? level : released;
+        }
+        _blocks++;
+    }
+};
+
+#endif
@@ -0,0 +1,315 @@
+#include "FrameGenerator.h"
+
+//A quarter of a sine wave, FIXED_SIN_ONE * sin(i/64 * 90 degrees)
+static const int16_t quarter_sine[65] = {
+    0, 101, 201, 301, 401, 501, 601, 700, 799, 897, 995, 1092, 1189, 1285, 1380, 1474,
+    1567, 1660, 1751, 1842, 1931, 2019, 2106, 2191, 2276, 2359, 2440, 2520, 2598, 2675, 2751, 2824,
+    2896, 2967, 3035, 3102, 3166, 3229, 3290, 3349, 3406, 3461, 3513, 3564, 3612, 3659, 3703, 3745,
+    3784, 3822, 3857, 3889, 3920, 3948, 3973, 3996, 4017, 4036, 4052, 4065, 4076, 4085, 4091, 4095,
+    4096};
+
+//pos is 0...0x4000 (0 to 90 degrees)
+static int16_t _quarter_sin(uint32_t pos)
+{
+    uint32_t i = pos >> 8;
+    if (i >= 64)
+    {
+        return quarter_sine[64];
+    }
+    int32_t frac = pos & 0xFF;
+    return quarter_sine[i] + (((quarter_sine[i + 1] - quarter_sine[i]) * frac) >> 8);
+}
+
+int16_t fixed_sin(uint16_t angle)
+{
+    uint32_t pos = angle & 0x3FFF;
+    switch (angle >> 14)
+    {
+    case 0:
+        return _quarter_sin(pos);
+    case 1:
+        return _quarter_sin(0x4000 - pos);
+    case 2:
+        return -_quarter_sin(pos);
+    default:
+        return -_quarter_sin(0x4000 - pos);
+    }
+}
+
+uint32_t fixed_sqrt(uint32_t value)
+{
+    uint32_t result = 0;
+    uint32_t bit = 1UL << 30;
+    while (bit > value)
+    {
+        bit >>= 2;
+    }
+    while (bit != 0)
+    {
+        if (value >= result + bit)
+        {
+            value -= result + bit;
+            result = (result >> 1) + bit;
+        }
+        else
+        {
+            result >>= 1;
+        }
+        bit >>= 2;
+    }
+    return result;
+}
+
+//Distance in Q4 from pixel (x,y) to a point given in Q4
+static inline uint32_t _distance_q4(int x, int y, int point_x_q4, int point_y_q4)
+{
+    int32_t dx = x * Q4_ONE - point_x_q4;
+    int32_t dy = y * Q4_ONE - point_y_q4;
+    return fixed_sqrt(dx * dx + dy * dy);
+}
+
+//amplitude * (width - distance) / width, or 0 if distance is outside of width
+static inline uint16_t _falloff(uint32_t distance, int width, uint16_t amplitude)
+{
+    if (distance >= (uint32_t)width)
+    {
+        return 0;
+    }
+    return (uint32_t)amplitude * (width - distance) / width;
+}
+
+/*
+*  RippleGenerator
+*/
+RippleGenerator::RippleGenerator(int center_x_q4, int center_y_q4, int wavelength_q4, int period, uint16_t amplitude)
+{
+    set_center(center_x_q4, center_y_q4);
+    set_wavelength(wavelength_q4);
+    set_period(period);
+    set_amplitude(amplitude);
+}
+void RippleGenerator::render(Frame *output, uint32_t t)
+{
+    uint16_t *pixels = output->get_pixel_intensities();
+    const int cols = output->get_width();
+    const int rows = output->get_height();
+    //How far the waves have moved, as an angle
+    uint16_t time_angle = (uint16_t)((((uint64_t)(t % _period)) << 16) / _period);
+    for (int y = 0; y < rows; y++)
+    {
+        for (int x = 0; x < cols; x++)
+        {
+            uint32_t distance = _distance_q4(x, y, _center_x, _center_y);
+            uint16_t angle = (uint16_t)((distance << 16) / _wavelength) - time_angle;
+            pixels[y * cols + x] = ((uint32_t)(fixed_sin(angle) + FIXED_SIN_ONE) * _amplitude) >> 13;
+        }
+    }
+}
+void RippleGenerator::set_center(int center_x_q4, int center_y_q4)
+{
+    _center_x = center_x_q4;
+    _center_y = center_y_q4;
+    _revision++;
+}
+void RippleGenerator::set_wavelength(int wavelength_q4)
+{
+    _wavelength = max(wavelength_q4, 1);
+    _revision++;
+}
+void RippleGenerator::set_period(int period)
+{
+    _period = max(period, 1);
+    _revision++;
+}
+void RippleGenerator::set_amplitude(uint16_t amplitude)
+{
+    _amplitude = amplitude > DUTY_CYCLE_RESOLUTION ? DUTY_CYCLE_RESOLUTION : amplitude;
+    _revision++;
+}
+
+/*
+*  RadialPulseGenerator
+*/
+RadialPulseGenerator::RadialPulseGenerator(int center_x_q4, int center_y_q4, int max_radius_q4, int width_q4, int period, uint16_t amplitude)
+{
+    set_center(center_x_q4, center_y_q4);
+    set_max_radius(max_radius_q4);
+    set_width(width_q4);
+    set_period(period);
+    set_amplitude(amplitude);
+}
+void RadialPulseGenerator::render(Frame *output, uint32_t t)
+{
+    uint16_t *pixels = output->get_pixel_intensities();
+    const int cols = output->get_width();
+    const int rows = output->get_height();
+    int32_t radius = (int32_t)((t % _period) * _max_radius / _period);
+    for (int y = 0; y < rows; y++)
+    {
+        for (int x = 0; x < cols; x++)
+        {
+            int32_t from_ring = (int32_t)_distance_q4(x, y, _center_x, _center_y) - radius;
+            pixels[y * cols + x] = _falloff(from_ring < 0 ? -from_ring : from_ring, _width, _amplitude);
+        }
+    }
+}
+void RadialPulseGenerator::set_center(int center_x_q4, int center_y_q4)
+{
+    _center_x = center_x_q4;
+    _center_y = center_y_q4;
+    _revision++;
+}
+void RadialPulseGenerator::set_max_radius(int max_radius_q4)
+{
+    _max_radius = max(max_radius_q4, 0);
+    _revision++;
+}
+void RadialPulseGenerator::set_width(int width_q4)
+{
+    _width = max(width_q4, 1);
+    _revision++;
+}
+void RadialPulseGenerator::set_period(int period)
+{
+    _period = max(period, 1);
+    _revision++;
+}
+void RadialPulseGenerator::set_amplitude(uint16_t amplitude)
+{
+    _amplitude = amplitude > DUTY_CYCLE_RESOLUTION ? DUTY_CYCLE_RESOLUTION : amplitude;
+    _revision++;
+}
+
+/*
+*  NoiseGenerator
+*/
+NoiseGenerator::NoiseGenerator(uint32_t seed, int cell_size_q4, int ticks_per_step, uint16_t amplitude)
+{
+    set_seed(seed);
+    set_cell_size(cell_size_q4);
+    set_ticks_per_step(ticks_per_step);
+    set_amplitude(amplitude);
+}
+void NoiseGenerator::render(Frame *output, uint32_t t)
+{
+    uint16_t *pixels = output->get_pixel_intensities();
+    const int cols = output->get_width();
+    const int rows = output->get_height();
+    //Position between two random fields in time (Q8)
+    int t_cell = t / _ticks_per_step;
+    int32_t t_frac = ((t % _ticks_per_step) << 8) / _ticks_per_step;
+    for (int y = 0; y < rows; y++)
+    {
+        int32_t gy = (y * Q4_ONE << 8) / _cell_size; //Position in the lattice (Q8)
+        int y_cell = gy >> 8;
+        int32_t y_frac = gy & 0xFF;
+        for (int x = 0; x < cols; x++)
+        {
+            int32_t gx = (x * Q4_ONE << 8) / _cell_size;
+            int x_cell = gx >> 8;
+            int32_t x_frac = gx & 0xFF;
+            int32_t slice[2];
+            for (int i = 0; i < 2; i++)
+            {
+                int32_t bottom = _lattice(x_cell, y_cell, t_cell + i) * (256 - x_frac) + _lattice(x_cell + 1, y_cell, t_cell + i) * x_frac;
+                int32_t top = _lattice(x_cell, y_cell + 1, t_cell + i) * (256 - x_frac) + _lattice(x_cell + 1, y_cell + 1, t_cell + i) * x_frac;
+                slice[i] = ((bottom >> 8) * (256 - y_frac) + (top >> 8) * y_frac) >> 8;
+            }
+            uint32_t value = (slice[0] * (256 - t_frac) + slice[1] * t_frac) >> 8; //0...4095
+            pixels[y * cols + x] = (value * _amplitude) >> 12;
+        }
+    }
+}
+void NoiseGenerator::set_seed(uint32_t seed)
+{
+    _seed = seed;
+    _revision++;
+}
+void NoiseGenerator::set_cell_size(int cell_size_q4)
+{
+    _cell_size = max(cell_size_q4, 1);
+    _revision++;
+}
+void NoiseGenerator::set_ticks_per_step(int ticks_per_step)
+{
+    _ticks_per_step = max(ticks_per_step, 1);
+    _revision++;
+}
+void NoiseGenerator::set_amplitude(uint16_t amplitude)
+{
+    _amplitude = amplitude > DUTY_CYCLE_RESOLUTION ? DUTY_CYCLE_RESOLUTION : amplitude;
+    _revision++;
+}
+//Random value 0...4095 for a lattice point, always the same for the same point and seed
+uint16_t NoiseGenerator::_lattice(int x, int y, int t)
+{
+    uint32_t h = _seed ^ ((uint32_t)x * 0x8DA6B343UL) ^ ((uint32_t)y * 0xD8163841UL) ^ ((uint32_t)t * 0xCB1AB31FUL);
+    h ^= h >> 15;
+    h *= 0x2C1B3C6DUL;
+    h ^= h >> 12;
+    h *= 0x297A2D39UL;
+    h ^= h >> 15;
+    return h >> 20;
+}
+
+/*
+*  ScanningBarGenerator
+*/
+ScanningBarGenerator::ScanningBarGenerator(bool vertical, int width_q4, int period, uint16_t amplitude)
+{
+    set_vertical(vertical);
+    set_width(width_q4);
+    set_period(period);
+    set_amplitude(amplitude);
+}
+void ScanningBarGenerator::render(Frame *output, uint32_t t)
+{
+    uint16_t *pixels = output->get_pixel_intensities();
+    const int cols = output->get_width();
+    const int rows = output->get_height();
+    //Triangle wave: the bar moves from the first to the last column (or row) in the first half of the period, and back in the second
+    int32_t travel = ((_vertical ? cols : rows) - 1) * Q4_ONE;
+    int32_t phase = t % _period;
+    int32_t half = _period / 2;
+    int32_t position;
+    if (half == 0)
+    {
+        position = 0;
+    }
+    else if (phase < half)
+    {
+        position = phase * travel / half;
+    }
+    else
+    {
+        position = (_period - phase) * travel / (_period - half);
+    }
+    for (int y = 0; y < rows; y++)
+    {
+        for (int x = 0; x < cols; x++)
+        {
+            int32_t from_bar = (_vertical ? x : y) * Q4_ONE - position;
+            pixels[y * cols + x] = _falloff(from_bar < 0 ? -from_bar : from_bar, _width, _amplitude);
+        }
+    }
+}
+void ScanningBarGenerator::set_vertical(bool vertical)
+{
+    _vertical = vertical;
+    _revision++;
+}
+void ScanningBarGenerator::set_width(int width_q4)
+{
+    _width = max(width_q4, 1);
+    _revision++;
+}
+void ScanningBarGenerator::set_period(int period)
+{
+    _period = max(period, 1);
+    _revision++;
+}
+void ScanningBarGenerator::set_amplitude(uint16_t amplitude)
+{
+    _amplitude = amplitude > DUTY_CYCLE_RESOLUTION ? DUTY_CYCLE_RESOLUTION : amplitude;
+    _revision++;
+}
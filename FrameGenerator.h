@@ -0,0 +1,119 @@
+/*
+  FrameGenerator.h - frames computed from (x, y, t) instead of stored
+  Copyright (c) 2019 Simen E. Sørensen.
+*/
+
+// ensure this library description is only included once
+#ifndef FrameGenerator_h
+#define FrameGenerator_h
+
+#include <Arduino.h>
+#include "Animation.h"
+
+/*
+*  Fixed-point helpers used by the generators.
+*  Angles are given in 1/65536 of a full turn, results of fixed_sin() are in the range -4096...4096.
+*  Coordinates and distances passed to the generators are in 1/16 pixel (Q4).
+*/
+#define FIXED_SIN_ONE 4096
+#define Q4_ONE        16
+
+int16_t  fixed_sin(uint16_t angle);
+uint32_t fixed_sqrt(uint32_t value);
+
+/*
+*  Base class for anything that can compute a frame on demand.
+*  Pass a generator to Animation::set_generator() to play it like a stored animation.
+*/
+class FrameGenerator
+{
+public:
+    virtual ~FrameGenerator() {}
+    // Writes the frame at time "t" (in ticks) to "output". "output" is never a view.
+    virtual void render(Frame *output, uint32_t t) = 0;
+    // Increases every time a parameter changes, so that cached frames can be rendered again.
+    uint32_t     get_revision() { return _revision; }
+
+protected:
+    uint32_t     _revision = 0;
+};
+
+// Rings moving outwards from a center point, like ripples in water
+class RippleGenerator : public FrameGenerator
+{
+public:
+    RippleGenerator(int center_x_q4, int center_y_q4, int wavelength_q4 = 4 * Q4_ONE, int period = 30, uint16_t amplitude = DUTY_CYCLE_RESOLUTION);
+    void render(Frame *output, uint32_t t);
+    void set_center(int center_x_q4, int center_y_q4);
+    void set_wavelength(int wavelength_q4);
+    void set_period(int period);
+    void set_amplitude(uint16_t amplitude);
+
+private:
+    int      _center_x;
+    int      _center_y;
+    int      _wavelength;
+    int      _period;
+    uint16_t _amplitude;
+};
+
+// A single ring growing from a center point until it reaches max_radius, then starting over
+class RadialPulseGenerator : public FrameGenerator
+{
+public:
+    RadialPulseGenerator(int center_x_q4, int center_y_q4, int max_radius_q4 = 10 * Q4_ONE, int width_q4 = 2 * Q4_ONE, int period = 30, uint16_t amplitude = DUTY_CYCLE_RESOLUTION);
+    void render(Frame *output, uint32_t t);
+    void set_center(int center_x_q4, int center_y_q4);
+    void set_max_radius(int max_radius_q4);
+    void set_width(int width_q4);
+    void set_period(int period);
+    void set_amplitude(uint16_t amplitude);
+
+private:
+    int      _center_x;
+    int      _center_y;
+    int      _max_radius;
+    int      _width;
+    int      _period;
+    uint16_t _amplitude;
+};
+
+// Smoothly changing random field (value noise)
+class NoiseGenerator : public FrameGenerator
+{
+public:
+    NoiseGenerator(uint32_t seed = 1, int cell_size_q4 = 4 * Q4_ONE, int ticks_per_step = 10, uint16_t amplitude = DUTY_CYCLE_RESOLUTION);
+    void render(Frame *output, uint32_t t);
+    void set_seed(uint32_t seed);
+    void set_cell_size(int cell_size_q4);
+    void set_ticks_per_step(int ticks_per_step);
+    void set_amplitude(uint16_t amplitude);
+
+private:
+    uint32_t _seed;
+    int      _cell_size;
+    int      _ticks_per_step;
+    uint16_t _amplitude;
+
+    uint16_t _lattice(int x, int y, int t);
+};
+
+// A bar moving back and forth across the display, either vertical (sweeping along x) or horizontal
+class ScanningBarGenerator : public FrameGenerator
+{
+public:
+    ScanningBarGenerator(bool vertical = true, int width_q4 = 2 * Q4_ONE, int period = 40, uint16_t amplitude = DUTY_CYCLE_RESOLUTION);
+    void render(Frame *output, uint32_t t);
+    void set_vertical(bool vertical);
+    void set_width(int width_q4);
+    void set_period(int period);
+    void set_amplitude(uint16_t amplitude);
+
+private:
+    bool     _vertical;
+    int      _width;
+    int      _period;
+    uint16_t _amplitude;
+};
+
+#endif
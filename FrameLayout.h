@@ -0,0 +1,195 @@
+/*
+  FrameLayout.h - where the pixels of a frame, or of a view of one, are stored
+  Copyright (c) 2019 Simen E. Sørensen.
+
+  This header does not depend on Arduino, so that tools/anim_fuzz.cpp can run the view and
+  merge code of Frame on a PC and check it against a plain pixel by pixel model.
+
+  Pixel (x, y) of a frame with "cols" columns is stored at
+      pixels[(y * y_dir + y_start) * cols + x * x_dir + x_start]
+  for x_first <= x <= x_last and y_first <= y <= y_last, and reads as zero everywhere else.
+  Normal frames step by one from the first stored pixel. Views (Frame::get_view()) borrow the
+  pixels of another frame and mirror, move and clip them by changing the layout only.
+*/
+
+#ifndef FrameLayout_h
+#define FrameLayout_h
+
+#include <stdint.h>
+#include <string.h>
+#include "BlendModes.h"
+
+struct FrameLayout
+{
+    int x_dir;
+    int x_start;
+    int y_dir;
+    int y_start;
+    //The pixels that map to a stored pixel
+    int x_first;
+    int x_last;
+    int y_first;
+    int y_last;
+};
+
+// a / b rounded down, also for negative "a" (b > 0). Used to split q4 positions into whole pixels
+inline int floor_div(int a, int b)
+{
+    return (a >= 0) ? a / b : -((-a + b - 1) / b);
+}
+
+// Layout of a normal cols*rows frame
+inline FrameLayout frame_layout(int cols, int rows)
+{
+    return FrameLayout{1, 0, 1, 0, 0, cols - 1, 0, rows - 1};
+}
+
+inline bool frame_layout_is_plain(const FrameLayout &layout, int cols, int rows)
+{
+    return layout.x_dir == 1 && layout.y_dir == 1 && layout.x_start == 0 && layout.y_start == 0 &&
+           layout.x_first == 0 && layout.y_first == 0 && layout.x_last == cols - 1 && layout.y_last == rows - 1;
+}
+
+/*
+*  Layout of a view of a frame laid out as "of" (with the same size). The view reads pixel (x,y)
+*  from (T(x - offset_x), T(y - offset_y)) of that frame, where T mirrors the coordinate if asked to.
+*  The visible part of the frame is moved the same way, and clipped to the size of the view.
+*/
+inline FrameLayout frame_layout_view(const FrameLayout &of, int cols, int rows, bool mirror_x, bool mirror_y, int offset_x, int offset_y)
+{
+    FrameLayout view;
+    if (mirror_x)
+    {
+        view.x_dir = -of.x_dir;
+        view.x_start = (cols - 1 + offset_x) * of.x_dir + of.x_start;
+        view.x_first = cols - 1 + offset_x - of.x_last;
+        view.x_last = cols - 1 + offset_x - of.x_first;
+    }
+    else
+    {
+        view.x_dir = of.x_dir;
+        view.x_start = of.x_start - offset_x * of.x_dir;
+        view.x_first = of.x_first + offset_x;
+        view.x_last = of.x_last + offset_x;
+    }
+    if (mirror_y)
+    {
+        view.y_dir = -of.y_dir;
+        view.y_start = (rows - 1 + offset_y) * of.y_dir + of.y_start;
+        view.y_first = rows - 1 + offset_y - of.y_last;
+        view.y_last = rows - 1 + offset_y - of.y_first;
+    }
+    else
+    {
+        view.y_dir = of.y_dir;
+        view.y_start = of.y_start - offset_y * of.y_dir;
+        view.y_first = of.y_first + offset_y;
+        view.y_last = of.y_last + offset_y;
+    }
+    view.x_first = (view.x_first > 0) ? view.x_first : 0;
+    view.x_last = (view.x_last < cols - 1) ? view.x_last : cols - 1;
+    view.y_first = (view.y_first > 0) ? view.y_first : 0;
+    view.y_last = (view.y_last < rows - 1) ? view.y_last : rows - 1;
+    return view;
+}
+
+// Index in the stored pixels of pixel (x,y), or -1 if it reads as zero
+inline int frame_layout_index(const FrameLayout &layout, int cols, int x, int y)
+{
+    if (x < layout.x_first || x > layout.x_last || y < layout.y_first || y > layout.y_last)
+    {
+        return -1;
+    }
+    return (y * layout.y_dir + layout.y_start) * cols + x * layout.x_dir + layout.x_start;
+}
+
+// Writes the cols*rows pixels as they are seen through the layout to "output", row by row
+inline void frame_layout_copy(const FrameLayout &layout, const uint16_t *pixels, int cols, int rows, uint16_t *output)
+{
+    for (int y = 0; y < rows; y++)
+    {
+        uint16_t *out_row = &output[y * cols];
+        if (y < layout.y_first || y > layout.y_last)
+        {
+            memset(out_row, 0, cols * sizeof(uint16_t));
+            continue;
+        }
+        const uint16_t *src = &pixels[(y * layout.y_dir + layout.y_start) * cols + layout.x_start];
+        for (int x = 0; x < cols; x++)
+        {
+            out_row[x] = (x < layout.x_first || x > layout.x_last) ? 0 : src[x * layout.x_dir];
+        }
+    }
+}
+
+/*
+*  Blends every pixel of "src" into the pixels of "dst" it overlaps, with the bottom left corner
+*  of "src" at (x, y) in "dst". Only the overlapping rectangle is visited, one row at a time,
+*  stepping through the stored pixels of both directly, so that views cost the same as normal
+*  frames. Returns false if nothing overlapped (and nothing was written).
+*/
+template <typename Blend>
+inline bool blend_frames(uint16_t *dst, const FrameLayout &dst_layout, int dst_cols,
+                         const uint16_t *src, const FrameLayout &src_layout, int src_cols,
+                         int x, int y, Blend blend)
+{
+    //Overlap in the coordinates of "src"
+    int x_first = (src_layout.x_first > dst_layout.x_first - x) ? src_layout.x_first : dst_layout.x_first - x;
+    int x_last = (src_layout.x_last < dst_layout.x_last - x) ? src_layout.x_last : dst_layout.x_last - x;
+    int y_first = (src_layout.y_first > dst_layout.y_first - y) ? src_layout.y_first : dst_layout.y_first - y;
+    int y_last = (src_layout.y_last < dst_layout.y_last - y) ? src_layout.y_last : dst_layout.y_last - y;
+    if (x_first > x_last || y_first > y_last)
+    {
+        return false;
+    }
+    const int count = x_last - x_first + 1;
+    for (int sy = y_first; sy <= y_last; sy++)
+    {
+        const uint16_t *src_row = &src[(sy * src_layout.y_dir + src_layout.y_start) * src_cols +
+                                       x_first * src_layout.x_dir + src_layout.x_start];
+        uint16_t *dst_row = &dst[((sy + y) * dst_layout.y_dir + dst_layout.y_start) * dst_cols +
+                                 (x_first + x) * dst_layout.x_dir + dst_layout.x_start];
+        blend_row(dst_row, dst_layout.x_dir, src_row, src_layout.x_dir, count, blend);
+    }
+    return true;
+}
+
+/*
+*  blend_frames() with the blend given by "mode" (see BlendModes.h). The mode is only looked at
+*  once per frame: every mode has its own copy of the loop. "weight" is only used by
+*  BLEND_WEIGHTED, as the share of "src" in the result.
+*  Returns 1 if pixels were blended, 0 if nothing overlapped and -1 if the mode is unknown.
+*/
+inline int blend_frames_with_mode(uint16_t *dst, const FrameLayout &dst_layout, int dst_cols,
+                                  const uint16_t *src, const FrameLayout &src_layout, int src_cols,
+                                  int x, int y, BlendMode mode, uint16_t weight)
+{
+    bool blended;
+    switch (mode)
+    {
+    case BLEND_ADD:
+        blended = blend_frames(dst, dst_layout, dst_cols, src, src_layout, src_cols, x, y, BlendAdd());
+        break;
+    case BLEND_MAX:
+        blended = blend_frames(dst, dst_layout, dst_cols, src, src_layout, src_cols, x, y, BlendMax());
+        break;
+    case BLEND_REPLACE:
+        blended = blend_frames(dst, dst_layout, dst_cols, src, src_layout, src_cols, x, y, BlendReplace());
+        break;
+    case BLEND_MULTIPLY:
+        blended = blend_frames(dst, dst_layout, dst_cols, src, src_layout, src_cols, x, y, BlendMultiply());
+        break;
+    case BLEND_SUBTRACT:
+        blended = blend_frames(dst, dst_layout, dst_cols, src, src_layout, src_cols, x, y, BlendSubtract());
+        break;
+    case BLEND_WEIGHTED:
+        blended = blend_frames(dst, dst_layout, dst_cols, src, src_layout, src_cols, x, y,
+                               BlendWeighted{weight < DUTY_CYCLE_RESOLUTION ? weight : (uint32_t)DUTY_CYCLE_RESOLUTION});
+        break;
+    default:
+        return -1;
+    }
+    return blended ? 1 : 0;
+}
+
+#endif
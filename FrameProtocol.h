@@ -0,0 +1,269 @@
+/*
+  FrameProtocol.h - packets for streaming frames to the display over a serial link
+  Copyright (c) 2019 Simen E. Sørensen.
+
+  This header does not depend on Arduino, so that the host tools (tools/anim_stream.cpp)
+  and the display (FrameReceiver.h) encode and decode exactly the same bytes.
+
+  Packet (all numbers little endian):
+    0xA5 0x5A                 sync bytes
+    type          1 byte      FRAME_PACKET_KEY or FRAME_PACKET_DELTA
+    seq           1 byte      increases by one for every frame, so lost packets are noticed
+    payload_len   2 bytes
+    frame_crc     4 bytes     anim_crc32() of the whole frame (cols*rows uint16_t) after this packet
+    payload       payload_len bytes
+    packet_crc    4 bytes     anim_crc32() of everything from type to the end of the payload
+
+  Key frame payload: cols (1 byte), rows (1 byte), then every pixel (uint16_t, row by row).
+  Delta payload: runs of changed pixels since the previous frame, each run is
+    start (2 bytes, pixel index), count (1 byte), then count pixels (uint16_t).
+  A delta is only applied to the frame with the previous seq. If a packet is lost or the
+  frame CRC does not match, deltas are ignored until the next key frame, which the sender
+  sends at least every FRAME_KEY_INTERVAL frames.
+*/
+
+#ifndef FrameProtocol_h
+#define FrameProtocol_h
+
+#include <stdint.h>
+#include <string.h>
+#include "AnimationFormat.h"
+
+#define FRAME_SYNC_0         0xA5
+#define FRAME_SYNC_1         0x5A
+#define FRAME_PACKET_KEY     1
+#define FRAME_PACKET_DELTA   2
+#define FRAME_HEADER_SIZE    10 //sync, type, seq, payload_len, frame_crc
+#define FRAME_MAX_PIXELS     1024
+#define FRAME_MAX_PAYLOAD    (2 + FRAME_MAX_PIXELS * 2)
+#define FRAME_MAX_PACKET     (FRAME_HEADER_SIZE + FRAME_MAX_PAYLOAD + 4)
+#define FRAME_KEY_INTERVAL   60
+//Unchanged pixels between two changed ones are sent as part of a run if the gap is at most this long,
+//since starting a new run costs 3 bytes (1.5 pixels)
+#define FRAME_DELTA_MAX_GAP  1
+
+inline void frame_put_u16(uint8_t *out, uint16_t value)
+{
+    out[0] = value & 0xFF;
+    out[1] = value >> 8;
+}
+inline void frame_put_u32(uint8_t *out, uint32_t value)
+{
+    frame_put_u16(out, value & 0xFFFF);
+    frame_put_u16(out + 2, value >> 16);
+}
+inline uint16_t frame_get_u16(const uint8_t *in)
+{
+    return in[0] | (in[1] << 8);
+}
+inline uint32_t frame_get_u32(const uint8_t *in)
+{
+    return frame_get_u16(in) | ((uint32_t)frame_get_u16(in + 2) << 16);
+}
+inline uint32_t frame_pixels_crc(const uint16_t *pixels, int num_pixels)
+{
+    //CRC of the little endian bytes, the same on the PC and the Teensy
+    uint32_t crc = 0;
+    for (int i = 0; i < num_pixels; i++)
+    {
+        uint8_t bytes[2];
+        frame_put_u16(bytes, pixels[i]);
+        crc = anim_crc32(bytes, 2, crc);
+    }
+    return crc;
+}
+
+/*
+*  Writes a packet for "frame" to "out" (at least FRAME_MAX_PACKET bytes) and returns its size,
+*  or 0 if the frame is too large. A delta against "prev" is sent if "prev" is given and the
+*  delta is smaller than a key frame, otherwise a key frame.
+*/
+inline int frame_encode(const uint16_t *frame, const uint16_t *prev, int cols, int rows, uint8_t seq, uint8_t *out)
+{
+    const int num_pixels = cols * rows;
+    if (num_pixels > FRAME_MAX_PIXELS || cols > 255 || rows > 255 || cols <= 0 || rows <= 0)
+    {
+        return 0;
+    }
+    uint8_t *payload = out + FRAME_HEADER_SIZE;
+    const int key_len = 2 + num_pixels * 2;
+    int len = 0;
+    uint8_t type = FRAME_PACKET_KEY;
+    if (prev != nullptr)
+    {
+        type = FRAME_PACKET_DELTA;
+        int i = 0;
+        while (i < num_pixels && len < key_len)
+        {
+            if (frame[i] == prev[i])
+            {
+                i++;
+                continue;
+            }
+            //Extend the run while pixels change, bridging short gaps of unchanged pixels
+            int start = i;
+            int end = i + 1; //One past the last changed pixel in the run
+            int j = end;
+            while (j < num_pixels && j - start < 255 && j - end <= FRAME_DELTA_MAX_GAP)
+            {
+                if (frame[j] != prev[j])
+                {
+                    end = j + 1;
+                }
+                j++;
+            }
+            int count = end - start;
+            if (len + 3 + count * 2 > key_len)
+            {
+                len = key_len; //A key frame is smaller
+                break;
+            }
+            frame_put_u16(&payload[len], start);
+            payload[len + 2] = count;
+            len += 3;
+            for (int k = start; k < end; k++)
+            {
+                frame_put_u16(&payload[len], frame[k]);
+                len += 2;
+            }
+            i = end;
+        }
+        if (len >= key_len)
+        {
+            type = FRAME_PACKET_KEY;
+        }
+    }
+    if (type == FRAME_PACKET_KEY)
+    {
+        payload[0] = cols;
+        payload[1] = rows;
+        for (int i = 0; i < num_pixels; i++)
+        {
+            frame_put_u16(&payload[2 + i * 2], frame[i]);
+        }
+        len = key_len;
+    }
+    out[0] = FRAME_SYNC_0;
+    out[1] = FRAME_SYNC_1;
+    out[2] = type;
+    out[3] = seq;
+    frame_put_u16(&out[4], len);
+    frame_put_u32(&out[6], frame_pixels_crc(frame, num_pixels));
+    frame_put_u32(&payload[len], anim_crc32(&out[2], FRAME_HEADER_SIZE - 2 + len));
+    return FRAME_HEADER_SIZE + len + 4;
+}
+
+/*
+*  Receiving side: feed every received byte to frame_decoder_push(). The decoder keeps the
+*  current frame in "pixels" and applies key frames and deltas to it as they are completed.
+*/
+struct FrameDecoder
+{
+    uint8_t  packet[FRAME_MAX_PACKET];
+    int      received = 0; //Bytes of the current packet received so far
+    uint16_t pixels[FRAME_MAX_PIXELS];
+    int      cols = 0;
+    int      rows = 0;
+    bool     in_sync = false; //false until a key frame has been applied, and after a lost packet
+    uint8_t  seq = 0;         //seq of the frame in "pixels"
+    uint32_t frames = 0;      //Frames decoded
+    uint32_t errors = 0;      //Packets that were damaged, lost or could not be applied
+};
+
+inline bool _frame_decoder_apply(FrameDecoder *decoder)
+{
+    const uint8_t *p = decoder->packet;
+    const int len = frame_get_u16(&p[4]);
+    const uint8_t *payload = p + FRAME_HEADER_SIZE;
+    if (p[2] == FRAME_PACKET_KEY)
+    {
+        int cols = payload[0];
+        int rows = payload[1];
+        if (len != 2 + cols * rows * 2)
+        {
+            return false;
+        }
+        for (int i = 0; i < cols * rows; i++)
+        {
+            decoder->pixels[i] = frame_get_u16(&payload[2 + i * 2]);
+        }
+        decoder->cols = cols;
+        decoder->rows = rows;
+    }
+    else
+    {
+        if (!decoder->in_sync || p[3] != (uint8_t)(decoder->seq + 1))
+        {
+            return false; //The frame this delta was made against was never received
+        }
+        const int num_pixels = decoder->cols * decoder->rows;
+        int pos = 0;
+        while (pos + 3 <= len)
+        {
+            int start = frame_get_u16(&payload[pos]);
+            int count = payload[pos + 2];
+            pos += 3;
+            if (start + count > num_pixels || pos + count * 2 > len)
+            {
+                return false;
+            }
+            for (int k = 0; k < count; k++)
+            {
+                decoder->pixels[start + k] = frame_get_u16(&payload[pos]);
+                pos += 2;
+            }
+        }
+    }
+    decoder->seq = p[3];
+    return frame_pixels_crc(decoder->pixels, decoder->cols * decoder->rows) == frame_get_u32(&p[6]);
+}
+
+/*
+*  Returns true when "byte" completed a packet that was applied to decoder->pixels.
+*/
+inline bool frame_decoder_push(FrameDecoder *decoder, uint8_t byte)
+{
+    uint8_t *p = decoder->packet;
+    if (decoder->received == 0 && byte != FRAME_SYNC_0)
+    {
+        return false;
+    }
+    if (decoder->received == 1 && byte != FRAME_SYNC_1)
+    {
+        decoder->received = (byte == FRAME_SYNC_0) ? 1 : 0;
+        return false;
+    }
+    p[decoder->received++] = byte;
+    if (decoder->received < FRAME_HEADER_SIZE)
+    {
+        return false;
+    }
+    int len = frame_get_u16(&p[4]);
+    if (len > FRAME_MAX_PAYLOAD || (p[2] != FRAME_PACKET_KEY && p[2] != FRAME_PACKET_DELTA))
+    {
+        decoder->errors++;
+        decoder->received = 0; //Not a header after all, look for the next sync bytes
+        return false;
+    }
+    if (decoder->received < FRAME_HEADER_SIZE + len + 4)
+    {
+        return false;
+    }
+    decoder->received = 0;
+    if (anim_crc32(&p[2], FRAME_HEADER_SIZE - 2 + len) != frame_get_u32(&p[FRAME_HEADER_SIZE + len]))
+    {
+        decoder->errors++;
+        decoder->in_sync = false;
+        return false;
+    }
+    decoder->in_sync = _frame_decoder_apply(decoder);
+    if (!decoder->in_sync)
+    {
+        decoder->errors++;
+        return false;
+    }
+    decoder->frames++;
+    return true;
+}
+
+#endif
@@ -0,0 +1,63 @@
+#include "FrameReceiver.h"
+
+FrameReceiver::FrameReceiver(Stream *port)
+{
+    _port = port;
+}
+
+/*
+*  Reads every byte that is waiting on the port. If a new frame was completed, it is copied to
+*  "output" and 1 is returned. Returns 0 if no new frame is ready, and -1 if a frame arrived that
+*  does not have the same size as "output". Only the newest frame is kept if several arrived.
+*/
+int FrameReceiver::poll(Frame *output)
+{
+    bool completed = false;
+    while (_port->available() > 0)
+    {
+        if (frame_decoder_push(&_decoder, _port->read()))
+        {
+            completed = true;
+        }
+    }
+    if (!completed)
+    {
+        return 0;
+    }
+    const int cols = _decoder.cols;
+    const int rows = _decoder.rows;
+    if (output->get_width() != cols || output->get_height() != rows)
+    {
+        Serial.printf("Received frame is %dx%d, expected %dx%d\n", cols, rows, output->get_width(), output->get_height());
+        return -1;
+    }
+    if (output->is_view())
+    {
+        for (int y = 0; y < rows; y++)
+        {
+            for (int x = 0; x < cols; x++)
+            {
+                output->write_pixel_intensity_at(x, y, _decoder.pixels[y * cols + x]);
+            }
+        }
+    }
+    else
+    {
+        memcpy(output->get_pixel_intensities(), _decoder.pixels, cols * rows * sizeof(uint16_t));
+        output->mark_modified();
+    }
+    return 1;
+}
+uint32_t FrameReceiver::get_frames_received()
+{
+    return _decoder.frames;
+}
+uint32_t FrameReceiver::get_errors()
+{
+    return _decoder.errors;
+}
+// false until the first key frame has arrived, and after a lost packet until the next one
+bool FrameReceiver::is_in_sync()
+{
+    return _decoder.in_sync;
+}
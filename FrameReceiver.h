@@ -0,0 +1,32 @@
+/*
+  FrameReceiver.h - shows frames streamed from a PC (see FrameProtocol.h and tools/anim_stream.cpp)
+  Copyright (c) 2019 Simen E. Sørensen.
+*/
+
+// ensure this library description is only included once
+#ifndef FrameReceiver_h
+#define FrameReceiver_h
+
+#include <Arduino.h>
+#include "Animation.h"
+#include "FrameProtocol.h"
+
+/*
+*  Decodes the frame packets arriving on a serial port. Call poll() from the main loop;
+*  it only reads the bytes that have already arrived, so it never blocks the display.
+*/
+class FrameReceiver
+{
+public:
+    FrameReceiver(Stream *port);
+    int      poll(Frame *output);
+    uint32_t get_frames_received();
+    uint32_t get_errors();
+    bool     is_in_sync();
+
+private:
+    Stream      *_port;
+    FrameDecoder _decoder;
+};
+
+#endif
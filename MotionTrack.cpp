@@ -0,0 +1,134 @@
+#include "MotionTrack.h"
+
+MotionTrack::MotionTrack(int max_keyframes)
+{
+    _max_keyframes = max(max_keyframes, 1);
+    _keyframes = new MotionKeyframe[_max_keyframes];
+}
+MotionTrack::~MotionTrack()
+{
+    delete[] _keyframes;
+}
+
+/*
+*  Adds a keyframe, keeping the keyframes sorted by tick. A keyframe at the same tick as an
+*  existing one replaces it. Returns the index of the keyframe, or -1 if the track is full.
+*/
+int MotionTrack::add_keyframe(uint32_t tick, int x_q4, int y_q4, uint16_t scale, Easing easing)
+{
+    int idx = 0;
+    while (idx < _num_keyframes && _keyframes[idx].tick < tick)
+    {
+        idx++;
+    }
+    if (idx == _num_keyframes || _keyframes[idx].tick != tick)
+    {
+        if (_num_keyframes == _max_keyframes)
+        {
+            Serial.printf("Motion track is full (%d keyframes)\n", _max_keyframes);
+            return -1;
+        }
+        for (int i = _num_keyframes; i > idx; i--)
+        {
+            _keyframes[i] = _keyframes[i - 1];
+        }
+        _num_keyframes++;
+    }
+    _keyframes[idx].tick = tick;
+    _keyframes[idx].x_q4 = x_q4;
+    _keyframes[idx].y_q4 = y_q4;
+    _keyframes[idx].scale = scale;
+    _keyframes[idx].easing = easing;
+    return idx;
+}
+void MotionTrack::clear_keyframes()
+{
+    _num_keyframes = 0;
+}
+int MotionTrack::get_num_keyframes()
+{
+    return _num_keyframes;
+}
+MotionKeyframe *MotionTrack::get_keyframe(int idx)
+{
+    if (idx < 0 || idx >= _num_keyframes)
+    {
+        return nullptr;
+    }
+    return &_keyframes[idx];
+}
+// Tick of the last keyframe. A looping track starts over at this tick.
+uint32_t MotionTrack::get_length()
+{
+    return _num_keyframes == 0 ? 0 : _keyframes[_num_keyframes - 1].tick;
+}
+void MotionTrack::set_looping(bool looping)
+{
+    _looping = looping;
+}
+bool MotionTrack::is_looping()
+{
+    return _looping;
+}
+
+//Eased progress (Q12) from linear progress p (Q12, 0...4096)
+static int32_t _ease(uint8_t easing, int32_t p)
+{
+    const int32_t one = MOTION_SCALE_ONE;
+    switch (easing)
+    {
+    case EASE_IN:
+        return (p * p) >> 12;
+    case EASE_OUT:
+        return one - (((one - p) * (one - p)) >> 12);
+    case EASE_IN_OUT:
+        return (((p * p) >> 12) * (3 * one - 2 * p)) >> 12; //smoothstep: 3p^2 - 2p^3
+    case EASE_STEP:
+        return 0;
+    default:
+        return p;
+    }
+}
+static inline int32_t _lerp(int32_t from, int32_t to, int32_t progress)
+{
+    return from + (int32_t)(((int64_t)(to - from) * progress) >> 12);
+}
+
+/*
+*  Writes the location (in 1/16 pixels) and intensity scale at "tick" to the outputs.
+*  Before the first keyframe the first keyframe is held, after the last keyframe the last
+*  one is held (or the track starts over, if it is looping). The outputs are left unchanged
+*  if the track has no keyframes.
+*/
+void MotionTrack::evaluate(uint32_t tick, int *x_q4, int *y_q4, uint16_t *scale)
+{
+    if (_num_keyframes == 0)
+    {
+        return;
+    }
+    uint32_t length = get_length();
+    if (_looping && length > 0)
+    {
+        tick %= length;
+    }
+    //Find the last keyframe at or before tick
+    int idx = 0;
+    while (idx + 1 < _num_keyframes && _keyframes[idx + 1].tick <= tick)
+    {
+        idx++;
+    }
+    const MotionKeyframe &from = _keyframes[idx];
+    if (idx + 1 == _num_keyframes || tick <= from.tick)
+    {
+        *x_q4 = from.x_q4;
+        *y_q4 = from.y_q4;
+        *scale = from.scale;
+        return;
+    }
+    const MotionKeyframe &to = _keyframes[idx + 1];
+    int32_t progress = (int32_t)(((uint64_t)(tick - from.tick) << 12) / (to.tick - from.tick));
+    progress = _ease(from.easing, progress);
+    *x_q4 = _lerp(from.x_q4, to.x_q4, progress);
+    *y_q4 = _lerp(from.y_q4, to.y_q4, progress);
+    *scale = (uint16_t)_lerp(from.scale, to.scale, progress);
+}
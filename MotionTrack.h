@@ -0,0 +1,62 @@
+/*
+  MotionTrack.h - keyframed movement of an animation over time
+  Copyright (c) 2019 Simen E. Sørensen.
+*/
+
+// ensure this library description is only included once
+#ifndef MotionTrack_h
+#define MotionTrack_h
+
+#include <Arduino.h>
+#include "Animation.h"
+
+#define MOTION_SCALE_ONE 4096 //Intensity scale of 1.0 (Q12)
+
+// How a keyframe moves towards the next one
+enum Easing
+{
+    EASE_LINEAR,
+    EASE_IN,     //Starts slow, ends fast
+    EASE_OUT,    //Starts fast, ends slow
+    EASE_IN_OUT, //Slow at both ends
+    EASE_STEP    //Stays at this keyframe until the next one is reached
+};
+
+struct MotionKeyframe
+{
+    uint32_t tick;   //Ticks since the animation was started
+    int32_t  x_q4;   //Location in 1/16 pixels (same as Animation::set_location, times 16)
+    int32_t  y_q4;
+    uint16_t scale;  //Intensity scale, MOTION_SCALE_ONE is unchanged
+    uint8_t  easing; //Easing used from this keyframe to the next
+};
+
+/*
+*  A list of keyframes with a location (and intensity scale) at given ticks. Between two
+*  keyframes the values are interpolated in fixed point, so a small sprite can be moved across
+*  the display smoothly (down to 1/16 pixel) without storing a frame for every position.
+*  Attach the track with Animation::set_motion_track() and draw the animation with
+*  Animation::composite_onto(); the track is evaluated every tick.
+*/
+class MotionTrack
+{
+public:
+    MotionTrack(int max_keyframes = 8);
+    ~MotionTrack();
+    int     add_keyframe(uint32_t tick, int x_q4, int y_q4, uint16_t scale = MOTION_SCALE_ONE, Easing easing = EASE_LINEAR);
+    void    clear_keyframes();
+    int     get_num_keyframes();
+    MotionKeyframe* get_keyframe(int idx);
+    uint32_t get_length();
+    void    set_looping(bool looping);
+    bool    is_looping();
+    void    evaluate(uint32_t tick, int *x_q4, int *y_q4, uint16_t *scale);
+
+private:
+    MotionKeyframe *_keyframes;
+    int             _max_keyframes;
+    int             _num_keyframes = 0;
+    bool            _looping = false;
+};
+
+#endif
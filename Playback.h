@@ -0,0 +1,93 @@
+/*
+  Playback.h - the order the frames of an animation are played in
+  Copyright (c) 2019 Simen E. Sørensen.
+
+  This header does not depend on Arduino, so that tools/anim_fuzz.cpp can step through
+  every playback type on a PC exactly like Animation::goto_next_frame() does.
+
+  Playback starts at start_idx and moves one frame at a time in the playback direction:
+      ONCE          every frame once, wrapping around the end of the array if the start was
+                    not the first frame in the playback direction, then stops
+      LOOP          like ONCE, but starts over from start_idx forever
+      LOOP_N_TIMES  like LOOP, but stops after max_iterations loops
+      BOUNCE        turns around at both ends of the array, forever
+  loop_iteration counts the loops that have been played all the way through, and for BOUNCE
+  the times an end of the array has been left.
+*/
+
+#ifndef Playback_h
+#define Playback_h
+
+enum PlaybackType
+{
+    ONCE,
+    LOOP,
+    BOUNCE,
+    LOOP_N_TIMES //Add "STATIC_IMAGE" here?
+};
+
+/*
+*  Returns the frame that follows "current_frame", or -1 when the animation is done (or the
+*  type is unknown). Counts the loop in "loop_iteration" and turns "dir_fwd" around where the
+*  playback type asks for it, so pass copies to look ahead without moving.
+*/
+inline int playback_next_frame(PlaybackType type, int current_frame, int start_idx, int num_frames,
+                               int max_iterations, int *loop_iteration, bool *dir_fwd)
+{
+    if (current_frame < 0 || current_frame >= num_frames)
+    {
+        return -1;
+    }
+    if (start_idx < 0 || start_idx >= num_frames)
+    {
+        start_idx = *dir_fwd ? 0 : num_frames - 1;
+    }
+    const int last = num_frames - 1;
+    switch (type)
+    {
+    case BOUNCE:
+        if (current_frame == 0 || current_frame == last)
+        {
+            (*loop_iteration)++;
+        }
+        if (num_frames == 1)
+        {
+            return 0; //The only frame is on both ends
+        }
+        if ((*dir_fwd && current_frame == last) || (!*dir_fwd && current_frame == 0))
+        {
+            *dir_fwd = !*dir_fwd; //Turn around instead of leaving the array
+        }
+        return *dir_fwd ? current_frame + 1 : current_frame - 1;
+    case ONCE:
+    case LOOP:
+    case LOOP_N_TIMES:
+    {
+        int next;
+        if (*dir_fwd)
+        {
+            next = (current_frame == last) ? 0 : current_frame + 1;
+        }
+        else
+        {
+            next = (current_frame == 0) ? last : current_frame - 1;
+        }
+        if (next != start_idx)
+        {
+            return next;
+        }
+        //Every frame has been shown since the start
+        (*loop_iteration)++;
+        if (type == ONCE || (type == LOOP_N_TIMES && *loop_iteration >= max_iterations))
+        {
+            //using >= in case max_iterations has illegal value (negative value)
+            return -1;
+        }
+        return next;
+    }
+    default:
+        return -1;
+    }
+}
+
+#endif
@@ -0,0 +1,199 @@
+/*
+  Resample.h - plays frames made for one panel size on another
+  Copyright (c) 2019 Simen E. Sørensen.
+
+  This header does not depend on Arduino, so that the host tools scale frames exactly
+  like the display does.
+
+  Working out which source pixels land on a destination pixel, and how much of each, takes
+  divisions for every pixel. A ResampleMap does that once for a pair of sizes: it stores, for
+  every destination pixel, the source pixels it is made of (taps) and their weights. Scaling
+  a frame is then a single pass that gathers the taps, with only multiplications and adds.
+  One map serves every animation of the same size, e.g. all the 19x10 animations played on
+  the full 21x12 panel:
+      ResampleMap map(COLS, ROWS, ALL_COLS, ALL_ROWS);
+      anim.set_resample_map(&map);
+*/
+
+#ifndef Resample_h
+#define Resample_h
+
+#include <stdint.h>
+
+#define RESAMPLE_WEIGHT_ONE 32768U //Weights are fixed point: the weights of a destination pixel add up to this
+
+enum ResampleFilter
+{
+    RESAMPLE_NEAREST, //The source pixel under the center of the destination pixel: sharp, keeps the exact intensities
+    RESAMPLE_AREA     //Average of the source pixels the destination pixel covers, weighted by how much of each
+};
+
+class ResampleMap
+{
+public:
+    /*
+    \brief Works out the taps of every destination pixel.
+
+    \param src_cols, src_rows Size of the frames that are scaled
+    \param dst_cols, dst_rows Size of the scaled frames
+    \param filter How destination pixels are made from source pixels. Default = RESAMPLE_AREA
+    */
+    ResampleMap(int src_cols, int src_rows, int dst_cols, int dst_rows, ResampleFilter filter = RESAMPLE_AREA)
+        : _src_cols(src_cols), _src_rows(src_rows), _dst_cols(dst_cols), _dst_rows(dst_rows), _filter(filter)
+    {
+        //Taps of every column and row on their own first, then every pixel gets the product of the two
+        uint16_t x_first[dst_cols + 1];
+        uint16_t y_first[dst_rows + 1];
+        int x_taps = _axis_taps(src_cols, dst_cols, nullptr, nullptr, x_first);
+        int y_taps = _axis_taps(src_rows, dst_rows, nullptr, nullptr, y_first);
+        uint16_t x_src[x_taps];
+        uint16_t x_weight[x_taps];
+        uint16_t y_src[y_taps];
+        uint16_t y_weight[y_taps];
+        _axis_taps(src_cols, dst_cols, x_src, x_weight, x_first);
+        _axis_taps(src_rows, dst_rows, y_src, y_weight, y_first);
+
+        uint32_t num_taps = 0;
+        for (int y = 0; y < dst_rows; y++)
+        {
+            num_taps += (uint32_t)(y_first[y + 1] - y_first[y]) * x_taps;
+        }
+        const int dst_pixels = dst_cols * dst_rows;
+        _first_tap = new uint32_t[dst_pixels + 1];
+        _tap_src = new uint16_t[num_taps];
+        _tap_weight = new uint16_t[num_taps];
+        uint32_t t = 0;
+        for (int y = 0; y < dst_rows; y++)
+        {
+            for (int x = 0; x < dst_cols; x++)
+            {
+                _first_tap[y * dst_cols + x] = t;
+                uint32_t sum = 0;
+                uint32_t largest = t;
+                for (int ty = y_first[y]; ty < y_first[y + 1]; ty++)
+                {
+                    for (int tx = x_first[x]; tx < x_first[x + 1]; tx++)
+                    {
+                        uint32_t weight = ((uint32_t)y_weight[ty] * x_weight[tx] + RESAMPLE_WEIGHT_ONE / 2) / RESAMPLE_WEIGHT_ONE;
+                        if (weight == 0)
+                        {
+                            continue;
+                        }
+                        _tap_src[t] = y_src[ty] * src_cols + x_src[tx];
+                        _tap_weight[t] = weight;
+                        largest = (t == largest || weight > _tap_weight[largest]) ? t : largest;
+                        sum += weight;
+                        t++;
+                    }
+                }
+                //What rounding took away (or added) goes to the largest tap, so a flat frame stays exactly as bright
+                _tap_weight[largest] += RESAMPLE_WEIGHT_ONE - sum;
+            }
+        }
+        _first_tap[dst_pixels] = t;
+        _num_taps = t;
+    }
+    ~ResampleMap()
+    {
+        delete[] _first_tap;
+        delete[] _tap_src;
+        delete[] _tap_weight;
+    }
+    ResampleMap(const ResampleMap &) = delete;
+    ResampleMap &operator=(const ResampleMap &) = delete;
+
+    int get_src_cols() const { return _src_cols; }
+    int get_src_rows() const { return _src_rows; }
+    int get_dst_cols() const { return _dst_cols; }
+    int get_dst_rows() const { return _dst_rows; }
+    ResampleFilter get_filter() const { return _filter; }
+    // Number of taps over all destination pixels: the multiply-adds per frame, and the memory used (4 bytes each)
+    uint32_t get_num_taps() const { return _num_taps; }
+
+    // Scales src_cols*src_rows pixels in "src" into dst_cols*dst_rows pixels in "dst" (both row by row)
+    void apply(const uint16_t *src, uint16_t *dst) const
+    {
+        const int dst_pixels = _dst_cols * _dst_rows;
+        if (_filter == RESAMPLE_NEAREST)
+        {
+            //One tap per pixel, with all the weight
+            for (int i = 0; i < dst_pixels; i++)
+            {
+                dst[i] = src[_tap_src[i]];
+            }
+            return;
+        }
+        for (int i = 0; i < dst_pixels; i++)
+        {
+            //Fits: 65535 * RESAMPLE_WEIGHT_ONE is less than 2^31
+            uint32_t sum = RESAMPLE_WEIGHT_ONE / 2;
+            for (uint32_t t = _first_tap[i]; t < _first_tap[i + 1]; t++)
+            {
+                sum += (uint32_t)src[_tap_src[t]] * _tap_weight[t];
+            }
+            dst[i] = sum / RESAMPLE_WEIGHT_ONE;
+        }
+    }
+
+private:
+    int            _src_cols;
+    int            _src_rows;
+    int            _dst_cols;
+    int            _dst_rows;
+    ResampleFilter _filter;
+    uint32_t       _num_taps = 0;
+    uint32_t      *_first_tap;  //Taps of destination pixel i are _first_tap[i] ... _first_tap[i + 1] - 1
+    uint16_t      *_tap_src;    //Index of the source pixel
+    uint16_t      *_tap_weight; //Share of the source pixel, RESAMPLE_WEIGHT_ONE is all of it
+
+    /*
+    *  Taps along one axis: destination pixel d is made of src[first[d]] ... src[first[d + 1] - 1],
+    *  weighted by weight[]. Only counts (and fills in "first") when "src" is nullptr.
+    *  Returns the number of taps.
+    */
+    int _axis_taps(int src_len, int dst_len, uint16_t *src, uint16_t *weight, uint16_t *first) const
+    {
+        int t = 0;
+        for (int d = 0; d < dst_len; d++)
+        {
+            first[d] = t;
+            if (_filter == RESAMPLE_NEAREST)
+            {
+                if (src != nullptr)
+                {
+                    src[t] = (uint32_t)(2 * d + 1) * src_len / (2 * dst_len); //Under the center of d
+                    weight[t] = RESAMPLE_WEIGHT_ONE;
+                }
+                t++;
+                continue;
+            }
+            //In units of 1/(src_len*dst_len): source pixel s covers [s*dst_len, (s+1)*dst_len),
+            //destination pixel d covers [d*src_len, (d+1)*src_len)
+            uint32_t low = (uint32_t)d * src_len;
+            uint32_t high = low + src_len;
+            uint32_t sum = 0;
+            int largest = t;
+            for (uint32_t s = low / dst_len; s * dst_len < high; s++)
+            {
+                if (src != nullptr)
+                {
+                    uint32_t start = (s * dst_len > low) ? s * dst_len : low;
+                    uint32_t end = ((s + 1) * dst_len < high) ? (s + 1) * dst_len : high;
+                    src[t] = s;
+                    weight[t] = (end - start) * RESAMPLE_WEIGHT_ONE / src_len;
+                    largest = (weight[t] > weight[largest]) ? t : largest;
+                    sum += weight[t];
+                }
+                t++;
+            }
+            if (src != nullptr)
+            {
+                weight[largest] += RESAMPLE_WEIGHT_ONE - sum;
+            }
+        }
+        first[dst_len] = t;
+        return t;
+    }
+};
+
+#endif
@@ -0,0 +1,392 @@
+#include "SpriteAtlas.h"
+#include "FreeStack.h"
+#include "csv_helpers.h"
+
+//Constructor
+SpriteAtlas::SpriteAtlas()
+{
+}
+SpriteAtlas::~SpriteAtlas()
+{
+    this->delete_atlas();
+}
+
+// Public Methods
+void SpriteAtlas::delete_atlas(void)
+{
+    _delete_frames();
+    delete[] _sprites;
+    _sprites = nullptr;
+    delete[] _pixels;
+    _pixels = nullptr;
+    _num_sprites = 0;
+    _num_pixels = 0;
+}
+
+/*
+*  Copies the pixels of "frame" into the atlas and returns the ID of the new sprite,
+*  or -1 if there was not enough memory. The frame itself is not kept by the atlas.
+*  Mainly used when building an atlas before saving it to the SD card.
+*/
+int SpriteAtlas::add_sprite(Frame *frame, int origin_x, int origin_y)
+{
+    const int width = frame->get_width();
+    const int height = frame->get_height();
+    const uint32_t new_num_pixels = _num_pixels + width * height;
+
+    const int tolerance = 10000;
+    const uint32_t needed = new_num_pixels * sizeof(uint16_t) + (_num_sprites + 1) * sizeof(SpriteInfo);
+    if (FreeStack() < tolerance || (uint32_t)(FreeStack() - tolerance) < needed)
+    {
+        Serial.printf("Not enough memory to add sprite of size: %d\n"
+                      "Available space in RAM: %d\n",
+                      width * height * sizeof(uint16_t), FreeStack());
+        return -1;
+    }
+
+    uint16_t *new_pixels = new uint16_t[new_num_pixels];
+    SpriteInfo *new_sprites = new SpriteInfo[_num_sprites + 1];
+    if (_num_pixels > 0)
+    {
+        memcpy(new_pixels, _pixels, _num_pixels * sizeof(uint16_t));
+    }
+    if (_num_sprites > 0)
+    {
+        memcpy(new_sprites, _sprites, _num_sprites * sizeof(SpriteInfo));
+    }
+    //Copy through get_pixel_intensity_at() so that views are stored the way they look
+    for (int y = 0; y < height; y++)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            new_pixels[_num_pixels + y * width + x] = frame->get_pixel_intensity_at(x, y);
+        }
+    }
+    SpriteInfo *info = &new_sprites[_num_sprites];
+    info->offset = _num_pixels;
+    info->width = width;
+    info->height = height;
+    info->origin_x = origin_x;
+    info->origin_y = origin_y;
+
+    //The Frame objects point into the old pixel array, so they have to be recreated
+    _delete_frames();
+    delete[] _pixels;
+    delete[] _sprites;
+    _pixels = new_pixels;
+    _sprites = new_sprites;
+    _num_pixels = new_num_pixels;
+    _num_sprites++;
+    _create_frames();
+
+    return _num_sprites - 1;
+}
+
+int SpriteAtlas::get_num_sprites()
+{
+    return _num_sprites;
+}
+
+/*
+*  Returns a Frame holding the pixels of the sprite. The frame belongs to the atlas
+*  and must not be deleted. Returns nullptr if the ID is unknown.
+*/
+Frame *SpriteAtlas::get_sprite(uint16_t sprite_id)
+{
+    if (sprite_id >= _num_sprites)
+    {
+        return nullptr;
+    }
+    return _frames[sprite_id];
+}
+
+int *SpriteAtlas::get_sprite_size(uint16_t sprite_id, int *output)
+{
+    output[0] = 0;
+    output[1] = 0;
+    if (sprite_id < _num_sprites)
+    {
+        output[0] = _sprites[sprite_id].width;
+        output[1] = _sprites[sprite_id].height;
+    }
+    return output;
+}
+
+int *SpriteAtlas::get_sprite_origin(uint16_t sprite_id, int *output)
+{
+    output[0] = 0;
+    output[1] = 0;
+    if (sprite_id < _num_sprites)
+    {
+        output[0] = _sprites[sprite_id].origin_x;
+        output[1] = _sprites[sprite_id].origin_y;
+    }
+    return output;
+}
+
+/*
+*  Merges the sprite into "canvas" so that the origin of the sprite ends up at
+*  (location_x, location_y). This is the same placement as Animation::merge_with()
+*  uses (see Animation::get_bottom_left_location()). Pixels outside of the canvas are ignored.
+*/
+void SpriteAtlas::blit(Frame *canvas, uint16_t sprite_id, int location_x, int location_y)
+{
+    if (sprite_id >= _num_sprites)
+    {
+        return;
+    }
+    SpriteInfo *info = &_sprites[sprite_id];
+    canvas->merge_with_frame(location_x - info->origin_x, location_y - info->origin_y, _frames[sprite_id]);
+}
+
+void SpriteAtlas::blit_refs(Frame *canvas, SpriteRef *refs, int num_refs)
+{
+    for (int i = 0; i < num_refs; i++)
+    {
+        blit(canvas, refs[i].sprite_id, refs[i].location_x, refs[i].location_y);
+    }
+}
+
+/*\brief Saves the atlas as two files on the SD card.
+    The config file lists the number of sprites followed by width,height,origin_x,origin_y for every sprite.
+    The data file contains the pixels of every sprite, packed after each other.
+    filename format: "S000_C.txt" for config files
+    filename format: "S000_D.bin" for data files
+ */
+int SpriteAtlas::save_to_SD_card(SdFatSdioEX sd, uint16_t atlas_index)
+{
+    File atlasFile;
+    char full_filename[13]; //Max length of filename is 8 chars +".ext" + string terminator
+    char field_str[32];
+
+    sprintf(full_filename, ATLAS_CONFIG_FILENAME_FMT, atlas_index);
+    if (!atlasFile.open(full_filename, O_RDWR | O_CREAT | O_TRUNC))
+    {
+        Serial.printf("open file: '%s' failed\n", full_filename);
+        return -1;
+    }
+    sprintf(field_str, "%d", _num_sprites);
+    atlasFile.write(field_str);
+    for (int i = 0; i < _num_sprites; i++)
+    {
+        sprintf(field_str, ",%u,%u,%d,%d", _sprites[i].width, _sprites[i].height, _sprites[i].origin_x, _sprites[i].origin_y);
+        atlasFile.write(field_str);
+    }
+    atlasFile.flush();
+    atlasFile.close();
+
+    sprintf(full_filename, ATLAS_DATA_FILENAME_FMT, atlas_index);
+    if (!atlasFile.open(full_filename, O_RDWR | O_CREAT | O_TRUNC))
+    {
+        Serial.printf("open file: '%s' failed\n", full_filename);
+        return -1;
+    }
+    atlasFile.write(_pixels, _num_pixels * sizeof(uint16_t));
+    atlasFile.flush();
+    atlasFile.close();
+
+    Serial.printf("Sprite atlas saved to SD card with %d sprites.\n", _num_sprites);
+    return 1;
+}
+
+/*\brief Replaces the content of this atlas with an atlas stored on the SD card.
+    All sprites are read with a single read into one array.
+    The atlas is only replaced if the whole atlas could be read, otherwise it is left as it was.
+ */
+int SpriteAtlas::read_from_SD_card(SdFatSdioEX sd, uint16_t atlas_index)
+{
+    File atlasFile;
+    char full_filename[13]; //Max length of filename is 8 chars +".ext" + string terminator
+    char delim = ',';
+
+    sprintf(full_filename, ATLAS_CONFIG_FILENAME_FMT, atlas_index);
+    if (!atlasFile.open(full_filename, O_RDONLY))
+    {
+        Serial.printf("open file: '%s' failed\n", full_filename);
+        return -1;
+    }
+
+    CsvReader reader;
+    csvReaderBegin(&reader, &atlasFile);
+    int num_sprites = 0;
+    if (csvReadNextInt(&reader, &num_sprites, delim) < 0 || num_sprites < 0)
+    {
+        Serial.printf("Could not read number of sprites from: '%s'\n", full_filename);
+        atlasFile.close();
+        return -1;
+    }
+    SpriteInfo *sprites = new SpriteInfo[num_sprites];
+    uint32_t num_pixels = 0;
+    for (int i = 0; i < num_sprites; i++)
+    {
+        int width, height, origin_x, origin_y;
+        if (csvReadNextInt(&reader, &width, delim) < 0 ||
+            csvReadNextInt(&reader, &height, delim) < 0 ||
+            csvReadNextInt(&reader, &origin_x, delim) < 0 ||
+            csvReadNextInt(&reader, &origin_y, delim) < 0 ||
+            width <= 0 || width > UINT16_MAX || height <= 0 || height > UINT16_MAX)
+        {
+            Serial.printf("Could not read sprite %d from: '%s'\n", i, full_filename);
+            delete[] sprites;
+            atlasFile.close();
+            return -1;
+        }
+        sprites[i].offset = num_pixels;
+        sprites[i].width = width;
+        sprites[i].height = height;
+        sprites[i].origin_x = origin_x;
+        sprites[i].origin_y = origin_y;
+        //Sizes come from the file, so keep the sum from wrapping around before it is checked below
+        const uint32_t sprite_pixels = (uint32_t)width * height;
+        num_pixels = (sprite_pixels > UINT32_MAX - num_pixels) ? UINT32_MAX : num_pixels + sprite_pixels;
+    }
+    atlasFile.close();
+
+    sprintf(full_filename, ATLAS_DATA_FILENAME_FMT, atlas_index);
+    if (!atlasFile.open(full_filename, O_RDONLY))
+    {
+        Serial.printf("open file: '%s' failed\n", full_filename);
+        delete[] sprites;
+        return -1;
+    }
+    //The data file holds nothing but the pixels, so it also bounds the size before anything is allocated
+    if (num_pixels > atlasFile.fileSize() / sizeof(uint16_t))
+    {
+        Serial.printf("The sprites do not fit in: '%s'\n", full_filename);
+        delete[] sprites;
+        atlasFile.close();
+        return -1;
+    }
+    const int tolerance = 10000;
+    if (FreeStack() < tolerance || (uint32_t)(FreeStack() - tolerance) < num_pixels * sizeof(uint16_t))
+    {
+        Serial.printf("Not enough memory to store sprite atlas of size: %d\n"
+                      "Available space in RAM: %d\n",
+                      num_pixels * sizeof(uint16_t), FreeStack());
+        delete[] sprites;
+        atlasFile.close();
+        return -2;
+    }
+    uint16_t *pixels = new uint16_t[num_pixels];
+    if (atlasFile.read(pixels, num_pixels * sizeof(uint16_t)) != (int)(num_pixels * sizeof(uint16_t)))
+    {
+        Serial.printf("Could not read the sprite pixels from: '%s'\n", full_filename);
+        delete[] sprites;
+        delete[] pixels;
+        atlasFile.close();
+        return -1;
+    }
+    atlasFile.close();
+
+    delete_atlas();
+    _sprites = sprites;
+    _pixels = pixels;
+    _num_sprites = num_sprites;
+    _num_pixels = num_pixels;
+    _create_frames();
+
+    Serial.printf("Sprite atlas read from SD card with %d sprites.\n", _num_sprites);
+    return 1;
+}
+
+/*\brief Saves the sprites used by a scene as a list of references into an atlas.
+    The file lists the number of references followed by sprite_id,location_x,location_y for every reference.
+    filename format: "R000_C.txt"
+ */
+int SpriteAtlas::save_refs_to_SD_card(SdFatSdioEX sd, uint16_t scene_index, SpriteRef *refs, int num_refs)
+{
+    File refFile;
+    char full_filename[13]; //Max length of filename is 8 chars +".ext" + string terminator
+    char field_str[32];
+
+    sprintf(full_filename, SPRITE_REFS_FILENAME_FMT, scene_index);
+    if (!refFile.open(full_filename, O_RDWR | O_CREAT | O_TRUNC))
+    {
+        Serial.printf("open file: '%s' failed\n", full_filename);
+        return -1;
+    }
+    sprintf(field_str, "%d", num_refs);
+    refFile.write(field_str);
+    for (int i = 0; i < num_refs; i++)
+    {
+        sprintf(field_str, ",%u,%d,%d", refs[i].sprite_id, refs[i].location_x, refs[i].location_y);
+        refFile.write(field_str);
+    }
+    refFile.flush();
+    refFile.close();
+    return 1;
+}
+
+/*\brief Reads a list of sprite references saved with save_refs_to_SD_card().
+    "*refs" is allocated by this function and has to be deleted (delete[]) by the caller.
+ */
+int SpriteAtlas::read_refs_from_SD_card(SdFatSdioEX sd, uint16_t scene_index, SpriteRef **refs, int *num_refs)
+{
+    File refFile;
+    char full_filename[13]; //Max length of filename is 8 chars +".ext" + string terminator
+    char delim = ',';
+
+    *refs = nullptr;
+    *num_refs = 0;
+    sprintf(full_filename, SPRITE_REFS_FILENAME_FMT, scene_index);
+    if (!refFile.open(full_filename, O_RDONLY))
+    {
+        Serial.printf("open file: '%s' failed\n", full_filename);
+        return -1;
+    }
+    CsvReader reader;
+    csvReaderBegin(&reader, &refFile);
+    int count = 0;
+    if (csvReadNextInt(&reader, &count, delim) < 0 || count < 0)
+    {
+        refFile.close();
+        return -1;
+    }
+    SpriteRef *new_refs = new SpriteRef[count];
+    for (int i = 0; i < count; i++)
+    {
+        int sprite_id, location_x, location_y;
+        if (csvReadNextInt(&reader, &sprite_id, delim) < 0 ||
+            csvReadNextInt(&reader, &location_x, delim) < 0 ||
+            csvReadNextInt(&reader, &location_y, delim) < 0)
+        {
+            Serial.printf("Could not read sprite reference %d from: '%s'\n", i, full_filename);
+            delete[] new_refs;
+            refFile.close();
+            return -1;
+        }
+        new_refs[i].sprite_id = sprite_id;
+        new_refs[i].location_x = location_x;
+        new_refs[i].location_y = location_y;
+    }
+    refFile.close();
+
+    *refs = new_refs;
+    *num_refs = count;
+    return 1;
+}
+
+// Private Methods
+
+void SpriteAtlas::_create_frames()
+{
+    _frames = new Frame *[_num_sprites];
+    for (int i = 0; i < _num_sprites; i++)
+    {
+        _frames[i] = new Frame(&_pixels[_sprites[i].offset], _sprites[i].width, _sprites[i].height, true);
+    }
+}
+
+void SpriteAtlas::_delete_frames()
+{
+    if (_frames == nullptr)
+    {
+        return;
+    }
+    for (int i = 0; i < _num_sprites; i++)
+    {
+        delete _frames[i]; //Does not delete the pixels, they are borrowed from _pixels
+    }
+    delete[] _frames;
+    _frames = nullptr;
+}
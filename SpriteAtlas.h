@@ -0,0 +1,70 @@
+/*
+  SpriteAtlas.h - shared store of small frames (sprites) for Fetch
+  Copyright (c) 2019 Simen E. Sørensen.
+*/
+
+// ensure this library description is only included once
+#ifndef SpriteAtlas_h
+#define SpriteAtlas_h
+
+#include <Arduino.h>
+#include "SdFat.h"
+#include "Animation.h"
+
+struct SpriteInfo
+{
+    uint32_t offset;   //Index of the first pixel of the sprite in the shared pixel array
+    uint16_t width;
+    uint16_t height;
+    int16_t  origin_x; //Local origin, relative to the bottom left corner of the sprite (same as Animation::set_origin)
+    int16_t  origin_y;
+};
+
+//A sprite placed in a scene. The location is global, like Animation::set_location.
+struct SpriteRef
+{
+    uint16_t sprite_id;
+    int16_t  location_x;
+    int16_t  location_y;
+};
+
+/*
+*  Stores many small frames (letters, blobs, icons etc.) packed after each other
+*  in a single array, so that they can be loaded once and used by every scene.
+*  Scenes refer to the sprites by their ID (the order they were added in) and
+*  blit them into a canvas at a location instead of storing them as animations.
+*/
+class SpriteAtlas
+{
+public:
+    SpriteAtlas();
+    ~SpriteAtlas();
+    void    delete_atlas(void);
+
+    int     add_sprite(Frame *frame, int origin_x = 0, int origin_y = 0);
+    int     get_num_sprites();
+    Frame*  get_sprite(uint16_t sprite_id);
+    int*    get_sprite_size(uint16_t sprite_id, int *output);
+    int*    get_sprite_origin(uint16_t sprite_id, int *output);
+
+    void    blit(Frame *canvas, uint16_t sprite_id, int location_x, int location_y);
+    void    blit_refs(Frame *canvas, SpriteRef *refs, int num_refs);
+
+    int     save_to_SD_card(SdFatSdioEX sd, uint16_t atlas_index);
+    int     read_from_SD_card(SdFatSdioEX sd, uint16_t atlas_index);
+
+    static int save_refs_to_SD_card(SdFatSdioEX sd, uint16_t scene_index, SpriteRef *refs, int num_refs);
+    static int read_refs_from_SD_card(SdFatSdioEX sd, uint16_t scene_index, SpriteRef **refs, int *num_refs);
+
+private:
+    int             _num_sprites = 0;
+    uint32_t        _num_pixels = 0;
+    SpriteInfo     *_sprites = nullptr;
+    uint16_t       *_pixels = nullptr; //Pixels of every sprite, packed after each other
+    Frame         **_frames = nullptr; //One Frame per sprite, borrowing its pixels from _pixels
+
+    void            _create_frames();
+    void            _delete_frames();
+};
+
+#endif
@@ -0,0 +1,103 @@
+#include "TextRenderer.h"
+
+/*
+*  Merges "text" into "canvas" with the bottom left corner of the first glyph at (x_q4/16, y).
+*  x_q4 is given in 1/16 columns: when it is not a whole column, every glyph column is shared
+*  between the two canvas columns it covers, weighted by how much of it each column covers,
+*  which makes slow scrolling look smooth. Glyphs outside of the canvas are skipped.
+*/
+void blit_text(Frame *canvas, const Font &font, const char *text, int x_q4, int y, uint16_t intensity)
+{
+    const int cols = canvas->get_width();
+    const int advance = font.width + font.spacing;
+    const int x = floor_div(x_q4, Q4_ONE);
+    const int frac = x_q4 - x * Q4_ONE;
+    const uint16_t left_intensity = ((uint32_t)intensity * (Q4_ONE - frac)) / Q4_ONE;
+    const uint16_t right_intensity = ((uint32_t)intensity * frac) / Q4_ONE;
+
+    //Skip the glyphs that are entirely to the left of the canvas (the last column of a glyph may spill one column right)
+    int first = -floor_div(x + font.width, advance);
+    if (first < 0)
+    {
+        first = 0;
+    }
+    int i = 0;
+    while (i < first && text[i] != 0)
+    {
+        i++;
+    }
+
+    for (; text[i] != 0; i++)
+    {
+        int glyph_x = x + i * advance;
+        if (glyph_x >= cols)
+        {
+            break; //This and the rest of the glyphs are right of the canvas
+        }
+        for (int col = 0; col < font.width; col++)
+        {
+            uint8_t bits = font_glyph_column(font, text[i], col);
+            for (int row = 0; bits != 0; row++, bits >>= 1)
+            {
+                if (bits & 1)
+                {
+                    int canvas_y = y + font.height - 1 - row; //Bit 0 is the top row of the glyph
+                    canvas->merge_pixel_intensity_at(glyph_x + col, canvas_y, left_intensity);
+                    if (right_intensity > 0)
+                    {
+                        canvas->merge_pixel_intensity_at(glyph_x + col + 1, canvas_y, right_intensity);
+                    }
+                }
+            }
+        }
+    }
+}
+
+/*
+*  ScrollingTextGenerator
+*/
+ScrollingTextGenerator::ScrollingTextGenerator(const char *text, const Font &font, int speed_q4, int y, uint16_t intensity)
+{
+    _font = &font;
+    set_text(text);
+    set_speed(speed_q4);
+    set_y(y);
+    set_intensity(intensity);
+}
+void ScrollingTextGenerator::render(Frame *output, uint32_t t)
+{
+    memset(output->get_pixel_intensities(), 0, output->get_width() * output->get_height() * sizeof(uint16_t));
+    //The text enters at the right edge and moves left by _speed every tick
+    int x_q4 = output->get_width() * Q4_ONE - (int)(t * _speed);
+    blit_text(output, *_font, _text, x_q4, _y, _intensity);
+}
+/*
+*  Returns the number of ticks it takes for the whole text to scroll through a frame that
+*  is "cols" wide, from entering on the right until it has left on the left side.
+*  Use it as the number of frames when attaching the generator to an animation.
+*/
+int ScrollingTextGenerator::get_scroll_length(int cols)
+{
+    int distance_q4 = (cols + font_text_width(*_font, _text) + 1) * Q4_ONE;
+    return (distance_q4 + _speed - 1) / _speed + 1;
+}
+void ScrollingTextGenerator::set_text(const char *text)
+{
+    _text = (text == nullptr) ? "" : text;
+    _revision++;
+}
+void ScrollingTextGenerator::set_speed(int speed_q4)
+{
+    _speed = max(speed_q4, 1);
+    _revision++;
+}
+void ScrollingTextGenerator::set_y(int y)
+{
+    _y = y;
+    _revision++;
+}
+void ScrollingTextGenerator::set_intensity(uint16_t intensity)
+{
+    _intensity = intensity > DUTY_CYCLE_RESOLUTION ? DUTY_CYCLE_RESOLUTION : intensity;
+    _revision++;
+}
@@ -0,0 +1,44 @@
+/*
+  TextRenderer.h - text and scrolling text for Fetch without stored frames
+  Copyright (c) 2019 Simen E. Sørensen.
+*/
+
+// ensure this library description is only included once
+#ifndef TextRenderer_h
+#define TextRenderer_h
+
+#include <Arduino.h>
+#include "Animation.h"
+#include "FrameGenerator.h"
+#include "Font.h"
+
+void blit_text(Frame *canvas, const Font &font, const char *text, int x_q4, int y, uint16_t intensity = DUTY_CYCLE_RESOLUTION);
+
+/*
+*  Scrolls a message from right to left across the animation it is attached to
+*  (see Animation::set_generator()). Only the glyphs inside the frame are drawn each tick,
+*  so any message costs the same RAM. The text is not copied and has to stay valid.
+*
+*  Place the text on the display like any other animation with set_location()/set_origin() 
+*  and merge_with(), e.g. an animation that is COLS wide and FONT_5X7.height rows high.
+*/
+class ScrollingTextGenerator : public FrameGenerator
+{
+public:
+    ScrollingTextGenerator(const char *text, const Font &font = FONT_5X7, int speed_q4 = Q4_ONE / 2, int y = 0, uint16_t intensity = DUTY_CYCLE_RESOLUTION);
+    void render(Frame *output, uint32_t t);
+    int  get_scroll_length(int cols);
+    void set_text(const char *text);
+    void set_speed(int speed_q4);
+    void set_y(int y);
+    void set_intensity(uint16_t intensity);
+
+private:
+    const char *_text;
+    const Font *_font;
+    int         _speed;
+    int         _y;
+    uint16_t    _intensity;
+};
+
+#endif
@@ -0,0 +1,187 @@
+#include "Thermal.h"
+#include <string.h>
+
+/*
+\brief Constructor
+
+\param cols The number of columns of the frames that will be shown. Default = COLS
+\param rows The number of rows of the frames that will be shown. Default = ROWS
+\param time_constant Ticks it takes a magnet to cover about 63% of the way to a new heat (see set_time_constant()). Default = 600
+*/
+ThermalModel::ThermalModel(int cols, int rows, uint32_t time_constant)
+{
+    _cols = cols;
+    _rows = rows;
+    _heat = new uint32_t[cols * rows];
+    _pixels = new uint16_t[cols * rows];
+    set_time_constant(time_constant);
+    reset();
+}
+ThermalModel::~ThermalModel()
+{
+    delete[] _heat;
+    delete[] _pixels;
+    delete _derated;
+}
+
+/*
+*  Sets how fast the magnets heat up and cool down, in ticks. Measure it on the hardware:
+*  hold a magnet at full intensity and note how many ticks it takes the coil to get about
+*  63% of the way from room temperature to its final temperature.
+*/
+void ThermalModel::set_time_constant(uint32_t ticks)
+{
+    _gain = ANIM_POWER_SCALE_ONE / max(ticks, (uint32_t)1);
+    if (_gain < 1)
+    {
+        _gain = 1;
+    }
+    _decay = ANIM_POWER_SCALE_ONE - _gain;
+}
+
+/*
+*  Dims pixels that are hotter than "start_heat". The intensity of a pixel is scaled down
+*  linearly with its heat, from unchanged at "start_heat" to min_scale/ANIM_POWER_SCALE_ONE
+*  at "full_heat" and above. A dimmed pixel heats up more slowly, so it settles where the
+*  heat it gains and the heat it loses are equal. A "start_heat" of 0 turns derating off.
+*  No magnet gets hotter than DUTY_CYCLE_RESOLUTION, so "start_heat" is kept below that.
+*/
+void ThermalModel::set_derating(uint16_t start_heat, uint16_t full_heat, uint32_t min_scale)
+{
+    //Also keeps start_heat + 1 from wrapping around to 0, which update() divides by
+    start_heat = min(start_heat, (uint16_t)(DUTY_CYCLE_RESOLUTION - 1));
+    _derate_start = start_heat;
+    _derate_full = max(full_heat, (uint16_t)(start_heat + 1));
+    _min_scale = min(min_scale, (uint32_t)ANIM_POWER_SCALE_ONE);
+    _num_hot = 0;
+}
+
+/*
+*  Adds one tick of "frame" to the heat of every magnet, and returns the frame to show.
+*  That is "frame" itself unless pixels are hotter than the derating threshold, in which case
+*  it is a copy with those pixels dimmed (owned by this object, valid until the next update()).
+*  The heat is updated from the frame that is returned, since that is what the magnets get.
+*  Frames of another size than the model are returned as they are, without updating the heat.
+*/
+Frame *ThermalModel::update(Frame *frame)
+{
+    uint32_t start = micros();
+    const int num_pixels = _cols * _rows;
+    if (frame->get_width() != _cols || frame->get_height() != _rows)
+    {
+        return frame;
+    }
+    frame->copy_pixel_intensities_to(_pixels);
+
+    Frame *shown = frame;
+    if (_num_hot > 0)
+    {
+        //Only pixels that were hot last tick are dimmed, the heat changes too slowly for that to matter
+        const uint32_t start_heat = (uint32_t)_derate_start << 16;
+        const uint32_t range = _derate_full - _derate_start;
+        for (int i = 0; i < num_pixels; i++)
+        {
+            if (_heat[i] <= start_heat)
+            {
+                continue;
+            }
+            uint32_t over = min((_heat[i] - start_heat) >> 16, range);
+            uint32_t scale = ANIM_POWER_SCALE_ONE - over * (ANIM_POWER_SCALE_ONE - _min_scale) / range;
+            uint32_t value = min((uint32_t)_pixels[i], (uint32_t)DUTY_CYCLE_RESOLUTION);
+            _pixels[i] = (value * scale) >> 16;
+        }
+        if (_derated == nullptr)
+        {
+            _derated = new Frame(nullptr, _cols, _rows);
+        }
+        memcpy(_derated->get_pixel_intensities(), _pixels, num_pixels * sizeof(uint16_t));
+        _derated->write_duration(frame->get_duration());
+        _derated->mark_modified();
+        shown = _derated;
+    }
+
+    //heat = heat * decay + intensity * gain, one multiply-accumulate per pixel.
+    //Kept free of branches so that the compiler can unroll (or vectorize) it.
+    const uint32_t hot = (uint32_t)_derate_start << 16;
+    int num_hot = 0;
+    for (int i = 0; i < num_pixels; i++)
+    {
+        uint32_t value = min((uint32_t)_pixels[i], (uint32_t)DUTY_CYCLE_RESOLUTION);
+        uint64_t heat = (uint64_t)_heat[i] * _decay + ((uint64_t)value << 16) * _gain;
+        _heat[i] = (uint32_t)(heat >> 16);
+        num_hot += (_heat[i] > hot);
+    }
+    _num_hot = (_derate_start == 0) ? 0 : num_hot;
+
+    _update_micros = micros() - start;
+    if (_update_micros > _max_update_micros)
+    {
+        _max_update_micros = _update_micros;
+    }
+    return shown;
+}
+
+// Sets every magnet back to cold, and clears the measured update times
+void ThermalModel::reset()
+{
+    memset(_heat, 0, _cols * _rows * sizeof(uint32_t));
+    _num_hot = 0;
+    _update_micros = 0;
+    _max_update_micros = 0;
+}
+
+// Heat of pixel (x,y), in pixel intensity units (see ThermalModel). 0 outside of the frame.
+uint16_t ThermalModel::get_heat_at(int x, int y)
+{
+    if (x < 0 || x >= _cols || y < 0 || y >= _rows)
+    {
+        return 0;
+    }
+    return _heat[y * _cols + x] >> 16;
+}
+/*
+*  Writes the heat of every pixel to "output" (row by row, cols*rows values, like
+*  Frame::copy_pixel_intensities_to()), so the heat map can be shown as a frame.
+*/
+void ThermalModel::copy_heat_map_to(uint16_t *output)
+{
+    for (int i = 0; i < _cols * _rows; i++)
+    {
+        output[i] = _heat[i] >> 16;
+    }
+}
+// Heat of the hottest pixel. Its location is written to "x" and "y" if they are given.
+uint16_t ThermalModel::get_max_heat(int *x, int *y)
+{
+    int hottest = 0;
+    for (int i = 1; i < _cols * _rows; i++)
+    {
+        if (_heat[i] > _heat[hottest])
+        {
+            hottest = i;
+        }
+    }
+    if (x != nullptr)
+    {
+        *x = hottest % _cols;
+    }
+    if (y != nullptr)
+    {
+        *y = hottest / _cols;
+    }
+    return _heat[hottest] >> 16;
+}
+// Number of pixels that are being dimmed (hotter than the derating threshold)
+int ThermalModel::get_num_hot_pixels()
+{
+    return _num_hot;
+}
+// Time the last update() took, and the longest one since reset(), in microseconds
+uint32_t ThermalModel::get_update_micros()
+{
+    return _update_micros;
+}
+uint32_t ThermalModel::get_max_update_micros()
+{
+    return _max_update_micros;
+}
@@ -0,0 +1,60 @@
+/*
+  Thermal.h - estimated coil temperature of every magnet, for thermal throttling
+  Copyright (c) 2019 Simen E. Sørensen.
+*/
+
+// ensure this library description is only included once
+#ifndef Thermal_h
+#define Thermal_h
+
+#include <Arduino.h>
+#include "Animation.h"
+
+/*
+*  Keeps an estimate of how hot every magnet is from the frames that are actually shown.
+*  The heat of a pixel follows its intensity with a delay (an exponential moving average):
+*  a magnet held at intensity d long enough ends up with a heat of d, and after a change it
+*  covers about 63% of the way to the new intensity in one time constant. Heat is therefore
+*  in the same units as the pixels: 0 is cold, DUTY_CYCLE_RESOLUTION is a magnet that has
+*  been held at full intensity for much longer than the time constant.
+*
+*  Call update() once per tick with the frame that is about to be shown, and show the frame
+*  it returns instead. Pixels that are hotter than the derating threshold are dimmed.
+*/
+class ThermalModel
+{
+public:
+    ThermalModel(int cols = COLS, int rows = ROWS, uint32_t time_constant = 600);
+    ~ThermalModel();
+    void     set_time_constant(uint32_t ticks);
+    void     set_derating(uint16_t start_heat, uint16_t full_heat, uint32_t min_scale = ANIM_POWER_SCALE_ONE / 4);
+    Frame*   update(Frame *frame);
+    void     reset();
+
+    uint16_t get_heat_at(int x, int y);
+    void     copy_heat_map_to(uint16_t *output);
+    uint16_t get_max_heat(int *x = nullptr, int *y = nullptr);
+    int      get_num_hot_pixels();
+    uint32_t get_update_micros();
+    uint32_t get_max_update_micros();
+
+private:
+    int       _cols;
+    int       _rows;
+    uint32_t *_heat;   //Heat of every pixel, row by row, in 1/65536ths of a pixel intensity
+    uint16_t *_pixels; //The frame being shown, as plain pixels
+    Frame    *_derated = nullptr; //Returned by update() when pixels had to be dimmed
+    uint32_t  _decay;  //Share of the heat kept every tick, in 1/65536ths
+    uint32_t  _gain;   //Share of the intensity added every tick, 65536 - _decay
+
+    //Derating (see set_derating()), off while _derate_start is 0
+    uint16_t  _derate_start = 0;
+    uint16_t  _derate_full = 0;
+    uint32_t  _min_scale = ANIM_POWER_SCALE_ONE;
+    int       _num_hot = 0; //Pixels above _derate_start after the last update
+
+    uint32_t  _update_micros = 0;
+    uint32_t  _max_update_micros = 0;
+};
+
+#endif
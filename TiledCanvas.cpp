@@ -0,0 +1,203 @@
+#include "TiledCanvas.h"
+#include <string.h>
+
+/*
+\brief Constructor
+
+\param panels_x The number of panels next to each other
+\param panels_y The number of panels on top of each other
+\param panel_cols The number of columns of a single panel. Default = COLS
+\param panel_rows The number of rows of a single panel. Default = ROWS
+
+Every panel starts out on driver 0, chained in tile order, and not turned.
+*/
+TiledCanvas::TiledCanvas(int panels_x, int panels_y, int panel_cols, int panel_rows)
+{
+    _wall = WallLayout{max(panels_x, 1), max(panels_y, 1), panel_cols, panel_rows};
+    _tiles = new PanelTile[wall_num_tiles(_wall)];
+    for (int t = 0; t < wall_num_tiles(_wall); t++)
+    {
+        PanelTile *tile = &_tiles[t];
+        tile->frame = new Frame(nullptr, panel_cols, panel_rows);
+        tile->x = wall_tile_x(_wall, t);
+        tile->y = wall_tile_y(_wall, t);
+        tile->driver = 0;
+        tile->chain_pos = t;
+        tile->mounting = TRANSFORM_NONE;
+    }
+}
+TiledCanvas::~TiledCanvas()
+{
+    for (int t = 0; t < get_num_tiles(); t++)
+    {
+        delete _tiles[t].frame;
+    }
+    delete[] _tiles;
+}
+
+int TiledCanvas::get_width()
+{
+    return _wall.panels_x * _wall.panel_cols;
+}
+int TiledCanvas::get_height()
+{
+    return _wall.panels_y * _wall.panel_rows;
+}
+int TiledCanvas::get_num_tiles()
+{
+    return wall_num_tiles(_wall);
+}
+PanelTile *TiledCanvas::get_tile(int tile)
+{
+    if (tile < 0 || tile >= get_num_tiles())
+    {
+        return nullptr;
+    }
+    return &_tiles[tile];
+}
+// Returns the tile that shows canvas pixel (x,y), or -1 if the pixel is outside of the canvas
+int TiledCanvas::get_tile_at(int x, int y)
+{
+    return wall_tile_at(_wall, x, y);
+}
+
+/*
+*  Tells which driver output a panel is connected to, where it is in the chain of that driver,
+*  and how it is turned. Walls are often wired in a zig-zag, with every other row of panels
+*  turned upside down (TRANSFORM_ROTATE_180) so that the cables stay short.
+*/
+void TiledCanvas::set_tile_mapping(int tile, uint8_t driver, uint8_t chain_pos, FrameTransform mounting)
+{
+    PanelTile *t = get_tile(tile);
+    if (t == nullptr)
+    {
+        return;
+    }
+    t->driver = driver;
+    t->chain_pos = chain_pos;
+    t->mounting = mounting;
+}
+/*
+*  Maps every panel to one driver, wired in a zig-zag: every other row of panels is turned
+*  upside down and chained back (see WallLayout.h), like "anim_wall --zigzag".
+*/
+void TiledCanvas::set_zigzag_mapping(uint8_t driver)
+{
+    for (int t = 0; t < get_num_tiles(); t++)
+    {
+        set_tile_mapping(t, driver, wall_zigzag_chain_pos(_wall, t),
+                         wall_zigzag_upside_down(_wall, t) ? TRANSFORM_ROTATE_180 : TRANSFORM_NONE);
+    }
+}
+
+void TiledCanvas::clear()
+{
+    for (int t = 0; t < get_num_tiles(); t++)
+    {
+        memset(_tiles[t].frame->get_pixel_intensities(), 0, wall_panel_pixels(_wall) * sizeof(uint16_t));
+        _tiles[t].frame->mark_modified();
+    }
+}
+uint16_t TiledCanvas::get_pixel_intensity_at(int x, int y)
+{
+    int tile = get_tile_at(x, y);
+    if (tile < 0)
+    {
+        return 0;
+    }
+    return _tiles[tile].frame->get_pixel_intensity_at(x - _tiles[tile].x, y - _tiles[tile].y);
+}
+
+/*
+*  Merges "frame" into the canvas with its bottom left corner at (bottom_left_x, bottom_left_y),
+*  like Frame::merge_with_frame() does for a single frame. Only the tiles it overlaps are touched.
+*/
+void TiledCanvas::merge_frame(int bottom_left_x, int bottom_left_y, Frame *frame, BlendMode mode, uint16_t weight)
+{
+    int first_px, last_px, first_py, last_py;
+    if (!wall_panels_overlapped(_wall, bottom_left_x, bottom_left_y, frame->get_width(), frame->get_height(),
+                                &first_px, &last_px, &first_py, &last_py))
+    {
+        return;
+    }
+    for (int py = first_py; py <= last_py; py++)
+    {
+        for (int px = first_px; px <= last_px; px++)
+        {
+            merge_frame_into_tile(py * _wall.panels_x + px, bottom_left_x, bottom_left_y, frame, mode, weight);
+        }
+    }
+}
+// Merges the part of "frame" (placed in canvas coordinates) that falls inside a single tile
+void TiledCanvas::merge_frame_into_tile(int tile, int bottom_left_x, int bottom_left_y, Frame *frame, BlendMode mode, uint16_t weight)
+{
+    PanelTile *t = get_tile(tile);
+    if (t == nullptr)
+    {
+        return;
+    }
+    //Frame::merge_with_frame() clips to the tile, so only the offset of the tile is needed
+    t->frame->merge_with_frame(bottom_left_x - t->x, bottom_left_y - t->y, frame, mode, weight);
+}
+
+/*
+*  Clears a tile and merges the current frame of every layer into it, at the location of the
+*  layer (Animation::get_bottom_left_location()). "modes" holds the blend mode of every layer;
+*  all layers are added if it is nullptr. "weights" holds the weight of every BLEND_WEIGHTED
+*  layer (see Frame::merge_with_frame()); all layers have full weight if it is nullptr.
+*  Call it for every tile, then pack and send the tile, to update the wall one panel at a time.
+*/
+void TiledCanvas::render_tile(int tile, Animation **layers, int num_layers, BlendMode *modes, uint16_t *weights)
+{
+    PanelTile *t = get_tile(tile);
+    if (t == nullptr)
+    {
+        return;
+    }
+    memset(t->frame->get_pixel_intensities(), 0, wall_panel_pixels(_wall) * sizeof(uint16_t));
+    t->frame->mark_modified();
+    int location[2];
+    for (int l = 0; l < num_layers; l++)
+    {
+        layers[l]->get_bottom_left_location(location);
+        merge_frame_into_tile(tile, location[0], location[1], layers[l]->get_current_frame(),
+                              modes == nullptr ? BLEND_ADD : modes[l],
+                              weights == nullptr ? DUTY_CYCLE_RESOLUTION : weights[l]);
+    }
+}
+
+/*
+*  Writes the pixels of a tile as its panel sees them (turned by its mounting), row by row,
+*  panel_cols * panel_rows values, ready to be shifted out to the panel.
+*/
+void TiledCanvas::pack_tile(int tile, uint16_t *output)
+{
+    PanelTile *t = get_tile(tile);
+    if (t == nullptr)
+    {
+        return;
+    }
+    bool mirror_x = (t->mounting == TRANSFORM_MIRROR_X || t->mounting == TRANSFORM_ROTATE_180);
+    bool mirror_y = (t->mounting == TRANSFORM_MIRROR_Y || t->mounting == TRANSFORM_ROTATE_180);
+    wall_pack_tile(_wall, t->frame->get_pixel_intensities(), mirror_x, mirror_y, output);
+}
+/*
+*  Packs every panel connected to "driver" into "output", one panel after the other in chain order
+*  (the panel at chain_pos n starts at output[n * panel_cols * panel_rows]).
+*  Returns the number of panels the output holds: the highest chain_pos on the driver plus one.
+*/
+int TiledCanvas::pack_driver(uint8_t driver, uint16_t *output)
+{
+    const int panel_pixels = wall_panel_pixels(_wall);
+    int num_panels = 0;
+    for (int t = 0; t < get_num_tiles(); t++)
+    {
+        if (_tiles[t].driver != driver)
+        {
+            continue;
+        }
+        pack_tile(t, &output[_tiles[t].chain_pos * panel_pixels]);
+        num_panels = max(num_panels, _tiles[t].chain_pos + 1);
+    }
+    return num_panels;
+}
@@ -0,0 +1,65 @@
+/*
+  TiledCanvas.h - one large canvas shown on a wall of several Fetch panels
+  Copyright (c) 2019 Simen E. Sørensen.
+*/
+
+// ensure this library description is only included once
+#ifndef TiledCanvas_h
+#define TiledCanvas_h
+
+#include <Arduino.h>
+#include "Animation.h"
+#include "WallLayout.h"
+
+//One panel of the wall, showing a panel sized part (tile) of the canvas
+struct PanelTile
+{
+    Frame         *frame;     //The pixels of the tile, in canvas orientation
+    int            x;         //Bottom left corner of the tile in the canvas
+    int            y;
+    uint8_t        driver;    //Output (chain of magnet driver boards) the panel is connected to
+    uint8_t        chain_pos; //Position of the panel on its driver, 0 is the first panel in the chain
+    FrameTransform mounting;  //How the panel is turned, e.g. TRANSFORM_ROTATE_180 for a panel mounted upside down
+};
+
+/*
+*  A canvas of panels_x * panels_y panels, each panel_cols * panel_rows pixels. Every panel has
+*  a Frame of its own (its tile), so anything placed on the canvas is merged into each tile it
+*  overlaps, clipped by the tile like Frame::merge_with_frame() clips. Sprites that cross the
+*  edge between two panels therefore show up on both, with no seam.
+*
+*  The tiles are independent of each other, so they can be composited and packed for their
+*  driver one at a time (render_tile() then pack_tile()), which keeps the work per step small
+*  on the display. The host tools render the tiles of tools/anim_wall.cpp in parallel the same way.
+*
+*  Tiles are numbered row by row from the bottom left panel. Where the tiles are and how they
+*  are packed is in WallLayout.h, shared with tools/anim_wall.cpp.
+*/
+class TiledCanvas
+{
+public:
+    TiledCanvas(int panels_x, int panels_y, int panel_cols = COLS, int panel_rows = ROWS);
+    ~TiledCanvas();
+    int         get_width();
+    int         get_height();
+    int         get_num_tiles();
+    PanelTile*  get_tile(int tile);
+    int         get_tile_at(int x, int y);
+    void        set_tile_mapping(int tile, uint8_t driver, uint8_t chain_pos, FrameTransform mounting = TRANSFORM_NONE);
+    void        set_zigzag_mapping(uint8_t driver = 0);
+
+    void        clear();
+    uint16_t    get_pixel_intensity_at(int x, int y);
+    void        merge_frame(int bottom_left_x, int bottom_left_y, Frame *frame, BlendMode mode = BLEND_ADD, uint16_t weight = DUTY_CYCLE_RESOLUTION);
+    void        merge_frame_into_tile(int tile, int bottom_left_x, int bottom_left_y, Frame *frame, BlendMode mode = BLEND_ADD, uint16_t weight = DUTY_CYCLE_RESOLUTION);
+    void        render_tile(int tile, Animation **layers, int num_layers, BlendMode *modes = nullptr, uint16_t *weights = nullptr);
+
+    void        pack_tile(int tile, uint16_t *output);
+    int         pack_driver(uint8_t driver, uint16_t *output);
+
+private:
+    WallLayout  _wall;
+    PanelTile  *_tiles;
+};
+
+#endif
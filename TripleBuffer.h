@@ -0,0 +1,85 @@
+/*
+  TripleBuffer.h - hands complete frames from the main loop to the refresh interrupt
+  Copyright (c) 2019 Simen E. Sørensen.
+
+  This header does not depend on Arduino, so that tools/anim_bench.cpp can hammer it
+  from two threads on a PC.
+
+  The refresh interrupt can fire while the main loop is half way through advancing an
+  animation or merging layers, and would then show a frame that is half old and half new.
+  With three buffers the two sides never touch the same one:
+      back   - written by the producer (the main loop)
+      middle - the newest complete frame, waiting to be picked up
+      front  - read by the consumer (the refresh interrupt)
+  publish() swaps back and middle, get_front() swaps middle and front if a newer frame has
+  been published. Each swap is a single atomic exchange of one byte, so neither side ever
+  waits for the other and no interrupts have to be disabled.
+
+      struct PanelPixels { uint16_t pixels[COLS * ROWS]; };
+      TripleBuffer<PanelPixels> handoff;
+
+      //Main loop
+      anim.get_current_frame()->copy_pixel_intensities_to(handoff.get_back()->pixels);
+      handoff.publish();
+
+      //Refresh interrupt
+      const PanelPixels *frame = handoff.get_front();
+
+  There must be exactly one producer and one consumer. A frame that is published before the
+  consumer picked up the one before it replaces it: the consumer always gets the newest
+  complete frame, never a queue of old ones.
+*/
+
+#ifndef TripleBuffer_h
+#define TripleBuffer_h
+
+#include <atomic>
+#include <stdint.h>
+
+template <typename T>
+class TripleBuffer
+{
+public:
+    TripleBuffer() {}
+    TripleBuffer(const TripleBuffer &) = delete;
+    TripleBuffer &operator=(const TripleBuffer &) = delete;
+
+    // The buffer the producer fills. It stays the same until publish() is called.
+    T *get_back()
+    {
+        return &_buffers[_back];
+    }
+    // Makes the back buffer the newest complete frame, and gives the producer a free buffer to fill
+    void publish()
+    {
+        //Release: the writes to the buffer are visible before the consumer can see its index
+        _back = _middle.exchange(_back | NEW_FRAME, std::memory_order_acq_rel) & INDEX_MASK;
+    }
+
+    // The newest complete frame. It stays valid (and unchanged) until the next call.
+    const T *get_front()
+    {
+        if (_middle.load(std::memory_order_relaxed) & NEW_FRAME)
+        {
+            //Acquire: the writes of the producer to the buffer are visible before it is read
+            _front = _middle.exchange(_front, std::memory_order_acq_rel) & INDEX_MASK;
+        }
+        return &_buffers[_front];
+    }
+    // True if a frame has been published since the consumer last called get_front()
+    bool has_new_frame() const
+    {
+        return _middle.load(std::memory_order_relaxed) & NEW_FRAME;
+    }
+
+private:
+    static const uint8_t INDEX_MASK = 0x03;
+    static const uint8_t NEW_FRAME = 0x04; //Set in _middle when it holds a frame the consumer has not seen
+
+    T                    _buffers[3];
+    uint8_t              _back = 0;   //Only used by the producer
+    std::atomic<uint8_t> _middle{1};
+    uint8_t              _front = 2;  //Only used by the consumer
+};
+
+#endif
@@ -0,0 +1,105 @@
+/*
+  WallLayout.h - where the panels of a wall are in its canvas, and how they are packed
+  Copyright (c) 2019 Simen E. Sørensen.
+
+  This header does not depend on Arduino, so that tools/anim_wall.cpp splits and packs a
+  wall exactly like TiledCanvas does on the display.
+
+  A wall is panels_x * panels_y panels of panel_cols * panel_rows pixels. Every panel shows
+  one tile of the canvas. Tiles are numbered row by row from the bottom left panel, and a
+  packed driver output holds the panels of its chain one after the other.
+*/
+
+#ifndef WallLayout_h
+#define WallLayout_h
+
+#include <stdint.h>
+#include "FrameLayout.h"
+
+struct WallLayout
+{
+    int panels_x;
+    int panels_y;
+    int panel_cols;
+    int panel_rows;
+};
+
+inline int wall_num_tiles(const WallLayout &wall)
+{
+    return wall.panels_x * wall.panels_y;
+}
+inline int wall_panel_pixels(const WallLayout &wall)
+{
+    return wall.panel_cols * wall.panel_rows;
+}
+
+// Bottom left corner of a tile in the canvas
+inline int wall_tile_x(const WallLayout &wall, int tile)
+{
+    return (tile % wall.panels_x) * wall.panel_cols;
+}
+inline int wall_tile_y(const WallLayout &wall, int tile)
+{
+    return (tile / wall.panels_x) * wall.panel_rows;
+}
+
+// Tile that shows canvas pixel (x,y), or -1 if the pixel is outside of the canvas
+inline int wall_tile_at(const WallLayout &wall, int x, int y)
+{
+    if (x < 0 || x >= wall.panels_x * wall.panel_cols || y < 0 || y >= wall.panels_y * wall.panel_rows)
+    {
+        return -1;
+    }
+    return (y / wall.panel_rows) * wall.panels_x + x / wall.panel_cols;
+}
+
+/*
+*  Range of panels (columns first_px ... last_px, rows first_py ... last_py) that a width*height
+*  rectangle with its bottom left corner at (x,y) overlaps. Returns false if it is outside of the wall.
+*/
+inline bool wall_panels_overlapped(const WallLayout &wall, int x, int y, int width, int height,
+                                   int *first_px, int *last_px, int *first_py, int *last_py)
+{
+    const int last_x = x + width - 1;
+    const int last_y = y + height - 1;
+    if (width <= 0 || height <= 0 || last_x < 0 || last_y < 0 ||
+        x >= wall.panels_x * wall.panel_cols || y >= wall.panels_y * wall.panel_rows)
+    {
+        return false;
+    }
+    *first_px = (x > 0) ? x / wall.panel_cols : 0;
+    *first_py = (y > 0) ? y / wall.panel_rows : 0;
+    *last_px = (last_x / wall.panel_cols < wall.panels_x - 1) ? last_x / wall.panel_cols : wall.panels_x - 1;
+    *last_py = (last_y / wall.panel_rows < wall.panels_y - 1) ? last_y / wall.panel_rows : wall.panels_y - 1;
+    return true;
+}
+
+/*
+*  Zig-zag wiring: every other row of panels is mounted upside down and chained back, so one
+*  chain runs along the bottom row and back along the row above (and so on) with short cables.
+*/
+inline bool wall_zigzag_upside_down(const WallLayout &wall, int tile)
+{
+    return (tile / wall.panels_x) % 2 == 1;
+}
+inline int wall_zigzag_chain_pos(const WallLayout &wall, int tile)
+{
+    const int px = tile % wall.panels_x;
+    const int py = tile / wall.panels_x;
+    return py * wall.panels_x + (wall_zigzag_upside_down(wall, tile) ? wall.panels_x - 1 - px : px);
+}
+
+/*
+*  Writes the pixels of a tile ("pixels", row by row in canvas orientation) as its panel sees them,
+*  mirrored the way the panel is mounted: panel_cols * panel_rows values, ready to be shifted out.
+*  A panel mounted upside down is mirrored in both directions.
+*/
+inline void wall_pack_tile(const WallLayout &wall, const uint16_t *pixels, bool mirror_x, bool mirror_y, uint16_t *output)
+{
+    const int cols = wall.panel_cols;
+    const int rows = wall.panel_rows;
+    FrameLayout mounted = frame_layout_view(frame_layout(cols, rows), cols, rows, mirror_x, mirror_y, 0, 0);
+    frame_layout_copy(mounted, pixels, cols, rows, output);
+}
+
+#endif
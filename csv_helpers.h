@@ -3,6 +3,7 @@
 
 #ifndef CSV_HELPERS_h
 #define CSV_HELPERS_h
+//The functions are inline so that this header can be included from more than one source file.
 /*
  * Read a file one field at a time.
  *
@@ -17,7 +18,7 @@
  * return - negative value for failure.
  *          delimiter, '\n' or zero(EOF) for success.           
  */
-int csvReadText(File* file, char* str, size_t size, char delim) {
+inline int csvReadText(File* file, char* str, size_t size, char delim) {
   char ch;
   int rtn;
   size_t n = 0;
@@ -52,7 +53,7 @@ int csvReadText(File* file, char* str, size_t size, char delim) {
   return rtn;
 }
 
-int csvReadInt(File* file, int* num, char delim) {
+inline int csvReadInt(File* file, int* num, char delim) {
   char buf[20];
   char* ptr;
   int rtn = csvReadText(file, buf, sizeof(buf), delim);
@@ -63,7 +64,7 @@ int csvReadInt(File* file, int* num, char delim) {
   return *ptr == 0 ? rtn : -4;
 }
 
-int csvReadBool(File* file, bool* boolptr, char delim) {
+inline int csvReadBool(File* file, bool* boolptr, char delim) {
   char buf[20];
   char* ptr;
   int rtn = csvReadText(file, buf, sizeof(buf), delim);
@@ -74,7 +75,7 @@ int csvReadBool(File* file, bool* boolptr, char delim) {
   return *ptr == 0 ? rtn : -4;
 }
 
-int csvReadPBType(File* file, PlaybackType* type, char delim) {
+inline int csvReadPBType(File* file, PlaybackType* type, char delim) {
   char buf[20];
   char* ptr;
   int rtn = csvReadText(file, buf, sizeof(buf), delim);
@@ -85,7 +86,7 @@ int csvReadPBType(File* file, PlaybackType* type, char delim) {
   return *ptr == 0 ? rtn : -4;
 }
 
-int csvReadPBState(File* file, PlaybackState* state, char delim) {
+inline int csvReadPBState(File* file, PlaybackState* state, char delim) {
   char buf[20];
   char* ptr;
   int rtn = csvReadText(file, buf, sizeof(buf), delim);
@@ -95,4 +96,183 @@ int csvReadPBState(File* file, PlaybackState* state, char delim) {
   while(isspace(*ptr)) ptr++;
   return *ptr == 0 ? rtn : -4;
 }
+
+/*
+ * Buffered reading.
+ *
+ * The functions above read one byte at a time from the file, which is fine for
+ * a handful of config values but far too slow for whole animations.
+ * CsvReader reads the file in blocks of CSV_BUFFER_SIZE bytes and parses
+ * integers directly from the buffer without copying them first.
+ */
+#define CSV_BUFFER_SIZE 512
+
+struct CsvReader {
+  File* file;
+  char buf[CSV_BUFFER_SIZE];
+  int len;  // number of valid bytes in buf
+  int pos;  // next byte to parse
+};
+
+inline void csvReaderBegin(CsvReader* reader, File* file) {
+  reader->file = file;
+  reader->len = 0;
+  reader->pos = 0;
+}
+
+/*
+ * Returns the next byte without consuming it.
+ *
+ * return - the byte, or -1 at EOF (or read error).
+ */
+inline int csvPeek(CsvReader* reader) {
+  if (reader->pos >= reader->len) {
+    int n = reader->file->read(reader->buf, CSV_BUFFER_SIZE);
+    reader->pos = 0;
+    reader->len = n > 0 ? n : 0;
+    if (reader->len == 0) return -1;
+  }
+  return (unsigned char)reader->buf[reader->pos];
+}
+
+/*
+ * Read the next field as an integer.
+ *
+ * reader - Reader started with csvReaderBegin().
+ *
+ * num - Parsed value.
+ *
+ * delim - csv delimiter.
+ *
+ * return - negative value for failure (-3: not a number, -4: trailing characters).
+ *          delimiter, '\n' or zero(EOF) for success, like csvReadInt().
+ *          An empty field reads as zero.
+ */
+inline int csvReadNextInt(CsvReader* reader, long* num, char delim) {
+  int ch = csvPeek(reader);
+  while (ch == ' ' || ch == '\t' || ch == '\r') {
+    reader->pos++;
+    ch = csvPeek(reader);
+  }
+  if (ch < 0) return 0;  // EOF, no more fields
+  if (ch == delim || ch == '\n') {
+    // Empty field, as left by spreadsheets for blank cells
+    *num = 0;
+    reader->pos++;
+    return ch;
+  }
+  bool negative = false;
+  if (ch == '-' || ch == '+') {
+    negative = (ch == '-');
+    reader->pos++;
+    ch = csvPeek(reader);
+  }
+  if (ch < '0' || ch > '9') {
+    // Skip the rest of the field so the caller can continue with the next one
+    while (ch >= 0 && ch != delim && ch != '\n') {
+      reader->pos++;
+      ch = csvPeek(reader);
+    }
+    if (ch >= 0) reader->pos++;
+    return -3;
+  }
+  long value = 0;
+  while (ch >= '0' && ch <= '9') {
+    value = value * 10 + (ch - '0');
+    reader->pos++;
+    ch = csvPeek(reader);
+  }
+  *num = negative ? -value : value;
+  while (ch == ' ' || ch == '\t' || ch == '\r') {
+    reader->pos++;
+    ch = csvPeek(reader);
+  }
+  if (ch < 0) return 0;
+  reader->pos++;
+  if (ch == delim || ch == '\n') return ch;
+  return -4;
+}
+
+inline int csvReadNextInt(CsvReader* reader, int* num, char delim) {
+  long value = 0;
+  int rtn = csvReadNextInt(reader, &value, delim);
+  if (rtn >= 0) *num = (int)value;
+  return rtn;
+}
+
+/*
+ * Skip the lines that hold no values before the next field: empty lines and lines
+ * with only delimiters and spaces, like the blank rows saved by spreadsheets.
+ *
+ * reader - Reader started with csvReaderBegin().
+ *
+ * delim - csv delimiter.
+ *
+ * lines - Incremented for every line that is skipped.
+ *
+ * return - negative value if the next line starts with an empty field
+ *          (its leading delimiters have been skipped too), zero otherwise.
+ */
+inline int csvSkipEmptyLines(CsvReader* reader, char delim, int* lines) {
+  bool empty_field = false;
+  int ch = csvPeek(reader);
+  while (ch == ' ' || ch == '\t' || ch == '\r' || ch == '\n' || ch == delim) {
+    if (ch == '\n') {
+      (*lines)++;
+      empty_field = false;
+    } else if (ch == delim) {
+      empty_field = true;
+    }
+    reader->pos++;
+    ch = csvPeek(reader);
+  }
+  return (empty_field && ch >= 0) ? -3 : 0;
+}
+
+/*
+ * Buffered writing. Fields are collected in the buffer and written to the
+ * file in blocks. csvWriterEnd() must be called to write the last block.
+ */
+struct CsvWriter {
+  File* file;
+  char buf[CSV_BUFFER_SIZE];
+  int len;
+  bool failed;
+};
+
+inline void csvWriterBegin(CsvWriter* writer, File* file) {
+  writer->file = file;
+  writer->len = 0;
+  writer->failed = false;
+}
+
+inline void csvWriterFlush(CsvWriter* writer) {
+  if (writer->len > 0 &&
+      writer->file->write(writer->buf, writer->len) != (size_t)writer->len) {
+    writer->failed = true;
+  }
+  writer->len = 0;
+}
+
+// Writes "num" followed by "end" (the delimiter or '\n').
+inline void csvWriteInt(CsvWriter* writer, long num, char end) {
+  // Longest value is 11 digits and sign, plus the end character
+  if (writer->len + 13 > CSV_BUFFER_SIZE) csvWriterFlush(writer);
+  char digits[12];
+  int n = 0;
+  unsigned long value = num < 0 ? -(unsigned long)num : num;
+  do {
+    digits[n++] = '0' + value % 10;
+    value /= 10;
+  } while (value > 0);
+  if (num < 0) writer->buf[writer->len++] = '-';
+  while (n > 0) writer->buf[writer->len++] = digits[--n];
+  writer->buf[writer->len++] = end;
+}
+
+// return - true if every byte was written.
+inline bool csvWriterEnd(CsvWriter* writer) {
+  csvWriterFlush(writer);
+  return !writer->failed;
+}
 #endif //CSV_HELPERS_h
\ No newline at end of file
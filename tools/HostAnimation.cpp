@@ -0,0 +1,451 @@
+#include "HostAnimation.h"
+
+#include <algorithm>
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+HostAnimation::~HostAnimation()
+{
+    _unmap();
+}
+HostAnimation::HostAnimation(HostAnimation &&other) noexcept
+{
+    *this = std::move(other);
+}
+HostAnimation &HostAnimation::operator=(HostAnimation &&other) noexcept
+{
+    if (this != &other)
+    {
+        _unmap();
+        cols = other.cols;
+        rows = other.rows;
+        num_frames = other.num_frames;
+        playback_type = other.playback_type;
+        playback_state = other.playback_state;
+        dir_fwd = other.dir_fwd;
+        current_frame = other.current_frame;
+        prev_frame = other.prev_frame;
+        loop_iteration = other.loop_iteration;
+        max_iterations = other.max_iterations;
+        start_idx = other.start_idx;
+        pixels = std::move(other.pixels);
+        durations = std::move(other.durations);
+        _mapping = other._mapping;
+        _mapping_size = other._mapping_size;
+        _mapped_data_flags = other._mapped_data_flags;
+        other._mapping = nullptr;
+        other._mapping_size = 0;
+    }
+    return *this;
+}
+
+// Public Methods
+void HostAnimation::resize(int new_cols, int new_rows, int new_num_frames)
+{
+    _unmap();
+    cols = new_cols;
+    rows = new_rows;
+    num_frames = new_num_frames;
+    pixels.assign((size_t)cols * rows * num_frames, 0);
+    durations.assign(num_frames, ANIM_DEFAULT_FRAME_DURATION);
+}
+
+const uint16_t *HostAnimation::frame(int f) const
+{
+    if (_mapping != nullptr)
+    {
+        return (const uint16_t *)((const char *)_mapping + anim_frame_offset(f, cols, rows));
+    }
+    return &pixels[(size_t)f * cols * rows];
+}
+//Writable pixels of frame "f". The pixels of a mapped animation are read only, call copy_mapped_pixels() first.
+uint16_t *HostAnimation::edit_frame(int f)
+{
+    if (_mapping != nullptr)
+    {
+        return nullptr;
+    }
+    return &pixels[(size_t)f * cols * rows];
+}
+bool HostAnimation::is_mapped() const
+{
+    return _mapping != nullptr;
+}
+//Reads every pixel of a mapped animation into "pixels" and unmaps the data file, so the frames can be edited
+void HostAnimation::copy_mapped_pixels()
+{
+    if (_mapping == nullptr)
+    {
+        return;
+    }
+    const uint16_t *mapped = frame(0);
+    pixels.assign(mapped, mapped + (size_t)num_frames * cols * rows);
+    _unmap();
+}
+
+uint32_t HostAnimation::get_total_duration() const
+{
+    uint32_t total = 0;
+    for (int f = 0; f < num_frames; f++)
+    {
+        total += durations[f];
+    }
+    return total;
+}
+
+int HostAnimation::get_data_flags() const
+{
+    //Same rule as Animation::save_to_SD_card(): durations are only stored if they are needed, power always
+    int flags = ANIM_DATA_POWER;
+    for (int f = 0; f < num_frames; f++)
+    {
+        if (durations[f] != ANIM_DEFAULT_FRAME_DURATION)
+        {
+            flags |= ANIM_DATA_DURATIONS;
+            break;
+        }
+    }
+    return flags;
+}
+
+bool HostAnimation::_read_config(const std::string &dir, unsigned index, int *data_flags, std::string *error)
+{
+    std::string path = host_anim_path(dir, ANIM_CONFIG_FILENAME_FMT, index);
+    FILE *file = fopen(path.c_str(), "rb");
+    if (file == nullptr)
+    {
+        *error = "open file: '" + path + "' failed";
+        return false;
+    }
+    char config_str[256];
+    size_t len = fread(config_str, 1, sizeof(config_str) - 1, file);
+    config_str[len] = 0;
+    fclose(file);
+
+    int fields[ANIM_LEGACY_CONFIG_FIELDS + 1] = {0};
+    int num_fields = 0;
+    char *ptr = config_str;
+    while (num_fields < ANIM_LEGACY_CONFIG_FIELDS + 1)
+    {
+        char *end;
+        long value = strtol(ptr, &end, 10);
+        if (end == ptr)
+        {
+            break;
+        }
+        fields[num_fields++] = (int)value;
+        ptr = end;
+        while (*ptr == ' ' || *ptr == '\r' || *ptr == '\n')
+        {
+            ptr++;
+        }
+        if (*ptr != ',')
+        {
+            break;
+        }
+        ptr++;
+    }
+    if (num_fields < ANIM_LEGACY_CONFIG_FIELDS)
+    {
+        *error = "could not parse '" + path + "'";
+        return false;
+    }
+    *data_flags = (num_fields > ANIM_LEGACY_CONFIG_FIELDS) ? fields[ANIM_LEGACY_CONFIG_FIELDS] : 0;
+    if (fields[0] <= 0 || fields[1] <= 0 || fields[2] < 0)
+    {
+        *error = "invalid size in '" + path + "'";
+        return false;
+    }
+
+    //Only the size is set here, the callers decide where the pixels live
+    _unmap();
+    cols = fields[0];
+    rows = fields[1];
+    num_frames = fields[2];
+    pixels.clear();
+    durations.assign(num_frames, ANIM_DEFAULT_FRAME_DURATION);
+    playback_type = fields[3];
+    playback_state = fields[4];
+    dir_fwd = fields[5];
+    current_frame = fields[6];
+    prev_frame = fields[7];
+    loop_iteration = fields[8];
+    max_iterations = fields[9];
+    start_idx = fields[10];
+    return true;
+}
+
+bool HostAnimation::read_from_dir(const std::string &dir, unsigned index, std::string *error)
+{
+    int data_flags;
+    if (!_read_config(dir, index, &data_flags, error))
+    {
+        return false;
+    }
+    pixels.assign((size_t)cols * rows * num_frames, 0);
+    std::string path = host_anim_path(dir, ANIM_DATA_FILENAME_FMT, index);
+    FILE *file = fopen(path.c_str(), "rb");
+    if (file == nullptr)
+    {
+        *error = "open file: '" + path + "' failed";
+        return false;
+    }
+    bool ok = fread(pixels.data(), 1, anim_frame_offset(num_frames, cols, rows), file) == anim_frame_offset(num_frames, cols, rows);
+    if (ok && (data_flags & ANIM_DATA_DURATIONS))
+    {
+        ok = fread(durations.data(), sizeof(uint16_t), num_frames, file) == (size_t)num_frames;
+    }
+    fclose(file);
+    if (!ok)
+    {
+        *error = "'" + path + "' is shorter than its config file says";
+        return false;
+    }
+    for (int f = 0; f < num_frames; f++)
+    {
+        if (durations[f] < 1)
+        {
+            durations[f] = 1;
+        }
+    }
+    return true;
+}
+
+/*
+*  Reads a data file written by the first version of Animation::save_to_SD_card(), which
+*  wrote frames*cols*rows bytes instead of pixels: only the first half of the pixels made
+*  it to the card. The pixels that are there are read, the rest are left dark (zero), so the
+*  frame count and the playback settings still fit. "intact_frames" is set to the number of
+*  frames that are complete. Fails if the data file is not exactly that short.
+*/
+bool HostAnimation::read_legacy_truncated(const std::string &dir, unsigned index, int *intact_frames, std::string *error)
+{
+    int data_flags;
+    if (!_read_config(dir, index, &data_flags, error))
+    {
+        return false;
+    }
+    std::string path = host_anim_path(dir, ANIM_DATA_FILENAME_FMT, index);
+    const size_t legacy_size = (size_t)num_frames * cols * rows;
+    struct stat info;
+    if (stat(path.c_str(), &info) != 0 || data_flags != 0 || legacy_size == 0 || (size_t)info.st_size != legacy_size)
+    {
+        *error = "'" + path + "' is not a truncated legacy data file";
+        return false;
+    }
+    FILE *file = fopen(path.c_str(), "rb");
+    if (file == nullptr)
+    {
+        *error = "open file: '" + path + "' failed";
+        return false;
+    }
+    pixels.assign((size_t)cols * rows * num_frames, 0);
+    bool ok = fread(pixels.data(), 1, legacy_size, file) == legacy_size;
+    fclose(file);
+    if (!ok)
+    {
+        *error = "read from '" + path + "' failed";
+        return false;
+    }
+    *intact_frames = (int)(legacy_size / anim_frame_size(cols, rows));
+    return true;
+}
+
+/*
+*  Opens an animation without reading its pixels: the data file is mapped into memory
+*  and frame() points straight into it. The operating system only reads the pages that
+*  are actually used, so opening thousands of animations to look at a few frames each
+*  is fast and cheap. The mapping is read only, so frame() can not be written through:
+*  call copy_mapped_pixels() before editing the frames, and save_to_dir() to store them.
+*/
+bool HostAnimation::map_from_dir(const std::string &dir, unsigned index, std::string *error)
+{
+    int data_flags;
+    if (!_read_config(dir, index, &data_flags, error))
+    {
+        return false;
+    }
+    std::string path = host_anim_path(dir, ANIM_DATA_FILENAME_FMT, index);
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        *error = "open file: '" + path + "' failed";
+        return false;
+    }
+    struct stat info;
+    size_t needed = anim_data_file_size(num_frames, cols, rows, data_flags);
+    if (fstat(fd, &info) != 0 || (size_t)info.st_size < needed)
+    {
+        close(fd);
+        *error = "'" + path + "' is shorter than its config file says";
+        return false;
+    }
+    void *mapping = nullptr;
+    if (needed > 0)
+    {
+        mapping = mmap(nullptr, needed, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd); //The mapping stays valid after the file is closed
+    if (mapping == MAP_FAILED || (needed > 0 && mapping == nullptr))
+    {
+        *error = "mapping '" + path + "' failed";
+        return false;
+    }
+    pixels.shrink_to_fit();
+    _mapping = mapping;
+    _mapping_size = needed;
+    _mapped_data_flags = data_flags;
+    if (data_flags & ANIM_DATA_DURATIONS)
+    {
+        const uint16_t *table = (const uint16_t *)((const char *)_mapping + anim_durations_offset(num_frames, cols, rows));
+        for (int f = 0; f < num_frames; f++)
+        {
+            durations[f] = table[f] < 1 ? 1 : table[f];
+        }
+    }
+    return true;
+}
+
+//Same entry as AnimCatalog::make_entry() on the display. Only for mapped animations: the checksum is of the mapped data file.
+bool HostAnimation::make_catalog_entry(unsigned index, AnimCatalogEntry *entry) const
+{
+    if (_mapping == nullptr && anim_data_file_size(num_frames, cols, rows, _mapped_data_flags) > 0)
+    {
+        return false;
+    }
+    memset(entry, 0, sizeof(AnimCatalogEntry));
+    entry->anim_index = index;
+    entry->in_use = 1;
+    entry->data_flags = _mapped_data_flags;
+    entry->cols = cols;
+    entry->rows = rows;
+    entry->num_frames = num_frames;
+    entry->playback_type = playback_type;
+    entry->total_duration = get_total_duration();
+    entry->data_size = _mapping_size;
+    entry->data_crc = anim_crc32(_mapping, _mapping_size);
+    entry->crc = anim_catalog_entry_crc(entry);
+    return true;
+}
+
+void HostAnimation::_unmap()
+{
+    if (_mapping != nullptr)
+    {
+        munmap(_mapping, _mapping_size);
+        _mapping = nullptr;
+        _mapping_size = 0;
+    }
+}
+
+bool HostAnimation::save_to_dir(const std::string &dir, unsigned index, std::string *error) const
+{
+    int data_flags = get_data_flags();
+
+    std::string path = host_anim_path(dir, ANIM_CONFIG_FILENAME_FMT, index);
+    FILE *file = fopen(path.c_str(), "wb");
+    if (file == nullptr)
+    {
+        *error = "open file: '" + path + "' failed";
+        return false;
+    }
+    fprintf(file, "%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d",
+            cols, rows, num_frames, playback_type, playback_state, dir_fwd ? 1 : 0,
+            current_frame, prev_frame, loop_iteration, max_iterations, start_idx, data_flags);
+    fclose(file);
+
+    path = host_anim_path(dir, ANIM_DATA_FILENAME_FMT, index);
+    file = fopen(path.c_str(), "wb");
+    if (file == nullptr)
+    {
+        *error = "open file: '" + path + "' failed";
+        return false;
+    }
+    bool ok = num_frames == 0 || fwrite(frame(0), 1, anim_frame_offset(num_frames, cols, rows), file) == anim_frame_offset(num_frames, cols, rows);
+    if (ok && (data_flags & ANIM_DATA_DURATIONS))
+    {
+        ok = fwrite(durations.data(), sizeof(uint16_t), num_frames, file) == (size_t)num_frames;
+    }
+    std::vector<uint32_t> row_sums(rows);
+    for (int f = 0; ok && f < num_frames; f++)
+    {
+        AnimFramePower power;
+        anim_frame_power(frame(f), cols, rows, &power, row_sums.data());
+        ok = fwrite(&power, sizeof(power), 1, file) == 1 &&
+             fwrite(row_sums.data(), sizeof(uint32_t), rows, file) == (size_t)rows;
+    }
+    if (fclose(file) != 0 || !ok)
+    {
+        *error = "write to '" + path + "' failed";
+        return false;
+    }
+    return true;
+}
+
+std::string host_anim_path(const std::string &dir, const char *fmt, unsigned index)
+{
+    char filename[32];
+    snprintf(filename, sizeof(filename), fmt, index);
+    if (dir.empty())
+    {
+        return filename;
+    }
+    return dir + "/" + filename;
+}
+
+bool host_write_catalog(const std::string &dir, const std::vector<AnimCatalogEntry> &entries, std::string *error)
+{
+    std::string path = dir.empty() ? CATALOG_FILENAME : dir + "/" + CATALOG_FILENAME;
+    FILE *file = fopen(path.c_str(), "wb");
+    AnimCatalogHeader header;
+    header.magic = CATALOG_MAGIC;
+    header.version = CATALOG_VERSION;
+    header.entry_size = sizeof(AnimCatalogEntry);
+    bool ok = file != nullptr && fwrite(&header, sizeof(header), 1, file) == 1 &&
+              fwrite(entries.data(), sizeof(AnimCatalogEntry), entries.size(), file) == entries.size();
+    if (file != nullptr)
+    {
+        ok = fclose(file) == 0 && ok;
+    }
+    if (!ok)
+    {
+        *error = "write to '" + path + "' failed";
+    }
+    return ok;
+}
+
+std::vector<unsigned> host_list_animations(const std::string &dir)
+{
+    std::vector<unsigned> indices;
+    DIR *d = opendir(dir.empty() ? "." : dir.c_str());
+    if (d == nullptr)
+    {
+        return indices;
+    }
+    while (struct dirent *entry = readdir(d))
+    {
+        unsigned index;
+        //Only accept names that are exactly "A<number>_C.txt", not "A01_C.txt" or "A1_C.txt.bak"
+        if (sscanf(entry->d_name, "A%u_C.txt", &index) == 1 &&
+            host_anim_path("", ANIM_CONFIG_FILENAME_FMT, index) == entry->d_name)
+        {
+            indices.push_back(index);
+        }
+    }
+    closedir(d);
+    std::sort(indices.begin(), indices.end());
+    return indices;
+}
+
+void host_merge_frame(uint16_t *dst, int dst_cols, int dst_rows,
+                      const uint16_t *src, int src_cols, int src_rows, int x, int y,
+                      BlendMode mode, uint16_t weight)
+{
+    blend_frames_with_mode(dst, frame_layout(dst_cols, dst_rows), dst_cols, src, frame_layout(src_cols, src_rows), src_cols,
+                           x, y, mode, weight);
+}
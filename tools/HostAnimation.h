@@ -0,0 +1,94 @@
+/*
+  HostAnimation.h - reads and writes Fetch animation files on a PC
+  Copyright (c) 2019 Simen E. Sørensen.
+
+  Host side counterpart of Animation::save_to_SD_card()/read_from_SD_card()
+  used by the tools in this folder. Uses the same file layout (AnimationFormat.h).
+*/
+
+#ifndef HostAnimation_h
+#define HostAnimation_h
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "../AnimationFormat.h"
+#include "../BlendModes.h"
+#include "../FrameLayout.h"
+#include "../Playback.h"
+
+class HostAnimation
+{
+public:
+    HostAnimation() {}
+    ~HostAnimation();
+    HostAnimation(HostAnimation &&other) noexcept;
+    HostAnimation &operator=(HostAnimation &&other) noexcept;
+    HostAnimation(const HostAnimation &) = delete;
+    HostAnimation &operator=(const HostAnimation &) = delete;
+
+    int cols = 0;
+    int rows = 0;
+    int num_frames = 0;
+
+    //Playback settings, stored in the config file in the same order as on the display
+    int playback_type = LOOP;
+    int playback_state = 0;
+    int dir_fwd = 1;
+    int current_frame = 0;
+    int prev_frame = -1;
+    int loop_iteration = 0;
+    int max_iterations = -1;
+    int start_idx = 0;
+
+    std::vector<uint16_t> pixels;    //num_frames*cols*rows pixel intensities, frame by frame, row by row. Empty if mapped, use frame().
+    std::vector<uint16_t> durations; //Number of ticks each frame is held
+
+    void            resize(int new_cols, int new_rows, int new_num_frames);
+    const uint16_t* frame(int f) const;
+    uint16_t*       edit_frame(int f);
+    uint32_t        get_total_duration() const;
+    int             get_data_flags() const;
+    bool            is_mapped() const;
+    void            copy_mapped_pixels();
+
+    bool read_from_dir(const std::string &dir, unsigned index, std::string *error);
+    bool map_from_dir(const std::string &dir, unsigned index, std::string *error);
+    bool read_legacy_truncated(const std::string &dir, unsigned index, int *intact_frames, std::string *error);
+    bool save_to_dir(const std::string &dir, unsigned index, std::string *error) const;
+    bool make_catalog_entry(unsigned index, AnimCatalogEntry *entry) const;
+
+private:
+    //Set by map_from_dir(): the whole data file, mapped read only
+    void  *_mapping = nullptr;
+    size_t _mapping_size = 0;
+    int    _mapped_data_flags = 0;
+
+    void _unmap();
+
+    bool _read_config(const std::string &dir, unsigned index, int *data_flags, std::string *error);
+};
+
+//Indices of every animation (A%u_C.txt) in "dir", sorted
+std::vector<unsigned> host_list_animations(const std::string &dir);
+
+std::string host_anim_path(const std::string &dir, const char *fmt, unsigned index);
+
+//Writes the catalog of "dir" (CATALOG.bin, see Catalog.h), the same layout AnimCatalog::rebuild() writes
+bool host_write_catalog(const std::string &dir, const std::vector<AnimCatalogEntry> &entries, std::string *error);
+
+//Blends "src" into "dst" with its bottom left corner at (x, y), exactly like Frame::merge_with_frame()
+void host_merge_frame(uint16_t *dst, int dst_cols, int dst_rows,
+                      const uint16_t *src, int src_cols, int src_rows, int x, int y,
+                      BlendMode mode = BLEND_ADD, uint16_t weight = DUTY_CYCLE_RESOLUTION);
+
+//host_merge_frame() with the blend chosen at compile time (see BlendModes.h)
+template <typename Blend>
+void host_blend_frame(uint16_t *dst, int dst_cols, int dst_rows,
+                      const uint16_t *src, int src_cols, int src_rows, int x, int y, Blend blend)
+{
+    blend_frames(dst, frame_layout(dst_cols, dst_rows), dst_cols, src, frame_layout(src_cols, src_rows), src_cols, x, y, blend);
+}
+
+#endif
@@ -0,0 +1,156 @@
+#include "HostScene.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int parse_playback_type(const char *name)
+{
+    const char *names[] = {"ONCE", "LOOP", "BOUNCE", "LOOP_N_TIMES"};
+    for (int i = 0; i < 4; i++)
+    {
+        if (strcmp(name, names[i]) == 0)
+        {
+            return i;
+        }
+    }
+    return atoi(name);
+}
+
+static BlendMode parse_blend_mode(const char *name)
+{
+    for (int i = 0; i < NUM_BLEND_MODES; i++)
+    {
+        if (strcmp(name, blend_mode_name((BlendMode)i)) == 0)
+        {
+            return (BlendMode)i;
+        }
+    }
+    return NUM_BLEND_MODES;
+}
+
+bool host_read_scene(const char *path, HostScene *scene)
+{
+    FILE *file = fopen(path, "r");
+    if (file == nullptr)
+    {
+        fprintf(stderr, "open file: '%s' failed\n", path);
+        return false;
+    }
+    char line[256];
+    int line_num = 0;
+    bool ok = true;
+    while (ok && fgets(line, sizeof(line), file))
+    {
+        line_num++;
+        char *comment = strchr(line, '#');
+        if (comment)
+        {
+            *comment = 0;
+        }
+        char keyword[32];
+        if (sscanf(line, "%31s", keyword) != 1)
+        {
+            continue;
+        }
+        if (strcmp(keyword, "output") == 0)
+        {
+            ok = sscanf(line, "%*s %u", &scene->output_index) == 1;
+            scene->has_output = ok;
+        }
+        else if (strcmp(keyword, "size") == 0)
+        {
+            ok = sscanf(line, "%*s %d %d", &scene->cols, &scene->rows) == 2 && scene->cols > 0 && scene->rows > 0;
+        }
+        else if (strcmp(keyword, "playback") == 0)
+        {
+            char type[32];
+            ok = sscanf(line, "%*s %31s %d %d", type, &scene->dir_fwd, &scene->max_iterations) == 3;
+            scene->playback_type = parse_playback_type(type);
+        }
+        else if (strcmp(keyword, "collapse") == 0)
+        {
+            int collapse;
+            ok = sscanf(line, "%*s %d", &collapse) == 1;
+            scene->collapse = collapse != 0;
+        }
+        else if (strcmp(keyword, "layer") == 0)
+        {
+            HostLayer layer;
+            int n = sscanf(line, "%*s %u %d %d %d %d", &layer.index, &layer.location_x, &layer.location_y,
+                           &layer.origin_x, &layer.origin_y);
+            ok = (n == 3 || n == 5);
+            scene->layers.push_back(std::move(layer));
+        }
+        else if (strcmp(keyword, "blend") == 0)
+        {
+            char mode[32];
+            int weight = DUTY_CYCLE_RESOLUTION;
+            ok = !scene->layers.empty() && sscanf(line, "%*s %31s %d", mode, &weight) >= 1 &&
+                 weight >= 0 && weight <= DUTY_CYCLE_RESOLUTION;
+            if (ok)
+            {
+                HostLayer &layer = scene->layers.back();
+                layer.blend = parse_blend_mode(mode);
+                layer.weight = weight;
+                ok = layer.blend != NUM_BLEND_MODES;
+            }
+        }
+        else
+        {
+            ok = false;
+        }
+        if (!ok)
+        {
+            fprintf(stderr, "%s:%d: could not parse '%s'\n", path, line_num, keyword);
+        }
+    }
+    fclose(file);
+    return ok;
+}
+
+bool host_load_scene_layers(const std::string &dir, HostScene *scene)
+{
+    scene->ticks = 0;
+    for (HostLayer &layer : scene->layers)
+    {
+        std::string error;
+        if (!layer.anim.map_from_dir(dir, layer.index, &error)) //Read only, pages are loaded as the frames are used
+        {
+            fprintf(stderr, "layer %u: %s\n", layer.index, error.c_str());
+            return false;
+        }
+        layer.frame_at_tick.clear();
+        for (int f = 0; f < layer.anim.num_frames; f++)
+        {
+            layer.frame_at_tick.insert(layer.frame_at_tick.end(), layer.anim.durations[f], f);
+        }
+        if ((int)layer.frame_at_tick.size() > scene->ticks)
+        {
+            scene->ticks = (int)layer.frame_at_tick.size();
+        }
+    }
+    return true;
+}
+
+void host_render_scene_tick(const HostScene &scene, int tick, uint16_t *output)
+{
+    host_render_scene_region(scene, tick, 0, 0, scene.cols, scene.rows, output);
+}
+
+void host_render_scene_region(const HostScene &scene, int tick, int x, int y, int cols, int rows, uint16_t *output)
+{
+    memset(output, 0, (size_t)cols * rows * sizeof(uint16_t));
+    for (const HostLayer &layer : scene.layers)
+    {
+        if (tick >= (int)layer.frame_at_tick.size())
+        {
+            continue; //This layer has ended, like a shorter animation in Animation::merge_with()
+        }
+        //Same placement as Animation::get_bottom_left_location(), moved by the corner of the region
+        host_merge_frame(output, cols, rows,
+                         layer.anim.frame(layer.frame_at_tick[tick]), layer.anim.cols, layer.anim.rows,
+                         layer.location_x - layer.origin_x - x, layer.location_y - layer.origin_y - y,
+                         layer.blend, layer.weight);
+    }
+}
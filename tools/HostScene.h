@@ -0,0 +1,63 @@
+/*
+  HostScene.h - compositions of Fetch animations, shared by the host tools
+  Copyright (c) 2019 Simen E. Sørensen.
+
+  Scene file (one statement per line, '#' starts a comment):
+    output <index>                      index of the A%u files to write (anim_bake)
+    size <cols> <rows>                  canvas size (default 19 10)
+    playback <type> <forward> <loops>   ONCE/LOOP/BOUNCE/LOOP_N_TIMES, 1/0, max loop count
+    collapse <0|1>                      hold repeated frames instead of storing them (default 1)
+    layer <index> <x> <y> [<ox> <oy>]   animation to merge at location (x,y) with origin (ox,oy)
+    blend <mode> [<weight>]             how the layer above is merged (see BlendModes.h): add (default),
+                                        max, replace, multiply, subtract or weighted (weight 0-4096)
+
+  Layers are merged in the order they are listed, like calling Animation::merge_with()
+  with their blend mode for each of them. The scene is one frame per tick of the longest layer,
+  taking frame durations into account.
+*/
+
+#ifndef HostScene_h
+#define HostScene_h
+
+#include <string>
+#include <vector>
+
+#include "HostAnimation.h"
+
+struct HostLayer
+{
+    unsigned index;
+    int location_x;
+    int location_y;
+    int origin_x = 0;
+    int origin_y = 0;
+    BlendMode blend = BLEND_ADD;
+    uint16_t weight = DUTY_CYCLE_RESOLUTION; //Only used by BLEND_WEIGHTED
+    HostAnimation anim;
+    std::vector<int> frame_at_tick; //Frame shown at every tick, taking the frame durations into account
+};
+
+struct HostScene
+{
+    unsigned output_index = 0;
+    bool has_output = false;
+    int cols = 19;
+    int rows = 10;
+    int playback_type = LOOP;
+    int dir_fwd = 1;
+    int max_iterations = -1;
+    bool collapse = true;
+    std::vector<HostLayer> layers;
+    int ticks = 0; //Length of the longest layer, set by host_load_scene_layers()
+};
+
+//Parses a scene file. Errors are printed to stderr.
+bool host_read_scene(const char *path, HostScene *scene);
+//Maps the animation of every layer from "dir" and works out which frame each layer shows at every tick
+bool host_load_scene_layers(const std::string &dir, HostScene *scene);
+//Renders a single tick of the scene into "output" (cols*rows pixels)
+void host_render_scene_tick(const HostScene &scene, int tick, uint16_t *output);
+//Renders the part of a tick that starts at (x,y) of the scene and is cols*rows pixels, e.g. one panel of a wall
+void host_render_scene_region(const HostScene &scene, int tick, int x, int y, int cols, int rows, uint16_t *output);
+
+#endif
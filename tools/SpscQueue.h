@@ -0,0 +1,71 @@
+/*
+  SpscQueue.h - lock-free queue between exactly one producer thread and one consumer thread
+  Copyright (c) 2019 Simen E. Sørensen.
+
+  A fixed ring of Capacity slots (a power of two). The producer only writes _tail and the
+  consumer only writes _head, so neither side ever takes a lock or waits for the other
+  unless the queue is full or empty. Used to connect the stages of anim_stream.
+*/
+
+#ifndef SpscQueue_h
+#define SpscQueue_h
+
+#include <atomic>
+#include <stddef.h>
+#include <thread>
+#include <utility>
+
+template <typename T, size_t Capacity>
+class SpscQueue
+{
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+    //Producer side. Returns false if the queue is full.
+    bool try_push(T &&item)
+    {
+        size_t tail = _tail.load(std::memory_order_relaxed);
+        if (tail - _head.load(std::memory_order_acquire) == Capacity)
+        {
+            return false;
+        }
+        _slots[tail & (Capacity - 1)] = std::move(item);
+        _tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+    //Consumer side. Returns false if the queue is empty.
+    bool try_pop(T *item)
+    {
+        size_t head = _head.load(std::memory_order_relaxed);
+        if (head == _tail.load(std::memory_order_acquire))
+        {
+            return false;
+        }
+        *item = std::move(_slots[head & (Capacity - 1)]);
+        _head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+    //Blocking versions, for stages that have nothing else to do while they wait
+    void push(T &&item)
+    {
+        while (!try_push(std::move(item)))
+        {
+            std::this_thread::yield();
+        }
+    }
+    void pop(T *item)
+    {
+        while (!try_pop(item))
+        {
+            std::this_thread::yield();
+        }
+    }
+
+private:
+    //On separate cache lines, so that the two threads do not slow each other down
+    alignas(64) std::atomic<size_t> _head{0};
+    alignas(64) std::atomic<size_t> _tail{0};
+    alignas(64) T _slots[Capacity];
+};
+
+#endif
@@ -0,0 +1,183 @@
+/*
+  ThreadPool.h - small work-stealing thread pool for the host tools
+  Copyright (c) 2019 Simen E. Sørensen.
+
+  Every worker has its own queue. Workers take tasks from the back of their
+  own queue and, when it is empty, steal from the front of the other queues,
+  so uneven tasks (e.g. frames with many layers) still keep every core busy.
+*/
+
+#ifndef ThreadPool_h
+#define ThreadPool_h
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool
+{
+public:
+    explicit ThreadPool(unsigned num_threads = 0)
+    {
+        if (num_threads == 0)
+        {
+            num_threads = std::thread::hardware_concurrency();
+        }
+        if (num_threads == 0)
+        {
+            num_threads = 1;
+        }
+        for (unsigned i = 0; i < num_threads; i++)
+        {
+            _queues.emplace_back(new Queue());
+        }
+        for (unsigned i = 0; i < num_threads; i++)
+        {
+            _workers.emplace_back([this, i] { _worker_loop(i); });
+        }
+    }
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(_wake_mutex);
+            _stopping = true;
+        }
+        _wake.notify_all();
+        for (std::thread &worker : _workers)
+        {
+            worker.join();
+        }
+    }
+    unsigned get_num_threads() const
+    {
+        return (unsigned)_workers.size();
+    }
+
+    void submit(std::function<void()> task)
+    {
+        unsigned q = _next_queue.fetch_add(1) % _queues.size();
+        {
+            std::lock_guard<std::mutex> lock(_queues[q]->mutex);
+            _queues[q]->tasks.push_back(std::move(task));
+        }
+        {
+            std::lock_guard<std::mutex> lock(_wake_mutex);
+            _pending++;
+            _queued++;
+        }
+        _wake.notify_one();
+    }
+
+    //Blocks until every submitted task has finished
+    void wait_idle()
+    {
+        std::unique_lock<std::mutex> lock(_wake_mutex);
+        _idle.wait(lock, [this] { return _pending == 0; });
+    }
+
+    /*
+    *  Calls fn(i) for every i in [begin, end), split into chunks of "chunk" indices,
+    *  and waits for all of them. Results should be written to slots indexed by i so
+    *  the output does not depend on which thread ran which chunk.
+    */
+    template <class Fn>
+    void parallel_for(int begin, int end, int chunk, Fn fn)
+    {
+        if (chunk < 1)
+        {
+            chunk = 1;
+        }
+        for (int first = begin; first < end; first += chunk)
+        {
+            int last = (first + chunk < end) ? first + chunk : end;
+            submit([first, last, &fn] {
+                for (int i = first; i < last; i++)
+                {
+                    fn(i);
+                }
+            });
+        }
+        wait_idle();
+    }
+
+private:
+    struct Queue
+    {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    std::vector<std::unique_ptr<Queue>> _queues;
+    std::vector<std::thread> _workers;
+    std::atomic<unsigned> _next_queue{0};
+
+    std::mutex _wake_mutex;
+    std::condition_variable _wake;
+    std::condition_variable _idle;
+    int _pending = 0; //Submitted tasks that have not finished yet
+    std::atomic<int> _queued{0}; //Submitted tasks that no worker has taken yet
+    bool _stopping = false;
+
+    bool _take_task(unsigned self, std::function<void()> *task)
+    {
+        //Own queue first (newest task, still warm in the cache), then steal the oldest from the others
+        {
+            Queue &own = *_queues[self];
+            std::lock_guard<std::mutex> lock(own.mutex);
+            if (!own.tasks.empty())
+            {
+                *task = std::move(own.tasks.back());
+                own.tasks.pop_back();
+                _queued--;
+                return true;
+            }
+        }
+        for (size_t i = 1; i < _queues.size(); i++)
+        {
+            Queue &victim = *_queues[(self + i) % _queues.size()];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.tasks.empty())
+            {
+                *task = std::move(victim.tasks.front());
+                victim.tasks.pop_front();
+                _queued--;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void _worker_loop(unsigned self)
+    {
+        std::function<void()> task;
+        while (true)
+        {
+            if (_take_task(self, &task))
+            {
+                task();
+                task = nullptr;
+                std::lock_guard<std::mutex> lock(_wake_mutex);
+                if (--_pending == 0)
+                {
+                    _idle.notify_all();
+                }
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(_wake_mutex);
+            if (_stopping && _queued == 0)
+            {
+                return;
+            }
+            //_queued is increased while holding _wake_mutex, so a task submitted after the
+            //search above is either seen here or wakes us up.
+            _wake.wait(lock, [this] { return _stopping || _queued > 0; });
+        }
+    }
+};
+
+#endif
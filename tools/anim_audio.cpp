@@ -0,0 +1,266 @@
+/*
+  anim_audio.cpp - runs recorded audio through the band analysis of the display and times it
+  Copyright (c) 2019 Simen E. Sørensen.
+
+  Build: g++ -std=c++17 -O2 -o anim_audio anim_audio.cpp
+
+  Usage: anim_audio <file.wav> [--fft <log2 size>] [--bands <n>] [--chunk <samples>]
+                    [--levels] [--csv <file>]
+
+  The first channel of a 16 bit PCM WAV file is fed to AudioBands (FixedFFT.h) in chunks of
+  --chunk samples (64 unless given), the way an ADC buffer would arrive on the display. The
+  time of every call that completed a block is measured, and reported next to the length of
+  audio a block holds, so the share of the time the analysis needs can be read off. The work
+  per block only depends on the FFT size, never on the audio.
+  --levels    prints the level of every band for every block, as bars
+  --csv       writes the levels of every block (time in ms, then one column per band)
+
+  The fixed point FFT is also checked against a floating point DFT of the first block.
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "../FixedFFT.h"
+
+struct WavAudio
+{
+    int sample_rate = 0;
+    int channels = 0;
+    std::vector<int16_t> samples; //Interleaved
+};
+
+static uint32_t read_le(const uint8_t *bytes, int len)
+{
+    uint32_t value = 0;
+    for (int i = len - 1; i >= 0; i--)
+    {
+        value = (value << 8) | bytes[i];
+    }
+    return value;
+}
+
+//Reads a RIFF WAV file with 16 bit PCM samples
+static bool read_wav(const char *path, WavAudio *wav)
+{
+    FILE *file = fopen(path, "rb");
+    if (file == nullptr)
+    {
+        fprintf(stderr, "open file: '%s' failed\n", path);
+        return false;
+    }
+    std::vector<uint8_t> bytes;
+    uint8_t buf[65536];
+    size_t len;
+    while ((len = fread(buf, 1, sizeof(buf), file)) > 0)
+    {
+        bytes.insert(bytes.end(), buf, buf + len);
+    }
+    fclose(file);
+    if (bytes.size() < 12 || memcmp(&bytes[0], "RIFF", 4) != 0 || memcmp(&bytes[8], "WAVE", 4) != 0)
+    {
+        fprintf(stderr, "%s: not a WAV file\n", path);
+        return false;
+    }
+    int bits = 0;
+    bool has_data = false;
+    for (size_t pos = 12; pos + 8 <= bytes.size();)
+    {
+        uint32_t chunk_len = read_le(&bytes[pos + 4], 4);
+        const uint8_t *chunk = &bytes[pos + 8];
+        size_t available = std::min((size_t)chunk_len, bytes.size() - pos - 8);
+        if (memcmp(&bytes[pos], "fmt ", 4) == 0 && available >= 16)
+        {
+            if (read_le(chunk, 2) != 1)
+            {
+                fprintf(stderr, "%s: only PCM samples are supported\n", path);
+                return false;
+            }
+            wav->channels = read_le(chunk + 2, 2);
+            wav->sample_rate = read_le(chunk + 4, 4);
+            bits = read_le(chunk + 14, 2);
+        }
+        else if (memcmp(&bytes[pos], "data", 4) == 0)
+        {
+            wav->samples.resize(available / 2);
+            memcpy(wav->samples.data(), chunk, wav->samples.size() * 2);
+            has_data = true;
+        }
+        pos += 8 + chunk_len + (chunk_len & 1); //Chunks are padded to an even length
+    }
+    if (bits != 16 || wav->channels < 1 || wav->sample_rate <= 0 || !has_data)
+    {
+        fprintf(stderr, "%s: needs 16 bit PCM samples\n", path);
+        return false;
+    }
+    return true;
+}
+
+//Largest difference between the fixed point FFT and a floating point DFT (divided by the size), in Q15 units
+static double check_fft(const FixedFFT &fft, const int16_t *samples, int stride)
+{
+    const int size = fft.get_size();
+    std::vector<int16_t> re(size);
+    std::vector<int16_t> im(size, 0);
+    for (int i = 0; i < size; i++)
+    {
+        re[i] = samples[i * stride];
+    }
+    fft.transform(re.data(), im.data());
+    double max_error = 0;
+    for (int k = 0; k < size; k++)
+    {
+        double exact_re = 0;
+        double exact_im = 0;
+        for (int n = 0; n < size; n++)
+        {
+            double angle = -2.0 * M_PI * k * n / size;
+            exact_re += samples[n * stride] * cos(angle);
+            exact_im += samples[n * stride] * sin(angle);
+        }
+        max_error = std::max(max_error, fabs(re[k] - exact_re / size));
+        max_error = std::max(max_error, fabs(im[k] - exact_im / size));
+    }
+    return max_error;
+}
+
+int main(int argc, char **argv)
+{
+    const char *wav_path = nullptr;
+    const char *csv_path = nullptr;
+    int log2_size = 8;
+    int num_bands = 6;
+    int chunk = 64;
+    bool print_levels = false;
+    bool usage_error = false;
+    for (int i = 1; i < argc && !usage_error; i++)
+    {
+        if (strcmp(argv[i], "--fft") == 0 && i + 1 < argc)
+        {
+            log2_size = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--bands") == 0 && i + 1 < argc)
+        {
+            num_bands = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--chunk") == 0 && i + 1 < argc)
+        {
+            chunk = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--csv") == 0 && i + 1 < argc)
+        {
+            csv_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--levels") == 0)
+        {
+            print_levels = true;
+        }
+        else if (wav_path == nullptr && argv[i][0] != '-')
+        {
+            wav_path = argv[i];
+        }
+        else
+        {
+            usage_error = true;
+        }
+    }
+    if (wav_path == nullptr || usage_error || chunk <= 0)
+    {
+        fprintf(stderr, "usage: %s <file.wav> [--fft <log2 size>] [--bands <n>] [--chunk <samples>]\n"
+                        "       [--levels] [--csv <file>]\n", argv[0]);
+        return 2;
+    }
+    WavAudio wav;
+    if (!read_wav(wav_path, &wav))
+    {
+        return 1;
+    }
+    AudioBands bands(log2_size, num_bands);
+    const int size = bands.get_block_size();
+    const int stride = wav.channels;
+    const int num_samples = (int)(wav.samples.size() / stride);
+    printf("%s: %d Hz, %d channels, %.1f s\n", wav_path, wav.sample_rate, wav.channels, (double)num_samples / wav.sample_rate);
+    printf("%d point FFT (%u butterflies), %d bands:", size, bands.get_fft().get_num_butterflies(), bands.get_num_bands());
+    for (int b = 0; b < bands.get_num_bands(); b++)
+    {
+        int first;
+        int last;
+        bands.get_band_bins(b, &first, &last);
+        printf(" %.0f-%.0f Hz", (first - 0.5) * wav.sample_rate / size, (last + 0.5) * wav.sample_rate / size);
+    }
+    printf("\n");
+    if (num_samples >= size)
+    {
+        printf("FFT of the first block is within %.1f (Q15) of a floating point DFT\n",
+               check_fft(bands.get_fft(), wav.samples.data(), stride));
+    }
+
+    FILE *csv = nullptr;
+    if (csv_path != nullptr && (csv = fopen(csv_path, "w")) == nullptr)
+    {
+        fprintf(stderr, "open file: '%s' failed\n", csv_path);
+        return 1;
+    }
+    using clock = std::chrono::steady_clock;
+    std::vector<double> block_ns;
+    for (int pos = 0; pos < num_samples; pos += chunk)
+    {
+        int count = std::min(chunk, num_samples - pos);
+        auto start = clock::now();
+        int blocks = bands.feed(&wav.samples[(size_t)pos * stride], count, stride);
+        double ns = std::chrono::duration<double, std::nano>(clock::now() - start).count();
+        if (blocks == 0)
+        {
+            continue;
+        }
+        block_ns.push_back(ns / blocks);
+        double ms = (pos + count) * 1000.0 / wav.sample_rate;
+        if (csv != nullptr)
+        {
+            fprintf(csv, "%.1f", ms);
+            for (int b = 0; b < bands.get_num_bands(); b++)
+            {
+                fprintf(csv, ",%u", bands.get_level(b));
+            }
+            fprintf(csv, "\n");
+        }
+        if (print_levels)
+        {
+            static const char bars[] = " .:-=+*#%@";
+            printf("%8.1f ms |", ms);
+            for (int b = 0; b < bands.get_num_bands(); b++)
+            {
+                putchar(bars[bands.get_level(b) * (sizeof(bars) - 2) / AUDIO_LEVEL_ONE]);
+            }
+            printf("|\n");
+        }
+    }
+    if (csv != nullptr)
+    {
+        fclose(csv);
+    }
+    if (block_ns.empty())
+    {
+        fprintf(stderr, "the file is shorter than one block\n");
+        return 1;
+    }
+
+    std::vector<double> sorted = block_ns;
+    std::sort(sorted.begin(), sorted.end());
+    double mean = 0;
+    for (double ns : block_ns)
+    {
+        mean += ns;
+    }
+    mean /= block_ns.size();
+    double block_us = size * 1e6 / wav.sample_rate;
+    printf("%zu blocks of %.0f us of audio: %.2f us mean, %.2f us 99th percentile, %.2f us max per block\n",
+           block_ns.size(), block_us, mean / 1e3, sorted[sorted.size() * 99 / 100] / 1e3, sorted.back() / 1e3);
+    printf("The analysis takes %.3f%% of the time on this machine\n", 100.0 * mean / 1e3 / block_us);
+    return 0;
+}
@@ -0,0 +1,158 @@
+/*
+  anim_bake.cpp - renders a composition of animations into a single Fetch animation
+  Copyright (c) 2019 Simen E. Sørensen.
+
+  Build: g++ -std=c++17 -O2 -pthread -o anim_bake anim_bake.cpp HostScene.cpp HostAnimation.cpp
+
+  Usage: anim_bake <scene.txt> [--dir <path>] [--threads <n>] [--verify]
+
+  The scene file lists the layers to merge and where to place them. Every output
+  frame is rendered on its own, spread over a thread pool, and written to its own
+  slot, so the result is byte for byte the same for any number of threads.
+  --verify renders the scene on one thread as well and checks that.
+
+  The scene file format is described in HostScene.h. The output has one frame
+  per tick of the longest layer, taking frame durations into account.
+*/
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "HostScene.h"
+#include "ThreadPool.h"
+
+//Renders every tick of the scene into "output", on the pool if one is given
+static void render_scene(const HostScene &scene, int ticks, std::vector<uint16_t> *output, ThreadPool *pool)
+{
+    const size_t frame_len = (size_t)scene.cols * scene.rows;
+    output->assign(frame_len * ticks, 0);
+    uint16_t *out = output->data();
+    if (pool == nullptr)
+    {
+        for (int t = 0; t < ticks; t++)
+        {
+            host_render_scene_tick(scene, t, &out[t * frame_len]);
+        }
+        return;
+    }
+    //Small chunks keep the load even when some frames have many more layers than others
+    int chunk = ticks / (int)(pool->get_num_threads() * 8) + 1;
+    pool->parallel_for(0, ticks, chunk, [&](int t) { host_render_scene_tick(scene, t, &out[t * frame_len]); });
+}
+
+static void build_output(const HostScene &scene, int ticks, const std::vector<uint16_t> &rendered, HostAnimation *anim)
+{
+    const size_t frame_len = (size_t)scene.cols * scene.rows;
+    //Count frames first so that the output is only allocated once
+    std::vector<int> starts;
+    for (int t = 0; t < ticks; t++)
+    {
+        bool repeat = scene.collapse && !starts.empty() && (t - starts.back()) < UINT16_MAX &&
+                      memcmp(&rendered[t * frame_len], &rendered[starts.back() * frame_len], frame_len * sizeof(uint16_t)) == 0;
+        if (!repeat)
+        {
+            starts.push_back(t);
+        }
+    }
+    anim->resize(scene.cols, scene.rows, (int)starts.size());
+    anim->playback_type = scene.playback_type;
+    anim->dir_fwd = scene.dir_fwd;
+    anim->max_iterations = scene.max_iterations;
+    anim->current_frame = scene.dir_fwd ? 0 : anim->num_frames - 1;
+    anim->start_idx = anim->current_frame;
+    for (size_t f = 0; f < starts.size(); f++)
+    {
+        int end = (f + 1 < starts.size()) ? starts[f + 1] : ticks;
+        memcpy(anim->edit_frame((int)f), &rendered[starts[f] * frame_len], frame_len * sizeof(uint16_t));
+        anim->durations[f] = (uint16_t)(end - starts[f]);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    const char *scene_path = nullptr;
+    std::string dir;
+    unsigned threads = 0;
+    bool verify = false;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--dir") == 0 && i + 1 < argc)
+        {
+            dir = argv[++i];
+        }
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+        {
+            threads = (unsigned)atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--verify") == 0)
+        {
+            verify = true;
+        }
+        else if (scene_path == nullptr && argv[i][0] != '-')
+        {
+            scene_path = argv[i];
+        }
+        else
+        {
+            scene_path = nullptr;
+            break;
+        }
+    }
+    if (scene_path == nullptr)
+    {
+        fprintf(stderr, "usage: %s <scene.txt> [--dir <path>] [--threads <n>] [--verify]\n", argv[0]);
+        return 2;
+    }
+
+    HostScene scene;
+    if (!host_read_scene(scene_path, &scene))
+    {
+        return 1;
+    }
+    if (!scene.has_output)
+    {
+        fprintf(stderr, "%s: no output index given\n", scene_path);
+        return 1;
+    }
+    if (!host_load_scene_layers(dir, &scene))
+    {
+        return 1;
+    }
+    const int ticks = scene.ticks;
+
+    ThreadPool pool(threads);
+    std::vector<uint16_t> rendered;
+    auto start = std::chrono::steady_clock::now();
+    render_scene(scene, ticks, &rendered, &pool);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("Rendered %d frames from %zu layers in %.3f s on %u threads\n", ticks, scene.layers.size(), seconds, pool.get_num_threads());
+
+    if (verify)
+    {
+        std::vector<uint16_t> serial;
+        start = std::chrono::steady_clock::now();
+        render_scene(scene, ticks, &serial, nullptr);
+        seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (serial != rendered)
+        {
+            fprintf(stderr, "Verify failed: single threaded output differs\n");
+            return 1;
+        }
+        printf("Verified against single threaded render (%.3f s)\n", seconds);
+    }
+
+    HostAnimation output;
+    build_output(scene, ticks, rendered, &output);
+    std::string error;
+    if (!output.save_to_dir(dir, scene.output_index, &error))
+    {
+        fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+    printf("Saved A%u with %d frames (%u ticks)\n", scene.output_index, output.num_frames, output.get_total_duration());
+    return 0;
+}
@@ -0,0 +1,298 @@
+/*
+  anim_bench.cpp - measures how long frame operations take, one line per operation
+  Copyright (c) 2019 Simen E. Sørensen.
+
+  Build: g++ -std=c++17 -O2 -pthread -o anim_bench anim_bench.cpp HostAnimation.cpp
+
+  Usage: anim_bench [--size <cols> <rows>] [--ms <per test>] [--handoff]
+
+  Every blend mode (BlendModes.h) is timed merging one frame into another of the same
+  size, the way the display merges layers. Each mode is timed twice: with the blend chosen
+  at compile time (host_merge_frame(), the same loops as Frame::merge_with_frame()) and,
+  for comparison, with the mode looked up for every pixel. The default size is the display.
+  Resampling (Resample.h) is timed from that size to the full panel and to twice the size,
+  with the precomputed map and, for comparison, working out the overlaps for every pixel.
+  --handoff   passes frames through TripleBuffer.h from one thread to another as fast as
+              they can go, and checks that the reader never sees a frame that is only
+              partly written, and that it keeps getting new frames (exits with 1 if not).
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+#include "HostAnimation.h"
+#include "../Resample.h"
+#include "../TripleBuffer.h"
+
+//The mode looked up for every pixel: what the templates are there to avoid
+static void merge_frame_per_pixel(uint16_t *dst, const uint16_t *src, int num_pixels, BlendMode mode, uint16_t weight)
+{
+    for (int i = 0; i < num_pixels; i++)
+    {
+        switch (mode)
+        {
+        case BLEND_ADD:      dst[i] = BlendAdd()(dst[i], src[i]); break;
+        case BLEND_MAX:      dst[i] = BlendMax()(dst[i], src[i]); break;
+        case BLEND_REPLACE:  dst[i] = BlendReplace()(dst[i], src[i]); break;
+        case BLEND_MULTIPLY: dst[i] = BlendMultiply()(dst[i], src[i]); break;
+        case BLEND_SUBTRACT: dst[i] = BlendSubtract()(dst[i], src[i]); break;
+        case BLEND_WEIGHTED: dst[i] = BlendWeighted{weight}(dst[i], src[i]); break;
+        default: break;
+        }
+    }
+}
+
+//Runs "merge" over and over for about "ms" milliseconds and returns the time per pixel in ns
+template <typename Merge>
+static double time_merge(Merge merge, int num_pixels, int ms)
+{
+    using clock = std::chrono::steady_clock;
+    long runs = 0;
+    long batch = 1;
+    auto start = clock::now();
+    double elapsed = 0;
+    while (elapsed < ms * 1e-3)
+    {
+        for (long i = 0; i < batch; i++)
+        {
+            merge();
+        }
+        runs += batch;
+        batch *= 2;
+        elapsed = std::chrono::duration<double>(clock::now() - start).count();
+    }
+    return elapsed * 1e9 / ((double)runs * num_pixels);
+}
+
+//Area resampling without a map: the overlaps are worked out (with divisions) for every pixel of every frame
+static void resample_area_per_pixel(const uint16_t *src, int src_cols, int src_rows, uint16_t *dst, int dst_cols, int dst_rows)
+{
+    for (int y = 0; y < dst_rows; y++)
+    {
+        uint32_t y_low = (uint32_t)y * src_rows;
+        uint32_t y_high = y_low + src_rows;
+        for (int x = 0; x < dst_cols; x++)
+        {
+            uint32_t x_low = (uint32_t)x * src_cols;
+            uint32_t x_high = x_low + src_cols;
+            uint64_t sum = 0;
+            for (uint32_t sy = y_low / dst_rows; sy * dst_rows < y_high; sy++)
+            {
+                uint32_t y_overlap = std::min((sy + 1) * dst_rows, y_high) - std::max(sy * dst_rows, y_low);
+                for (uint32_t sx = x_low / dst_cols; sx * dst_cols < x_high; sx++)
+                {
+                    uint32_t x_overlap = std::min((sx + 1) * dst_cols, x_high) - std::max(sx * dst_cols, x_low);
+                    sum += (uint64_t)src[sy * src_cols + sx] * x_overlap * y_overlap;
+                }
+            }
+            uint64_t area = (uint64_t)src_cols * src_rows;
+            dst[y * dst_cols + x] = (uint16_t)((sum + area / 2) / area);
+        }
+    }
+}
+
+struct HandoffFrame
+{
+    uint32_t sequence;
+    std::vector<uint16_t> pixels;
+};
+
+//Every pixel of frame n is derived from n, so a frame that mixes two writes is easy to spot
+static uint16_t handoff_pixel(uint32_t sequence, int i)
+{
+    return (uint16_t)(sequence * 2654435761UL + i);
+}
+
+/*
+*  One thread publishes numbered frames for "ms" milliseconds while this one reads them. Returns false
+*  on a torn or out of order read, or if the reader got fewer new frames than one every 100 ms:
+*  a front buffer that is never swapped would pass the other checks by showing the same frame forever.
+*  (On a single core the threads only take turns when the scheduler switches them, some 100 times a second.)
+*/
+static bool time_handoff(int num_pixels, int ms)
+{
+    TripleBuffer<HandoffFrame> handoff;
+    HandoffFrame *init = handoff.get_back();
+    for (int b = 0; b < 3; b++)
+    {
+        //Every buffer starts as frame 0, so the reader never sees one that was not written
+        init->sequence = 0;
+        init->pixels.assign(num_pixels, 0);
+        for (int i = 0; i < num_pixels; i++)
+        {
+            init->pixels[i] = handoff_pixel(0, i);
+        }
+        handoff.publish();
+        handoff.get_front();
+        init = handoff.get_back();
+    }
+    std::atomic<bool> done{false};
+    uint32_t published = 0;
+    std::thread producer([&]() {
+        while (!done.load(std::memory_order_relaxed))
+        {
+            HandoffFrame *frame = handoff.get_back();
+            published++;
+            frame->sequence = published;
+            for (int i = 0; i < num_pixels; i++)
+            {
+                frame->pixels[i] = handoff_pixel(published, i);
+            }
+            handoff.publish();
+        }
+    });
+
+    long reads = 0;
+    long new_frames = 0;
+    long torn = 0;
+    long backwards = 0;
+    uint32_t last = 0;
+    auto start = std::chrono::steady_clock::now();
+    while (std::chrono::steady_clock::now() - start < std::chrono::milliseconds(ms))
+    {
+        const HandoffFrame *frame = handoff.get_front();
+        reads++;
+        for (int i = 0; i < num_pixels; i++)
+        {
+            if (frame->pixels[i] != handoff_pixel(frame->sequence, i))
+            {
+                torn++;
+                break;
+            }
+        }
+        if (frame->sequence < last)
+        {
+            backwards++;
+        }
+        new_frames += frame->sequence != last;
+        last = frame->sequence;
+    }
+    done = true;
+    producer.join();
+    printf("Handoff of %d pixel frames: %u published, %ld read (%ld new), %ld torn, %ld out of order\n",
+           num_pixels, published, reads, new_frames, torn, backwards);
+    const long min_new_frames = (ms / 100 > 2) ? ms / 100 : 2;
+    if (torn > 0 || backwards > 0)
+    {
+        fprintf(stderr, "the reader saw a partly written or an older frame\n");
+        return false;
+    }
+    if (new_frames < min_new_frames)
+    {
+        fprintf(stderr, "the reader only saw %ld new frames, expected at least %ld\n", new_frames, min_new_frames);
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    int cols = 19;
+    int rows = 10;
+    int ms = 200;
+    bool handoff = false;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--size") == 0 && i + 2 < argc)
+        {
+            cols = atoi(argv[++i]);
+            rows = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--ms") == 0 && i + 1 < argc)
+        {
+            ms = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--handoff") == 0)
+        {
+            handoff = true;
+        }
+        else
+        {
+            fprintf(stderr, "usage: anim_bench [--size <cols> <rows>] [--ms <per test>] [--handoff]\n");
+            return 2;
+        }
+    }
+    if (cols <= 0 || rows <= 0 || ms <= 0)
+    {
+        fprintf(stderr, "size and time must be positive\n");
+        return 2;
+    }
+
+    const int num_pixels = cols * rows;
+    std::vector<uint16_t> src(num_pixels);
+    std::vector<uint16_t> dst(num_pixels);
+    srand(1);
+    for (int i = 0; i < num_pixels; i++)
+    {
+        src[i] = rand() % (DUTY_CYCLE_RESOLUTION + 1);
+        dst[i] = rand() % (DUTY_CYCLE_RESOLUTION + 1);
+    }
+    const std::vector<uint16_t> start = dst;
+    const uint16_t weight = DUTY_CYCLE_RESOLUTION / 3;
+
+    printf("Blending %dx%d frames (ns per pixel)\n", cols, rows);
+    printf("%-10s %12s %12s %8s\n", "mode", "templated", "per pixel", "speedup");
+    uint32_t checksum = 0;
+    for (int m = 0; m < NUM_BLEND_MODES; m++)
+    {
+        BlendMode mode = (BlendMode)m;
+        //Both versions start from the same pixels and must give the same result
+        dst = start;
+        host_merge_frame(dst.data(), cols, rows, src.data(), cols, rows, 0, 0, mode, weight);
+        std::vector<uint16_t> expected = dst;
+        dst = start;
+        merge_frame_per_pixel(dst.data(), src.data(), num_pixels, mode, weight);
+        if (dst != expected)
+        {
+            fprintf(stderr, "%s: the two versions do not agree\n", blend_mode_name(mode));
+            return 1;
+        }
+
+        double templated = time_merge([&]() {
+            host_merge_frame(dst.data(), cols, rows, src.data(), cols, rows, 0, 0, mode, weight);
+        }, num_pixels, ms);
+        checksum += dst[num_pixels / 2];
+        double per_pixel = time_merge([&]() {
+            merge_frame_per_pixel(dst.data(), src.data(), num_pixels, mode, weight);
+        }, num_pixels, ms);
+        checksum += dst[num_pixels / 2];
+        printf("%-10s %12.3f %12.3f %7.1fx\n", blend_mode_name(mode), templated, per_pixel, per_pixel / templated);
+    }
+
+    printf("\nResampling %dx%d frames (ns per output pixel)\n", cols, rows);
+    printf("%-14s %12s %12s %12s %8s\n", "to", "nearest", "area", "per pixel", "speedup");
+    const int targets[2][2] = {{21, 12}, {cols * 2, rows * 2}}; //The full panel (ALL_COLS x ALL_ROWS), and twice the size
+    for (const int *target : targets)
+    {
+        const int dst_cols = target[0];
+        const int dst_rows = target[1];
+        const int dst_pixels = dst_cols * dst_rows;
+        std::vector<uint16_t> out(dst_pixels);
+        ResampleMap nearest(cols, rows, dst_cols, dst_rows, RESAMPLE_NEAREST);
+        ResampleMap area(cols, rows, dst_cols, dst_rows, RESAMPLE_AREA);
+        double nearest_ns = time_merge([&]() { nearest.apply(src.data(), out.data()); }, dst_pixels, ms);
+        checksum += out[dst_pixels / 2];
+        double area_ns = time_merge([&]() { area.apply(src.data(), out.data()); }, dst_pixels, ms);
+        checksum += out[dst_pixels / 2];
+        double per_pixel_ns = time_merge([&]() {
+            resample_area_per_pixel(src.data(), cols, rows, out.data(), dst_cols, dst_rows);
+        }, dst_pixels, ms);
+        checksum += out[dst_pixels / 2];
+        char size[32];
+        snprintf(size, sizeof(size), "%dx%d", dst_cols, dst_rows);
+        printf("%-14s %12.3f %12.3f %12.3f %7.1fx\n", size, nearest_ns, area_ns, per_pixel_ns, per_pixel_ns / area_ns);
+    }
+    printf("(checksum %u)\n", checksum); //Keeps the compiler from dropping the merges and resamples
+
+    if (handoff && !time_handoff(num_pixels, ms * 10))
+    {
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,1515 @@
+/*
+  anim_fuzz.cpp - checks the frame code of the display against simple reference models
+  Copyright (c) 2019 Simen E. Sørensen.
+
+  Build: g++ -std=c++17 -O2 -o anim_fuzz anim_fuzz.cpp HostAnimation.cpp
+
+  Usage: anim_fuzz [--seed <n>] [--cases <n>] [--kernel <name>] [--dir <path>]
+
+  Random frames, views, offsets, sizes and playback settings are run through the code the
+  display uses (the Arduino-free headers it shares with the tools) and through a plain
+  model of what that code should do, written pixel by pixel and step by step for clarity
+  rather than speed. Every result is compared bit for bit:
+    blend     Frame::merge_with_frame() and unmerge_frame(): blend_frames() (FrameLayout.h) with
+              every BlendMode, through views of views, against a pixel by pixel blend.
+              Writes outside the frames are caught by guard pixels around them.
+              host_merge_frame(), which the tools use, is checked against the same model
+    playback  Animation::goto_next_frame(): playback_next_frame() (Playback.h) for every
+              PlaybackType, direction and start, against the order the frames should come in
+    resample  ResampleMap::apply() (Resample.h). Nearest is exact; the area filter must keep
+              flat frames exactly flat and stay within the rounding of its Q15 weights
+    power     anim_frame_power(), anim_power_scale() and anim_scale_pixels() (AnimationFormat.h),
+              and that a scaled frame stays within the budget the scale was made for
+    stream    frame_encode() and FrameDecoder (FrameProtocol.h): key frames and deltas,
+              seq numbers wrapping around, and lost packets
+    file      HostAnimation::save_to_dir() read back with read_from_dir() and map_from_dir(),
+              and the duration and power tables of the data file (written to --dir, or /tmp)
+  --kernel runs only one of these. --cases is the number of random cases per kernel (1000).
+
+  A case that fails is made smaller, one step at a time (smaller frames, offsets closer to
+  zero, fewer pixels lit, fewer frames), for as long as it still fails, and then printed
+  with --seed and the case number that reproduce it. The exit code is 1 if any case failed.
+*/
+
+#include <algorithm>
+#include <math.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include "HostAnimation.h"
+#include "../FrameLayout.h"
+#include "../FrameProtocol.h"
+#include "../Playback.h"
+#include "../Resample.h"
+
+#define GUARD_PIXELS 64     //Pixels on both sides of a frame that must not be written
+#define GUARD_VALUE  0xBEEF
+
+//splitmix64: every case gets its own generator, so a case can be repeated on its own
+struct Rng
+{
+    uint64_t state;
+    explicit Rng(uint64_t seed) : state(seed) {}
+    uint64_t next()
+    {
+        uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+    // lo ... hi, both included
+    int range(int lo, int hi)
+    {
+        return lo + (int)(next() % (uint64_t)(hi - lo + 1));
+    }
+    bool chance(int percent)
+    {
+        return range(0, 99) < percent;
+    }
+    //Mostly the values frames hold, but also merged frames far above full intensity
+    uint16_t pixel()
+    {
+        int kind = range(0, 99);
+        if (kind < 40)
+        {
+            return 0;
+        }
+        if (kind < 65)
+        {
+            return range(0, DUTY_CYCLE_RESOLUTION);
+        }
+        if (kind < 75)
+        {
+            return DUTY_CYCLE_RESOLUTION;
+        }
+        if (kind < 90)
+        {
+            return UINT16_MAX - range(0, DUTY_CYCLE_RESOLUTION);
+        }
+        return range(0, UINT16_MAX);
+    }
+};
+
+static std::string format(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+static std::string format(const char *fmt, ...)
+{
+    char buf[512];
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(buf, sizeof(buf), fmt, args);
+    va_end(args);
+    return buf;
+}
+
+static void print_pixels(const char *name, const uint16_t *pixels, int cols, int rows)
+{
+    printf("  %s (%dx%d, top row first):\n", name, cols, rows);
+    for (int y = rows - 1; y >= 0; y--)
+    {
+        printf("   ");
+        for (int x = 0; x < cols; x++)
+        {
+            printf(" %5u", pixels[y * cols + x]);
+        }
+        printf("\n");
+    }
+}
+
+//Smaller versions of a pixel array: everything dark, then one pixel dark or halved at a time
+static std::vector<std::vector<uint16_t>> shrink_pixels(const std::vector<uint16_t> &pixels)
+{
+    std::vector<std::vector<uint16_t>> out;
+    bool any = false;
+    for (uint16_t p : pixels)
+    {
+        any = any || p != 0;
+    }
+    if (any)
+    {
+        out.push_back(std::vector<uint16_t>(pixels.size(), 0));
+    }
+    for (size_t i = 0; i < pixels.size(); i++)
+    {
+        if (pixels[i] != 0)
+        {
+            out.push_back(pixels);
+            out.back()[i] = 0;
+            out.push_back(pixels);
+            out.back()[i] = pixels[i] / 2;
+        }
+    }
+    return out;
+}
+//The bottom left new_cols*new_rows pixels of a cols*rows frame
+static std::vector<uint16_t> crop_pixels(const std::vector<uint16_t> &pixels, int cols, int new_cols, int new_rows)
+{
+    std::vector<uint16_t> out((size_t)new_cols * new_rows);
+    for (int y = 0; y < new_rows; y++)
+    {
+        for (int x = 0; x < new_cols; x++)
+        {
+            out[y * new_cols + x] = pixels[y * cols + x];
+        }
+    }
+    return out;
+}
+//Steps that bring "value" closer to zero
+static std::vector<int> shrink_int(int value)
+{
+    std::vector<int> out;
+    if (value != 0)
+    {
+        out.push_back(0);
+        if (value / 2 != 0)
+        {
+            out.push_back(value / 2);
+        }
+        out.push_back(value > 0 ? value - 1 : value + 1);
+    }
+    return out;
+}
+
+/*
+*  Runs "cases" random cases of a kernel. A kernel has:
+*      Case generate(Rng &rng)
+*      std::string check(const Case &c)             empty if the code agrees with the model
+*      std::vector<Case> shrink(const Case &c)     smaller cases to try
+*      void print(const Case &c)
+*  Returns the number of failed cases; only the first is minimized and printed.
+*/
+template <typename Kernel>
+static int fuzz(const char *name, Kernel &kernel, uint64_t seed, int cases)
+{
+    int failed = 0;
+    for (int i = 0; i < cases; i++)
+    {
+        Rng rng(seed * 1000003ULL + i);
+        auto c = kernel.generate(rng);
+        std::string diff = kernel.check(c);
+        if (diff.empty())
+        {
+            continue;
+        }
+        if (failed++ > 0)
+        {
+            continue;
+        }
+        //Greedy: take the first smaller case that still fails, until none does
+        int steps = 0;
+        for (bool smaller = true; smaller;)
+        {
+            smaller = false;
+            for (auto &candidate : kernel.shrink(c))
+            {
+                std::string candidate_diff = kernel.check(candidate);
+                if (!candidate_diff.empty())
+                {
+                    c = candidate;
+                    diff = candidate_diff;
+                    smaller = true;
+                    steps++;
+                    break;
+                }
+            }
+        }
+        printf("%s: case %d of --seed %llu failed (made smaller in %d steps):\n  %s\n",
+               name, i, (unsigned long long)seed, steps, diff.c_str());
+        kernel.print(c);
+    }
+    printf("%-9s %d cases, %d failed\n", name, cases, failed);
+    return failed;
+}
+
+//------------------------------------------------------------------------------------------
+// blend
+
+struct ViewSpec
+{
+    bool used = false;
+    bool mirror_x = false;
+    bool mirror_y = false;
+    int  offset_x = 0;
+    int  offset_y = 0;
+};
+//A frame, seen through up to two views (the second is a view of the first)
+struct FrameSpec
+{
+    int cols = 1;
+    int rows = 1;
+    std::vector<uint16_t> pixels;
+    ViewSpec views[2];
+};
+struct BlendCase
+{
+    FrameSpec dst;
+    FrameSpec src;
+    int x = 0;
+    int y = 0;
+    int mode = BLEND_ADD; //NUM_BLEND_MODES is unmerge_frame()
+    uint16_t weight = DUTY_CYCLE_RESOLUTION;
+};
+
+static FrameLayout spec_layout(const FrameSpec &f)
+{
+    FrameLayout layout = frame_layout(f.cols, f.rows);
+    for (const ViewSpec &v : f.views)
+    {
+        if (v.used)
+        {
+            layout = frame_layout_view(layout, f.cols, f.rows, v.mirror_x, v.mirror_y, v.offset_x, v.offset_y);
+        }
+    }
+    return layout;
+}
+
+//Model: the stored pixel that pixel (x,y) of the outermost view reads, or -1 where it reads as zero
+static int model_pixel_index(const FrameSpec &f, int x, int y)
+{
+    for (int v = 1; v >= 0; v--)
+    {
+        const ViewSpec &view = f.views[v];
+        if (!view.used)
+        {
+            continue;
+        }
+        if (x < 0 || x >= f.cols || y < 0 || y >= f.rows)
+        {
+            return -1;
+        }
+        //Pixel (x,y) of a view is pixel (x - offset, y - offset) of the frame it views, mirrored if asked to
+        x -= view.offset_x;
+        y -= view.offset_y;
+        if (view.mirror_x)
+        {
+            x = f.cols - 1 - x;
+        }
+        if (view.mirror_y)
+        {
+            y = f.rows - 1 - y;
+        }
+    }
+    if (x < 0 || x >= f.cols || y < 0 || y >= f.rows)
+    {
+        return -1;
+    }
+    return y * f.cols + x;
+}
+
+static uint16_t model_blend(int mode, uint16_t dst, uint16_t src, uint16_t weight)
+{
+    const long d = dst;
+    const long s = src;
+    long result;
+    switch (mode)
+    {
+    case BLEND_ADD:
+        result = d + s;
+        break;
+    case BLEND_MAX:
+        result = (d > s) ? d : s;
+        break;
+    case BLEND_REPLACE:
+        result = s;
+        break;
+    case BLEND_MULTIPLY:
+        result = d * ((s < DUTY_CYCLE_RESOLUTION) ? s : DUTY_CYCLE_RESOLUTION) / DUTY_CYCLE_RESOLUTION;
+        break;
+    case BLEND_WEIGHTED:
+    {
+        long w = (weight < DUTY_CYCLE_RESOLUTION) ? weight : DUTY_CYCLE_RESOLUTION;
+        result = (d * (DUTY_CYCLE_RESOLUTION - w) + s * w) / DUTY_CYCLE_RESOLUTION;
+        break;
+    }
+    default: //BLEND_SUBTRACT and unmerge
+        result = d - s;
+        break;
+    }
+    //A pixel holds 0 ... 65535, sums and differences past that stop at the limit
+    return (result < 0) ? 0 : (result > UINT16_MAX) ? UINT16_MAX : (uint16_t)result;
+}
+
+//The same dispatch as Frame::merge_with_frame() and unmerge_frame()
+static void blend_with_mode(uint16_t *dst, const FrameLayout &dst_layout, int dst_cols,
+                            const uint16_t *src, const FrameLayout &src_layout, int src_cols,
+                            int x, int y, int mode, uint16_t weight)
+{
+    if (mode == NUM_BLEND_MODES)
+    {
+        blend_frames(dst, dst_layout, dst_cols, src, src_layout, src_cols, x, y, BlendUnmerge());
+        return;
+    }
+    blend_frames_with_mode(dst, dst_layout, dst_cols, src, src_layout, src_cols, x, y, (BlendMode)mode, weight);
+}
+
+static const char *mode_name(int mode)
+{
+    return (mode == NUM_BLEND_MODES) ? "unmerge" : blend_mode_name((BlendMode)mode);
+}
+
+//Pixels with guard pixels on both sides
+static std::vector<uint16_t> guarded(const std::vector<uint16_t> &pixels)
+{
+    std::vector<uint16_t> out(pixels.size() + 2 * GUARD_PIXELS, GUARD_VALUE);
+    std::copy(pixels.begin(), pixels.end(), out.begin() + GUARD_PIXELS);
+    return out;
+}
+static std::string check_guards(const std::vector<uint16_t> &pixels, const char *name)
+{
+    for (size_t i = 0; i < pixels.size(); i++)
+    {
+        bool inside = i >= GUARD_PIXELS && i < pixels.size() - GUARD_PIXELS;
+        if (!inside && pixels[i] != GUARD_VALUE)
+        {
+            return format("wrote outside of %s, %d pixels %s it", name,
+                          i < GUARD_PIXELS ? (int)(GUARD_PIXELS - i) : (int)(i - (pixels.size() - GUARD_PIXELS) + 1),
+                          i < GUARD_PIXELS ? "before" : "after");
+        }
+    }
+    return "";
+}
+
+//The pixels of a frame as seen through its views, by the layout and by the model
+static std::string check_view(const FrameSpec &f, const char *name)
+{
+    std::vector<uint16_t> seen(f.pixels.size());
+    frame_layout_copy(spec_layout(f), f.pixels.data(), f.cols, f.rows, seen.data());
+    for (int y = 0; y < f.rows; y++)
+    {
+        for (int x = 0; x < f.cols; x++)
+        {
+            int idx = model_pixel_index(f, x, y);
+            uint16_t expected = (idx < 0) ? 0 : f.pixels[idx];
+            if (seen[y * f.cols + x] != expected)
+            {
+                return format("pixel (%d,%d) of %s reads %u through its views, expected %u",
+                              x, y, name, seen[y * f.cols + x], expected);
+            }
+        }
+    }
+    return "";
+}
+
+struct BlendKernel
+{
+    static ViewSpec random_view(Rng &rng, int cols, int rows)
+    {
+        ViewSpec v;
+        v.used = rng.chance(40);
+        v.mirror_x = rng.chance(50);
+        v.mirror_y = rng.chance(50);
+        v.offset_x = rng.chance(50) ? 0 : rng.range(-cols - 1, cols + 1);
+        v.offset_y = rng.chance(50) ? 0 : rng.range(-rows - 1, rows + 1);
+        return v;
+    }
+    static FrameSpec random_frame(Rng &rng)
+    {
+        FrameSpec f;
+        f.cols = rng.range(1, 24);
+        f.rows = rng.range(1, 16);
+        f.pixels.resize((size_t)f.cols * f.rows);
+        for (uint16_t &p : f.pixels)
+        {
+            p = rng.pixel();
+        }
+        f.views[0] = random_view(rng, f.cols, f.rows);
+        f.views[1] = random_view(rng, f.cols, f.rows);
+        return f;
+    }
+
+    BlendCase generate(Rng &rng)
+    {
+        BlendCase c;
+        c.dst = random_frame(rng);
+        c.src = random_frame(rng);
+        c.x = rng.range(-c.src.cols - 2, c.dst.cols + 2);
+        c.y = rng.range(-c.src.rows - 2, c.dst.rows + 2);
+        c.mode = rng.range(0, NUM_BLEND_MODES);
+        c.weight = rng.chance(20) ? rng.range(0, UINT16_MAX) : rng.range(0, DUTY_CYCLE_RESOLUTION);
+        return c;
+    }
+
+    std::string check(const BlendCase &c)
+    {
+        std::string diff = check_view(c.dst, "dst");
+        if (diff.empty())
+        {
+            diff = check_view(c.src, "src");
+        }
+        if (!diff.empty())
+        {
+            return diff;
+        }
+
+        std::vector<uint16_t> expected = c.dst.pixels;
+        for (int sy = 0; sy < c.src.rows; sy++)
+        {
+            for (int sx = 0; sx < c.src.cols; sx++)
+            {
+                int s = model_pixel_index(c.src, sx, sy);
+                int d = model_pixel_index(c.dst, sx + c.x, sy + c.y);
+                if (s >= 0 && d >= 0)
+                {
+                    expected[d] = model_blend(c.mode, expected[d], c.src.pixels[s], c.weight);
+                }
+            }
+        }
+
+        std::vector<uint16_t> dst = guarded(c.dst.pixels);
+        std::vector<uint16_t> src = guarded(c.src.pixels);
+        blend_with_mode(&dst[GUARD_PIXELS], spec_layout(c.dst), c.dst.cols, &src[GUARD_PIXELS], spec_layout(c.src), c.src.cols,
+                        c.x, c.y, c.mode, c.weight);
+        diff = check_guards(dst, "dst");
+        if (diff.empty())
+        {
+            diff = check_guards(src, "src");
+        }
+        for (size_t i = 0; diff.empty() && i < c.src.pixels.size(); i++)
+        {
+            if (src[GUARD_PIXELS + i] != c.src.pixels[i])
+            {
+                diff = format("blend_frames() changed src pixel %zu", i);
+            }
+        }
+        for (size_t i = 0; diff.empty() && i < expected.size(); i++)
+        {
+            if (dst[GUARD_PIXELS + i] != expected[i])
+            {
+                diff = format("blend_frames() %s: stored dst pixel %zu (%zu,%zu) is %u, expected %u (was %u)", mode_name(c.mode),
+                              i, i % c.dst.cols, i / c.dst.cols, dst[GUARD_PIXELS + i], expected[i], c.dst.pixels[i]);
+            }
+        }
+        if (!diff.empty() || c.mode == NUM_BLEND_MODES || c.dst.views[0].used || c.dst.views[1].used ||
+            c.src.views[0].used || c.src.views[1].used)
+        {
+            return diff;
+        }
+        //No views: the tools blend these with host_merge_frame()
+        dst = guarded(c.dst.pixels);
+        host_merge_frame(&dst[GUARD_PIXELS], c.dst.cols, c.dst.rows, c.src.pixels.data(), c.src.cols, c.src.rows,
+                         c.x, c.y, (BlendMode)c.mode, c.weight);
+        diff = check_guards(dst, "dst");
+        for (size_t i = 0; diff.empty() && i < expected.size(); i++)
+        {
+            if (dst[GUARD_PIXELS + i] != expected[i])
+            {
+                diff = format("host_merge_frame() %s: dst pixel %zu is %u, expected %u", mode_name(c.mode), i,
+                              dst[GUARD_PIXELS + i], expected[i]);
+            }
+        }
+        return diff;
+    }
+
+    static void shrink_frame(const BlendCase &c, bool is_dst, std::vector<BlendCase> *out)
+    {
+        const FrameSpec &f = is_dst ? c.dst : c.src;
+        auto add = [&](const FrameSpec &smaller) {
+            out->push_back(c);
+            (is_dst ? out->back().dst : out->back().src) = smaller;
+        };
+        if (f.cols > 1)
+        {
+            FrameSpec s = f;
+            s.cols--;
+            s.pixels = crop_pixels(f.pixels, f.cols, s.cols, s.rows);
+            add(s);
+        }
+        if (f.rows > 1)
+        {
+            FrameSpec s = f;
+            s.rows--;
+            s.pixels = crop_pixels(f.pixels, f.cols, s.cols, s.rows);
+            add(s);
+        }
+        for (int v = 0; v < 2; v++)
+        {
+            if (!f.views[v].used)
+            {
+                continue;
+            }
+            FrameSpec s = f;
+            s.views[v] = ViewSpec();
+            add(s);
+            for (int offset : shrink_int(f.views[v].offset_x))
+            {
+                s = f;
+                s.views[v].offset_x = offset;
+                add(s);
+            }
+            for (int offset : shrink_int(f.views[v].offset_y))
+            {
+                s = f;
+                s.views[v].offset_y = offset;
+                add(s);
+            }
+            if (f.views[v].mirror_x || f.views[v].mirror_y)
+            {
+                s = f;
+                s.views[v].mirror_x = false;
+                add(s);
+                s = f;
+                s.views[v].mirror_y = false;
+                add(s);
+            }
+        }
+        for (auto &pixels : shrink_pixels(f.pixels))
+        {
+            FrameSpec s = f;
+            s.pixels = pixels;
+            add(s);
+        }
+    }
+
+    std::vector<BlendCase> shrink(const BlendCase &c)
+    {
+        std::vector<BlendCase> out;
+        for (int x : shrink_int(c.x))
+        {
+            out.push_back(c);
+            out.back().x = x;
+        }
+        for (int y : shrink_int(c.y))
+        {
+            out.push_back(c);
+            out.back().y = y;
+        }
+        shrink_frame(c, true, &out);
+        shrink_frame(c, false, &out);
+        return out;
+    }
+
+    static void print_frame(const FrameSpec &f, const char *name)
+    {
+        print_pixels(name, f.pixels.data(), f.cols, f.rows);
+        for (int v = 0; v < 2; v++)
+        {
+            if (f.views[v].used)
+            {
+                printf("    seen through get_view(%s, %d, %d)\n",
+                       f.views[v].mirror_x ? (f.views[v].mirror_y ? "TRANSFORM_ROTATE_180" : "TRANSFORM_MIRROR_X")
+                                           : (f.views[v].mirror_y ? "TRANSFORM_MIRROR_Y" : "TRANSFORM_NONE"),
+                       f.views[v].offset_x, f.views[v].offset_y);
+            }
+        }
+    }
+    void print(const BlendCase &c)
+    {
+        printf("  %s of src into dst at (%d, %d)", mode_name(c.mode), c.x, c.y);
+        if (c.mode == BLEND_WEIGHTED)
+        {
+            printf(", weight %u", c.weight);
+        }
+        printf("\n");
+        print_frame(c.dst, "dst");
+        print_frame(c.src, "src");
+    }
+};
+
+//------------------------------------------------------------------------------------------
+// playback
+
+struct PlaybackCase
+{
+    int  type = LOOP;
+    bool dir_fwd = true;
+    int  num_frames = 1;
+    int  start_idx = 0;
+    int  first_frame = 0; //The frame playback starts on: start_idx, unless start_idx is outside the animation
+    int  max_iterations = -1;
+};
+
+struct PlaybackKernel
+{
+    PlaybackCase generate(Rng &rng)
+    {
+        PlaybackCase c;
+        c.type = rng.chance(3) ? rng.range(LOOP_N_TIMES + 1, 9) : rng.range(ONCE, LOOP_N_TIMES);
+        c.dir_fwd = rng.chance(50);
+        c.num_frames = rng.range(1, 12);
+        c.start_idx = rng.chance(50) ? (c.dir_fwd ? 0 : c.num_frames - 1) : rng.range(0, c.num_frames - 1);
+        c.first_frame = c.start_idx;
+        if (rng.chance(10))
+        {
+            c.start_idx = rng.chance(50) ? -1 : c.num_frames;
+            c.first_frame = c.dir_fwd ? 0 : c.num_frames - 1;
+        }
+        c.max_iterations = rng.range(-1, 4);
+        return c;
+    }
+
+    /*
+    *  Model: for the loops, the frames from the start in the playback direction, wrapping around,
+    *  once per loop. For BOUNCE, a walk around a circle of 2*(num_frames - 1) positions, where
+    *  the first half are the frames going forward and the second half going backward.
+    */
+    std::string check(const PlaybackCase &c)
+    {
+        const int n = c.num_frames;
+        const int start = c.first_frame;
+        const int step_dir = c.dir_fwd ? 1 : -1;
+        const int period = 2 * (n - 1);
+        int u0 = 0;
+        if (c.type == BOUNCE && n > 1)
+        {
+            //Leaving an end of the array in the wrong direction turns around at once
+            bool forward = c.dir_fwd ? start < n - 1 : start == 0;
+            u0 = forward ? start : (period - start) % period;
+        }
+        long total = -1; //Frames shown before the animation is done, -1 for never
+        if (c.type == ONCE)
+        {
+            total = n;
+        }
+        else if (c.type == LOOP_N_TIMES)
+        {
+            total = (long)n * (c.max_iterations > 1 ? c.max_iterations : 1);
+        }
+        else if (c.type != LOOP && c.type != BOUNCE)
+        {
+            total = 1; //Unknown types stop at once
+        }
+
+        int current = start;
+        int loop_iteration = 0;
+        bool dir_fwd = c.dir_fwd;
+        int expected_loops = 0;
+        const int steps = 4 * n * 5 + 3;
+        for (int s = 1; s <= steps; s++)
+        {
+            int prev = current;
+            current = playback_next_frame((PlaybackType)c.type, current, c.start_idx, n, c.max_iterations, &loop_iteration, &dir_fwd);
+
+            int expected;
+            bool expected_dir = c.dir_fwd;
+            if (c.type == BOUNCE)
+            {
+                if (n == 1)
+                {
+                    expected = 0;
+                    expected_loops++;
+                }
+                else
+                {
+                    int before = (u0 + s - 1) % period;
+                    int u = (u0 + s) % period;
+                    expected = (u < n) ? u : period - u;
+                    int frame_before = (before < n) ? before : period - before;
+                    expected_loops += (frame_before == 0 || frame_before == n - 1);
+                    expected_dir = before < n - 1;
+                }
+            }
+            else if (total >= 0 && s >= total)
+            {
+                expected = -1;
+                expected_loops = (c.type == LOOP || c.type == ONCE || c.type == LOOP_N_TIMES) ? (int)(total / n) : 0;
+            }
+            else
+            {
+                expected = ((start + (long)s * step_dir) % n + n) % n;
+                expected_loops = s / n;
+            }
+            if (current != expected || loop_iteration != expected_loops || dir_fwd != expected_dir)
+            {
+                return format("step %d from frame %d: frame %d, loop %d, %s; expected frame %d, loop %d, %s",
+                              s, prev, current, loop_iteration, dir_fwd ? "forward" : "backward",
+                              expected, expected_loops, expected_dir ? "forward" : "backward");
+            }
+            if (current == -1)
+            {
+                break;
+            }
+            if (current < 0 || current >= n)
+            {
+                return format("step %d from frame %d: frame %d is outside of the %d frames", s, prev, current, n);
+            }
+        }
+        return "";
+    }
+
+    std::vector<PlaybackCase> shrink(const PlaybackCase &c)
+    {
+        std::vector<PlaybackCase> out;
+        if (c.num_frames > 1)
+        {
+            PlaybackCase s = c;
+            s.num_frames--;
+            auto clamp = [&](int idx) { return (idx >= s.num_frames) ? s.num_frames - 1 : idx; };
+            s.first_frame = clamp(s.first_frame);
+            if (s.start_idx != -1)
+            {
+                s.start_idx = (c.start_idx == c.num_frames) ? s.num_frames : clamp(s.start_idx);
+            }
+            out.push_back(s);
+        }
+        if (c.start_idx == c.first_frame && c.start_idx > 0)
+        {
+            out.push_back(c);
+            out.back().start_idx--;
+            out.back().first_frame--;
+        }
+        for (int max_iterations : shrink_int(c.max_iterations))
+        {
+            out.push_back(c);
+            out.back().max_iterations = max_iterations;
+        }
+        return out;
+    }
+
+    void print(const PlaybackCase &c)
+    {
+        static const char *names[] = {"ONCE", "LOOP", "BOUNCE", "LOOP_N_TIMES"};
+        printf("  %s (%d), %s, %d frames, start_idx %d, starting on frame %d, max_iterations %d\n",
+               (c.type >= ONCE && c.type <= LOOP_N_TIMES) ? names[c.type] : "unknown type", c.type,
+               c.dir_fwd ? "forward" : "backward", c.num_frames, c.start_idx, c.first_frame, c.max_iterations);
+    }
+};
+
+//------------------------------------------------------------------------------------------
+// resample
+
+struct ResampleCase
+{
+    int src_cols = 1;
+    int src_rows = 1;
+    int dst_cols = 1;
+    int dst_rows = 1;
+    ResampleFilter filter = RESAMPLE_AREA;
+    std::vector<uint16_t> pixels;
+};
+
+struct ResampleKernel
+{
+    ResampleCase generate(Rng &rng)
+    {
+        ResampleCase c;
+        c.src_cols = rng.range(1, 24);
+        c.src_rows = rng.range(1, 16);
+        c.dst_cols = rng.range(1, 24);
+        c.dst_rows = rng.range(1, 16);
+        c.filter = rng.chance(50) ? RESAMPLE_NEAREST : RESAMPLE_AREA;
+        c.pixels.resize((size_t)c.src_cols * c.src_rows);
+        for (uint16_t &p : c.pixels)
+        {
+            p = rng.pixel();
+        }
+        return c;
+    }
+
+    //Model of one axis: the share of source pixel s in destination pixel d, for the area filter
+    static double covered(int s, int d, int src_len, int dst_len)
+    {
+        double low = (double)d * src_len / dst_len;
+        double high = (double)(d + 1) * src_len / dst_len;
+        double start = (s > low) ? s : low;
+        double end = (s + 1 < high) ? s + 1 : high;
+        return (end > start) ? (end - start) * dst_len / src_len : 0;
+    }
+
+    std::string check(const ResampleCase &c)
+    {
+        ResampleMap map(c.src_cols, c.src_rows, c.dst_cols, c.dst_rows, c.filter);
+        std::vector<uint16_t> dst((size_t)c.dst_cols * c.dst_rows + 2 * GUARD_PIXELS, GUARD_VALUE);
+        map.apply(c.pixels.data(), &dst[GUARD_PIXELS]);
+        std::string diff = check_guards(dst, "the scaled frame");
+        if (!diff.empty())
+        {
+            return diff;
+        }
+        for (int y = 0; y < c.dst_rows; y++)
+        {
+            for (int x = 0; x < c.dst_cols; x++)
+            {
+                uint16_t got = dst[GUARD_PIXELS + y * c.dst_cols + x];
+                if (c.filter == RESAMPLE_NEAREST)
+                {
+                    //The source pixel under the center
+                    int sx = (int)floor((x + 0.5) * c.src_cols / c.dst_cols);
+                    int sy = (int)floor((y + 0.5) * c.src_rows / c.dst_rows);
+                    uint16_t expected = c.pixels[sy * c.src_cols + sx];
+                    if (got != expected)
+                    {
+                        return format("nearest: pixel (%d,%d) is %u, expected %u from (%d,%d)", x, y, got, expected, sx, sy);
+                    }
+                    continue;
+                }
+                //Exact average, and how far the Q15 weights may take the result from it
+                double exact = 0;
+                double largest = 0;
+                int taps = 0;
+                for (int sy = 0; sy < c.src_rows; sy++)
+                {
+                    for (int sx = 0; sx < c.src_cols; sx++)
+                    {
+                        double share = covered(sx, x, c.src_cols, c.dst_cols) * covered(sy, y, c.src_rows, c.dst_rows);
+                        if (share > 0)
+                        {
+                            uint16_t value = c.pixels[sy * c.src_cols + sx];
+                            exact += share * value;
+                            largest = (value > largest) ? value : largest;
+                            taps++;
+                        }
+                    }
+                }
+                double tolerance = 1 + largest * (2.0 * taps + 1) / RESAMPLE_WEIGHT_ONE;
+                if (fabs(got - exact) > tolerance)
+                {
+                    return format("area: pixel (%d,%d) is %u, the exact average is %.2f (tolerance %.2f)", x, y, got, exact, tolerance);
+                }
+            }
+        }
+        //A flat frame stays exactly as bright
+        const uint16_t flat = c.pixels[0];
+        std::vector<uint16_t> flat_src(c.pixels.size(), flat);
+        map.apply(flat_src.data(), &dst[GUARD_PIXELS]);
+        for (int i = 0; i < c.dst_cols * c.dst_rows; i++)
+        {
+            if (dst[GUARD_PIXELS + i] != flat)
+            {
+                return format("a flat frame of %u scales to %u at pixel %d", flat, dst[GUARD_PIXELS + i], i);
+            }
+        }
+        return "";
+    }
+
+    std::vector<ResampleCase> shrink(const ResampleCase &c)
+    {
+        std::vector<ResampleCase> out;
+        if (c.src_cols > 1)
+        {
+            out.push_back(c);
+            out.back().src_cols--;
+            out.back().pixels = crop_pixels(c.pixels, c.src_cols, c.src_cols - 1, c.src_rows);
+        }
+        if (c.src_rows > 1)
+        {
+            out.push_back(c);
+            out.back().src_rows--;
+            out.back().pixels = crop_pixels(c.pixels, c.src_cols, c.src_cols, c.src_rows - 1);
+        }
+        if (c.dst_cols > 1)
+        {
+            out.push_back(c);
+            out.back().dst_cols--;
+        }
+        if (c.dst_rows > 1)
+        {
+            out.push_back(c);
+            out.back().dst_rows--;
+        }
+        for (auto &pixels : shrink_pixels(c.pixels))
+        {
+            out.push_back(c);
+            out.back().pixels = pixels;
+        }
+        return out;
+    }
+
+    void print(const ResampleCase &c)
+    {
+        printf("  ResampleMap(%d, %d, %d, %d, %s)\n", c.src_cols, c.src_rows, c.dst_cols, c.dst_rows,
+               c.filter == RESAMPLE_NEAREST ? "RESAMPLE_NEAREST" : "RESAMPLE_AREA");
+        print_pixels("src", c.pixels.data(), c.src_cols, c.src_rows);
+    }
+};
+
+//------------------------------------------------------------------------------------------
+// power
+
+struct PowerCase
+{
+    int cols = 1;
+    int rows = 1;
+    std::vector<uint16_t> pixels;
+    uint32_t max_duty_sum = 0;
+    uint32_t max_row_sum = 0;
+};
+
+struct PowerKernel
+{
+    PowerCase generate(Rng &rng)
+    {
+        PowerCase c;
+        c.cols = rng.range(1, 24);
+        c.rows = rng.range(1, 16);
+        c.pixels.resize((size_t)c.cols * c.rows);
+        for (uint16_t &p : c.pixels)
+        {
+            p = rng.pixel();
+        }
+        c.max_duty_sum = rng.chance(25) ? 0 : rng.range(1, c.cols * c.rows * DUTY_CYCLE_RESOLUTION);
+        c.max_row_sum = rng.chance(25) ? 0 : rng.range(1, c.cols * DUTY_CYCLE_RESOLUTION);
+        return c;
+    }
+
+    std::string check(const PowerCase &c)
+    {
+        //Model: pixels above full intensity draw as much as full intensity
+        uint64_t duty_sum = 0;
+        uint64_t max_row = 0;
+        int peaks = 0;
+        std::vector<uint32_t> expected_rows(c.rows);
+        for (int y = 0; y < c.rows; y++)
+        {
+            uint64_t row = 0;
+            for (int x = 0; x < c.cols; x++)
+            {
+                uint16_t p = c.pixels[y * c.cols + x];
+                row += (p < DUTY_CYCLE_RESOLUTION) ? p : DUTY_CYCLE_RESOLUTION;
+                peaks += (p >= DUTY_CYCLE_RESOLUTION);
+            }
+            expected_rows[y] = (uint32_t)row;
+            duty_sum += row;
+            max_row = (row > max_row) ? row : max_row;
+        }
+        AnimFramePower power;
+        std::vector<uint32_t> row_sums(c.rows);
+        anim_frame_power(c.pixels.data(), c.cols, c.rows, &power, row_sums.data());
+        if (power.duty_sum != duty_sum || power.max_row_sum != max_row || power.peak_count != peaks || power.reserved != 0)
+        {
+            return format("anim_frame_power(): duty_sum %u, max_row_sum %u, peak_count %u; expected %llu, %llu, %d",
+                          power.duty_sum, power.max_row_sum, power.peak_count,
+                          (unsigned long long)duty_sum, (unsigned long long)max_row, peaks);
+        }
+        for (int y = 0; y < c.rows; y++)
+        {
+            if (row_sums[y] != expected_rows[y])
+            {
+                return format("anim_frame_power(): row %d sums to %u, expected %u", y, row_sums[y], expected_rows[y]);
+            }
+        }
+
+        //The largest scale that keeps both sums within their budget
+        uint64_t expected_scale = ANIM_POWER_SCALE_ONE;
+        if (c.max_duty_sum != 0 && duty_sum > c.max_duty_sum)
+        {
+            expected_scale = std::min<uint64_t>(expected_scale, ((uint64_t)c.max_duty_sum << 16) / duty_sum);
+        }
+        if (c.max_row_sum != 0 && max_row > c.max_row_sum)
+        {
+            expected_scale = std::min<uint64_t>(expected_scale, ((uint64_t)c.max_row_sum << 16) / max_row);
+        }
+        uint32_t scale = anim_power_scale(&power, c.max_duty_sum, c.max_row_sum);
+        if (scale != expected_scale)
+        {
+            return format("anim_power_scale(): %u, expected %llu", scale, (unsigned long long)expected_scale);
+        }
+
+        std::vector<uint16_t> scaled = c.pixels;
+        anim_scale_pixels(scaled.data(), (int)scaled.size(), scale);
+        for (size_t i = 0; i < scaled.size(); i++)
+        {
+            uint64_t p = (c.pixels[i] < DUTY_CYCLE_RESOLUTION) ? c.pixels[i] : DUTY_CYCLE_RESOLUTION;
+            uint16_t expected = (uint16_t)(p * scale / ANIM_POWER_SCALE_ONE);
+            if (scaled[i] != expected)
+            {
+                return format("anim_scale_pixels(): pixel %zu is %u, expected %u", i, scaled[i], expected);
+            }
+        }
+        AnimFramePower after;
+        anim_frame_power(scaled.data(), c.cols, c.rows, &after);
+        if ((c.max_duty_sum != 0 && after.duty_sum > c.max_duty_sum) || (c.max_row_sum != 0 && after.max_row_sum > c.max_row_sum))
+        {
+            return format("scaled by %u the frame draws %u (heaviest row %u), over the budget", scale, after.duty_sum, after.max_row_sum);
+        }
+        return "";
+    }
+
+    std::vector<PowerCase> shrink(const PowerCase &c)
+    {
+        std::vector<PowerCase> out;
+        if (c.cols > 1)
+        {
+            out.push_back(c);
+            out.back().cols--;
+            out.back().pixels = crop_pixels(c.pixels, c.cols, c.cols - 1, c.rows);
+        }
+        if (c.rows > 1)
+        {
+            out.push_back(c);
+            out.back().rows--;
+            out.back().pixels = crop_pixels(c.pixels, c.cols, c.cols, c.rows - 1);
+        }
+        for (auto &pixels : shrink_pixels(c.pixels))
+        {
+            out.push_back(c);
+            out.back().pixels = pixels;
+        }
+        return out;
+    }
+
+    void print(const PowerCase &c)
+    {
+        printf("  budget: duty sum %u, row sum %u (0 is no limit)\n", c.max_duty_sum, c.max_row_sum);
+        print_pixels("frame", c.pixels.data(), c.cols, c.rows);
+    }
+};
+
+//------------------------------------------------------------------------------------------
+// stream
+
+struct StreamCase
+{
+    int cols = 1;
+    int rows = 1;
+    std::vector<std::vector<uint16_t>> frames;
+    std::vector<bool> key;  //Sent as a key frame whatever the delta would be
+    std::vector<bool> lost; //Never reaches the decoder
+    uint8_t first_seq = 0;
+};
+
+struct StreamKernel
+{
+    StreamCase generate(Rng &rng)
+    {
+        StreamCase c;
+        c.cols = rng.range(1, 40);
+        c.rows = rng.range(1, FRAME_MAX_PIXELS / c.cols < 26 ? FRAME_MAX_PIXELS / c.cols : 26);
+        const int num_pixels = c.cols * c.rows;
+        const int num_frames = rng.range(1, 12);
+        std::vector<uint16_t> frame(num_pixels, 0);
+        for (int f = 0; f < num_frames; f++)
+        {
+            //Anything from a few changed pixels to a whole new frame
+            int changes = rng.chance(20) ? num_pixels : rng.range(0, num_pixels / 4 + 1);
+            for (int i = 0; i < changes; i++)
+            {
+                frame[rng.range(0, num_pixels - 1)] = rng.pixel();
+            }
+            c.frames.push_back(frame);
+            c.key.push_back(f == 0 || rng.chance(10));
+            c.lost.push_back(f > 0 && rng.chance(10));
+        }
+        c.first_seq = rng.range(0, 255);
+        return c;
+    }
+
+    std::string check(const StreamCase &c)
+    {
+        const int num_pixels = c.cols * c.rows;
+        std::vector<uint8_t> packet(FRAME_MAX_PACKET);
+        FrameDecoder *decoder = new FrameDecoder();
+        std::string diff;
+        //Model: a frame is shown if it is a key frame, or a delta and every packet since the last key frame arrived
+        bool in_sync = false;
+        for (size_t f = 0; f < c.frames.size() && diff.empty(); f++)
+        {
+            const uint16_t *prev = c.key[f] ? nullptr : c.frames[f - 1].data();
+            int len = frame_encode(c.frames[f].data(), prev, c.cols, c.rows, (uint8_t)(c.first_seq + f), packet.data());
+            if (len <= 0 || len > FRAME_MAX_PACKET)
+            {
+                diff = format("frame %zu: frame_encode() returned %d", f, len);
+                break;
+            }
+            bool is_key = packet[2] == FRAME_PACKET_KEY;
+            if (c.lost[f])
+            {
+                in_sync = false;
+                continue;
+            }
+            in_sync = is_key || in_sync;
+            int applied = 0;
+            for (int i = 0; i < len; i++)
+            {
+                applied += frame_decoder_push(decoder, packet[i]);
+            }
+            if (applied != (in_sync ? 1 : 0))
+            {
+                diff = format("frame %zu (%s, %d bytes): the decoder %s it", f, is_key ? "key frame" : "delta", len,
+                              applied ? "applied" : "did not apply");
+            }
+            else if (in_sync && (decoder->cols != c.cols || decoder->rows != c.rows ||
+                                 memcmp(decoder->pixels, c.frames[f].data(), num_pixels * sizeof(uint16_t)) != 0))
+            {
+                diff = format("frame %zu (%s): the decoded pixels differ", f, is_key ? "key frame" : "delta");
+            }
+        }
+        delete decoder;
+        return diff;
+    }
+
+    std::vector<StreamCase> shrink(const StreamCase &c)
+    {
+        std::vector<StreamCase> out;
+        if (c.frames.size() > 1)
+        {
+            out.push_back(c);
+            out.back().frames.pop_back();
+            out.back().key.pop_back();
+            out.back().lost.pop_back();
+            //Without the first frame; the new first one has to be a key frame
+            out.push_back(c);
+            out.back().frames.erase(out.back().frames.begin());
+            out.back().key.erase(out.back().key.begin());
+            out.back().lost.erase(out.back().lost.begin());
+            out.back().key[0] = true;
+            out.back().lost[0] = false;
+        }
+        if (c.cols > 1 || c.rows > 1)
+        {
+            StreamCase s = c;
+            (c.cols > 1) ? s.cols-- : s.rows--;
+            for (auto &frame : s.frames)
+            {
+                frame = crop_pixels(frame, c.cols, s.cols, s.rows);
+            }
+            out.push_back(s);
+        }
+        for (size_t f = 0; f < c.frames.size(); f++)
+        {
+            if (c.lost[f])
+            {
+                out.push_back(c);
+                out.back().lost[f] = false;
+            }
+            if (f > 0 && c.key[f])
+            {
+                out.push_back(c);
+                out.back().key[f] = false;
+            }
+        }
+        if (c.first_seq != 0)
+        {
+            out.push_back(c);
+            out.back().first_seq = 0;
+        }
+        return out;
+    }
+
+    void print(const StreamCase &c)
+    {
+        printf("  %dx%d, first seq %u\n", c.cols, c.rows, c.first_seq);
+        for (size_t f = 0; f < c.frames.size(); f++)
+        {
+            std::string name = format("frame %zu%s%s", f, c.key[f] ? ", sent as a key frame" : "", c.lost[f] ? ", lost" : "");
+            print_pixels(name.c_str(), c.frames[f].data(), c.cols, c.rows);
+        }
+    }
+};
+
+//------------------------------------------------------------------------------------------
+// file
+
+struct FileCase
+{
+    int cols = 1;
+    int rows = 1;
+    int num_frames = 1;
+    std::vector<uint16_t> pixels;
+    std::vector<uint16_t> durations;
+    int playback[7] = {LOOP, 0, 1, 0, -1, 0, -1}; //type, state, dir_fwd, current, prev, loop_iteration, max_iterations
+};
+
+struct FileKernel
+{
+    std::string dir;
+
+    FileCase generate(Rng &rng)
+    {
+        FileCase c;
+        c.cols = rng.range(1, 24);
+        c.rows = rng.range(1, 16);
+        c.num_frames = rng.range(1, 12);
+        c.pixels.resize((size_t)c.cols * c.rows * c.num_frames);
+        for (uint16_t &p : c.pixels)
+        {
+            p = rng.pixel();
+        }
+        bool held = rng.chance(50);
+        for (int f = 0; f < c.num_frames; f++)
+        {
+            c.durations.push_back(held ? (rng.chance(5) ? UINT16_MAX : rng.range(1, 8)) : ANIM_DEFAULT_FRAME_DURATION);
+        }
+        c.playback[0] = rng.range(ONCE, LOOP_N_TIMES);
+        c.playback[1] = rng.range(0, 2);
+        c.playback[2] = rng.range(0, 1);
+        c.playback[3] = rng.range(0, c.num_frames - 1);
+        c.playback[4] = rng.range(-1, c.num_frames - 1);
+        c.playback[5] = rng.range(0, 5);
+        c.playback[6] = rng.range(-1, 5);
+        return c;
+    }
+
+    static HostAnimation make(const FileCase &c)
+    {
+        HostAnimation anim;
+        anim.resize(c.cols, c.rows, c.num_frames);
+        anim.pixels = c.pixels;
+        anim.durations = c.durations;
+        anim.playback_type = c.playback[0];
+        anim.playback_state = c.playback[1];
+        anim.dir_fwd = c.playback[2];
+        anim.current_frame = c.playback[3];
+        anim.prev_frame = c.playback[4];
+        anim.loop_iteration = c.playback[5];
+        anim.max_iterations = c.playback[6];
+        anim.start_idx = c.playback[3];
+        return anim;
+    }
+
+    static std::string compare(const HostAnimation &a, const HostAnimation &b, const char *how)
+    {
+        if (a.cols != b.cols || a.rows != b.rows || a.num_frames != b.num_frames)
+        {
+            return format("%s: %dx%d, %d frames; saved %dx%d, %d frames", how, b.cols, b.rows, b.num_frames, a.cols, a.rows, a.num_frames);
+        }
+        const int settings_a[] = {a.playback_type, a.playback_state, a.dir_fwd, a.current_frame, a.prev_frame, a.loop_iteration, a.max_iterations, a.start_idx};
+        const int settings_b[] = {b.playback_type, b.playback_state, b.dir_fwd, b.current_frame, b.prev_frame, b.loop_iteration, b.max_iterations, b.start_idx};
+        for (int i = 0; i < 8; i++)
+        {
+            if (settings_a[i] != settings_b[i])
+            {
+                return format("%s: playback setting %d is %d, saved %d", how, i, settings_b[i], settings_a[i]);
+            }
+        }
+        for (int f = 0; f < a.num_frames; f++)
+        {
+            if (a.durations[f] != b.durations[f])
+            {
+                return format("%s: frame %d is held %u ticks, saved %u", how, f, b.durations[f], a.durations[f]);
+            }
+            if (memcmp(a.frame(f), b.frame(f), anim_frame_size(a.cols, a.rows)) != 0)
+            {
+                return format("%s: the pixels of frame %d differ", how, f);
+            }
+        }
+        return "";
+    }
+
+    std::string check(const FileCase &c)
+    {
+        const unsigned index = 0;
+        HostAnimation saved = make(c);
+        std::string error;
+        if (!saved.save_to_dir(dir, index, &error))
+        {
+            return "save_to_dir(): " + error;
+        }
+        HostAnimation read;
+        if (!read.read_from_dir(dir, index, &error))
+        {
+            return "read_from_dir(): " + error;
+        }
+        std::string diff = compare(saved, read, "read_from_dir()");
+        if (!diff.empty())
+        {
+            return diff;
+        }
+        HostAnimation mapped;
+        if (!mapped.map_from_dir(dir, index, &error))
+        {
+            return "map_from_dir(): " + error;
+        }
+        diff = compare(saved, mapped, "map_from_dir()");
+        if (!diff.empty())
+        {
+            return diff;
+        }
+
+        //Model of the data file: the pixels, the durations if any frame is not held the default time, then the power of every frame
+        std::vector<uint8_t> expected(c.pixels.size() * 2);
+        memcpy(expected.data(), c.pixels.data(), expected.size());
+        bool held = false;
+        for (uint16_t d : c.durations)
+        {
+            held = held || d != ANIM_DEFAULT_FRAME_DURATION;
+        }
+        if (held)
+        {
+            size_t at = expected.size();
+            expected.resize(at + c.durations.size() * 2);
+            memcpy(&expected[at], c.durations.data(), c.durations.size() * 2);
+        }
+        for (int f = 0; f < c.num_frames; f++)
+        {
+            const uint16_t *frame = &c.pixels[(size_t)f * c.cols * c.rows];
+            uint32_t duty_sum = 0;
+            uint32_t max_row = 0;
+            uint16_t peaks = 0;
+            std::vector<uint32_t> rows(c.rows);
+            for (int y = 0; y < c.rows; y++)
+            {
+                for (int x = 0; x < c.cols; x++)
+                {
+                    uint16_t p = frame[y * c.cols + x];
+                    rows[y] += (p < DUTY_CYCLE_RESOLUTION) ? p : DUTY_CYCLE_RESOLUTION;
+                    peaks += (p >= DUTY_CYCLE_RESOLUTION);
+                }
+                duty_sum += rows[y];
+                max_row = (rows[y] > max_row) ? rows[y] : max_row;
+            }
+            AnimFramePower power = {duty_sum, max_row, peaks, 0};
+            size_t at = expected.size();
+            expected.resize(at + sizeof(power) + rows.size() * 4);
+            memcpy(&expected[at], &power, sizeof(power));
+            memcpy(&expected[at + sizeof(power)], rows.data(), rows.size() * 4);
+        }
+        std::string path = host_anim_path(dir, ANIM_DATA_FILENAME_FMT, index);
+        FILE *file = fopen(path.c_str(), "rb");
+        if (file == nullptr)
+        {
+            return "open file: '" + path + "' failed";
+        }
+        std::vector<uint8_t> bytes(expected.size() + 1);
+        size_t len = fread(bytes.data(), 1, bytes.size(), file);
+        fclose(file);
+        if (len != expected.size())
+        {
+            return format("the data file is %zu bytes, expected %zu", len, expected.size());
+        }
+        for (size_t i = 0; i < len; i++)
+        {
+            if (bytes[i] != expected[i])
+            {
+                return format("byte %zu of the data file is %u, expected %u", i, bytes[i], expected[i]);
+            }
+        }
+        return "";
+    }
+
+    std::vector<FileCase> shrink(const FileCase &c)
+    {
+        std::vector<FileCase> out;
+        const size_t frame_pixels = (size_t)c.cols * c.rows;
+        if (c.num_frames > 1)
+        {
+            out.push_back(c);
+            FileCase &s = out.back();
+            s.num_frames--;
+            s.pixels.resize(frame_pixels * s.num_frames);
+            s.durations.pop_back();
+            s.playback[3] = std::min(s.playback[3], s.num_frames - 1);
+            s.playback[4] = std::min(s.playback[4], s.num_frames - 1);
+        }
+        if (c.cols > 1 || c.rows > 1)
+        {
+            FileCase s = c;
+            (c.cols > 1) ? s.cols-- : s.rows--;
+            s.pixels.clear();
+            for (int f = 0; f < c.num_frames; f++)
+            {
+                std::vector<uint16_t> frame(c.pixels.begin() + f * frame_pixels, c.pixels.begin() + (f + 1) * frame_pixels);
+                frame = crop_pixels(frame, c.cols, s.cols, s.rows);
+                s.pixels.insert(s.pixels.end(), frame.begin(), frame.end());
+            }
+            out.push_back(s);
+        }
+        for (auto &pixels : shrink_pixels(c.pixels))
+        {
+            out.push_back(c);
+            out.back().pixels = pixels;
+        }
+        return out;
+    }
+
+    void print(const FileCase &c)
+    {
+        printf("  playback type %d, state %d, dir_fwd %d, current %d, prev %d, loop %d, max %d\n",
+               c.playback[0], c.playback[1], c.playback[2], c.playback[3], c.playback[4], c.playback[5], c.playback[6]);
+        for (int f = 0; f < c.num_frames; f++)
+        {
+            std::string name = format("frame %d, held %u", f, c.durations[f]);
+            print_pixels(name.c_str(), &c.pixels[(size_t)f * c.cols * c.rows], c.cols, c.rows);
+        }
+    }
+};
+
+int main(int argc, char **argv)
+{
+    uint64_t seed = 1;
+    int cases = 1000;
+    const char *only = nullptr;
+    const char *dir = nullptr;
+    bool usage_error = false;
+    for (int i = 1; i < argc && !usage_error; i++)
+    {
+        if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+        {
+            seed = strtoull(argv[++i], nullptr, 10);
+        }
+        else if (strcmp(argv[i], "--cases") == 0 && i + 1 < argc)
+        {
+            cases = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--kernel") == 0 && i + 1 < argc)
+        {
+            only = argv[++i];
+        }
+        else if (strcmp(argv[i], "--dir") == 0 && i + 1 < argc)
+        {
+            dir = argv[++i];
+        }
+        else
+        {
+            usage_error = true;
+        }
+    }
+    static const char *kernels[] = {"blend", "playback", "resample", "power", "stream", "file"};
+    bool known = (only == nullptr);
+    for (const char *name : kernels)
+    {
+        known = known || strcmp(only, name) == 0;
+    }
+    if (usage_error || !known || cases <= 0)
+    {
+        fprintf(stderr, "usage: %s [--seed <n>] [--cases <n>] [--kernel blend|playback|resample|power|stream|file] [--dir <path>]\n", argv[0]);
+        return 2;
+    }
+    auto runs = [&](const char *name) { return only == nullptr || strcmp(only, name) == 0; };
+
+    int failed = 0;
+    if (runs("blend"))
+    {
+        BlendKernel kernel;
+        failed += fuzz("blend", kernel, seed, cases);
+    }
+    if (runs("playback"))
+    {
+        PlaybackKernel kernel;
+        failed += fuzz("playback", kernel, seed, cases);
+    }
+    if (runs("resample"))
+    {
+        ResampleKernel kernel;
+        failed += fuzz("resample", kernel, seed, cases);
+    }
+    if (runs("power"))
+    {
+        PowerKernel kernel;
+        failed += fuzz("power", kernel, seed, cases);
+    }
+    if (runs("stream"))
+    {
+        StreamKernel kernel;
+        failed += fuzz("stream", kernel, seed, cases);
+    }
+    if (runs("file"))
+    {
+        FileKernel kernel;
+        char temp[] = "/tmp/anim_fuzz_XXXXXX";
+        if (dir != nullptr)
+        {
+            kernel.dir = dir;
+        }
+        else if (mkdtemp(temp) != nullptr)
+        {
+            kernel.dir = temp;
+        }
+        else
+        {
+            fprintf(stderr, "could not make a folder in /tmp, give one with --dir\n");
+            return 1;
+        }
+        failed += fuzz("file", kernel, seed, cases);
+        if (dir == nullptr)
+        {
+            unlink(host_anim_path(kernel.dir, ANIM_CONFIG_FILENAME_FMT, 0).c_str());
+            unlink(host_anim_path(kernel.dir, ANIM_DATA_FILENAME_FMT, 0).c_str());
+            rmdir(kernel.dir.c_str());
+        }
+    }
+    return failed > 0 ? 1 : 0;
+}
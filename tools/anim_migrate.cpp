@@ -0,0 +1,356 @@
+/*
+  anim_migrate.cpp - converts a whole library of animations to the current file format
+  Copyright (c) 2019 Simen E. Sørensen.
+
+  Build: g++ -std=c++17 -O2 -pthread -o anim_migrate anim_migrate.cpp HostAnimation.cpp
+
+  Usage: anim_migrate --dir <path> --out <path> [--threads <n>] [--dedup] [--catalog]
+                      [--report <file.csv>]
+
+  Every animation in --dir (A%u_C.txt and A%u_D.bin, with or without the tables added since
+  the first version of the format) is written to --out in the current format, with the frame
+  durations and power tables of AnimationFormat.h. The animations are spread over a thread
+  pool, one animation per task; the input is memory mapped, so a worker only holds the
+  animation it is converting.
+  --dedup     holds repeated frames instead of storing them, like Animation::collapse_repeated_frames()
+  --catalog   writes the catalog of --out (CATALOG.bin, see Catalog.h)
+  --report    writes one line per animation: the checksums of the data files, and of the
+              frames as they play (one CRC per frame, tick by tick), before and after
+
+  Data files saved by the first version of the display, which only wrote the first half of
+  the pixels (frames*cols*rows bytes), are converted with the missing pixels left dark, and
+  reported as legacy-truncated (with the number of intact frames on stderr).
+
+  Every converted animation is read back from --out and played against the input, tick by
+  tick, so an animation that would not look exactly the same on the display is reported
+  (and the exit code is 1). The input folder is never written to.
+*/
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/stat.h>
+#include <vector>
+
+#include "HostAnimation.h"
+#include "ThreadPool.h"
+
+//A frame and the number of ticks it is shown in a row
+struct PlayedRun
+{
+    uint32_t frame_crc;
+    uint32_t ticks;
+};
+
+struct MigrateResult
+{
+    unsigned index = 0;
+    bool ok = false;
+    std::string error;
+    int cols = 0;
+    int rows = 0;
+    int frames_in = 0;
+    int frames_out = 0;
+    int flags_in = 0;
+    uint32_t ticks = 0;
+    uint64_t bytes_in = 0;
+    uint64_t bytes_out = 0;
+    uint32_t file_crc_in = 0;
+    uint32_t file_crc_out = 0;
+    uint32_t played_crc_in = 0;
+    uint32_t played_crc_out = 0;
+    int intact_frames = -1; //Only set for legacy data files that were saved at half their length
+    AnimCatalogEntry entry;
+};
+
+/*
+*  What the display shows, tick by tick: the CRC of every frame, with the runs of identical
+*  frames joined. Two animations play the same if their runs are the same, however they
+*  are split into frames and durations.
+*/
+static std::vector<PlayedRun> played_runs(const HostAnimation &anim)
+{
+    std::vector<PlayedRun> runs;
+    const uint32_t frame_size = anim_frame_size(anim.cols, anim.rows);
+    for (int f = 0; f < anim.num_frames; f++)
+    {
+        uint32_t crc = anim_crc32(anim.frame(f), frame_size);
+        if (!runs.empty() && runs.back().frame_crc == crc)
+        {
+            runs.back().ticks += anim.durations[f];
+        }
+        else
+        {
+            runs.push_back({crc, anim.durations[f]});
+        }
+    }
+    return runs;
+}
+static uint32_t played_crc(const std::vector<PlayedRun> &runs)
+{
+    return anim_crc32(runs.data(), runs.size() * sizeof(PlayedRun));
+}
+
+//Copies "in" to "out", holding repeated frames if "dedup" is set. Playback settings point to the same frames.
+static void convert(const HostAnimation &in, bool dedup, HostAnimation *out)
+{
+    const uint32_t frame_size = anim_frame_size(in.cols, in.rows);
+    std::vector<int> new_index(in.num_frames);
+    std::vector<int> starts;
+    std::vector<uint32_t> durations;
+    for (int f = 0; f < in.num_frames; f++)
+    {
+        bool repeat = dedup && !starts.empty() && durations.back() + in.durations[f] <= UINT16_MAX &&
+                      memcmp(in.frame(f), in.frame(starts.back()), frame_size) == 0;
+        if (repeat)
+        {
+            durations.back() += in.durations[f];
+        }
+        else
+        {
+            starts.push_back(f);
+            durations.push_back(in.durations[f]);
+        }
+        new_index[f] = (int)starts.size() - 1;
+    }
+    out->resize(in.cols, in.rows, (int)starts.size());
+    for (size_t f = 0; f < starts.size(); f++)
+    {
+        memcpy(out->edit_frame((int)f), in.frame(starts[f]), frame_size);
+        out->durations[f] = (uint16_t)durations[f];
+    }
+    auto map_frame = [&](int f) { return (f >= 0 && f < in.num_frames) ? new_index[f] : f; };
+    out->playback_type = in.playback_type;
+    out->playback_state = in.playback_state;
+    out->dir_fwd = in.dir_fwd;
+    out->current_frame = map_frame(in.current_frame);
+    out->prev_frame = (out->num_frames == in.num_frames) ? in.prev_frame : -1;
+    out->loop_iteration = in.loop_iteration;
+    out->max_iterations = in.max_iterations;
+    out->start_idx = map_frame(in.start_idx);
+}
+
+static void migrate(const std::string &dir, const std::string &out_dir, unsigned index, bool dedup, MigrateResult *result)
+{
+    result->index = index;
+    HostAnimation in;
+    if (in.map_from_dir(dir, index, &result->error))
+    {
+        AnimCatalogEntry entry_in;
+        in.make_catalog_entry(index, &entry_in);
+        result->flags_in = entry_in.data_flags;
+        result->bytes_in = entry_in.data_size;
+        result->file_crc_in = entry_in.data_crc;
+    }
+    else
+    {
+        //The first version of the display saved half of the pixels. Keep what is there.
+        std::string legacy_error;
+        if (!in.read_legacy_truncated(dir, index, &result->intact_frames, &legacy_error))
+        {
+            return;
+        }
+        result->error.clear();
+        result->flags_in = 0;
+        result->bytes_in = (uint64_t)in.num_frames * in.cols * in.rows;
+        result->file_crc_in = anim_crc32(in.pixels.data(), (uint32_t)result->bytes_in);
+    }
+    result->cols = in.cols;
+    result->rows = in.rows;
+    result->frames_in = in.num_frames;
+    std::vector<PlayedRun> runs_in = played_runs(in);
+    result->played_crc_in = played_crc(runs_in);
+    result->ticks = in.get_total_duration();
+
+    {
+        //Scoped, so that only one copy of the frames is held at a time
+        HostAnimation out;
+        convert(in, dedup, &out);
+        if (!out.save_to_dir(out_dir, index, &result->error))
+        {
+            return;
+        }
+    }
+
+    //Check what was written, not what was meant to be written
+    HostAnimation check;
+    if (!check.map_from_dir(out_dir, index, &result->error))
+    {
+        return;
+    }
+    check.make_catalog_entry(index, &result->entry);
+    result->frames_out = check.num_frames;
+    result->bytes_out = result->entry.data_size;
+    result->file_crc_out = result->entry.data_crc;
+    std::vector<PlayedRun> runs_out = played_runs(check);
+    result->played_crc_out = played_crc(runs_out);
+    if (check.cols != in.cols || check.rows != in.rows || runs_out.size() != runs_in.size() ||
+        memcmp(runs_out.data(), runs_in.data(), runs_in.size() * sizeof(PlayedRun)) != 0)
+    {
+        result->error = "the converted animation does not play the same";
+        return;
+    }
+    if (check.playback_type != in.playback_type || check.max_iterations != in.max_iterations || check.dir_fwd != in.dir_fwd)
+    {
+        result->error = "the playback settings were not kept";
+        return;
+    }
+    result->ok = true;
+}
+
+static bool write_report(const char *path, const std::vector<MigrateResult> &results)
+{
+    FILE *file = fopen(path, "w");
+    if (file == nullptr)
+    {
+        return false;
+    }
+    fprintf(file, "index,cols,rows,flags_in,frames_in,frames_out,ticks,bytes_in,bytes_out,"
+                  "file_crc_in,file_crc_out,played_crc_in,played_crc_out,result\n");
+    //Legacy files that were saved at half their length are converted, but marked as legacy-truncated
+    for (const MigrateResult &r : results)
+    {
+        fprintf(file, "%u,%d,%d,%d,%d,%d,%u,%llu,%llu,%08x,%08x,%08x,%08x,%s\n",
+                r.index, r.cols, r.rows, r.flags_in, r.frames_in, r.frames_out, r.ticks,
+                (unsigned long long)r.bytes_in, (unsigned long long)r.bytes_out,
+                r.file_crc_in, r.file_crc_out, r.played_crc_in, r.played_crc_out,
+                !r.ok ? r.error.c_str() : (r.intact_frames >= 0) ? "legacy-truncated" : "ok");
+    }
+    return fclose(file) == 0;
+}
+
+//True if both paths are the same folder, however they are written
+static bool same_folder(const std::string &a, const std::string &b)
+{
+    struct stat info_a;
+    struct stat info_b;
+    return stat(a.c_str(), &info_a) == 0 && stat(b.c_str(), &info_b) == 0 &&
+           info_a.st_dev == info_b.st_dev && info_a.st_ino == info_b.st_ino;
+}
+
+int main(int argc, char **argv)
+{
+    std::string dir;
+    std::string out_dir;
+    const char *report_path = nullptr;
+    unsigned threads = 0;
+    bool dedup = false;
+    bool catalog = false;
+    bool usage_error = false;
+    for (int i = 1; i < argc && !usage_error; i++)
+    {
+        if (strcmp(argv[i], "--dir") == 0 && i + 1 < argc)
+        {
+            dir = argv[++i];
+        }
+        else if (strcmp(argv[i], "--out") == 0 && i + 1 < argc)
+        {
+            out_dir = argv[++i];
+        }
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+        {
+            threads = (unsigned)atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--report") == 0 && i + 1 < argc)
+        {
+            report_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--dedup") == 0)
+        {
+            dedup = true;
+        }
+        else if (strcmp(argv[i], "--catalog") == 0)
+        {
+            catalog = true;
+        }
+        else
+        {
+            usage_error = true;
+        }
+    }
+    if (dir.empty() || out_dir.empty() || usage_error)
+    {
+        fprintf(stderr, "usage: %s --dir <path> --out <path> [--threads <n>] [--dedup] [--catalog]\n"
+                        "       [--report <file.csv>]\n", argv[0]);
+        return 2;
+    }
+    mkdir(out_dir.c_str(), 0777);
+    if (same_folder(dir, out_dir))
+    {
+        //The input is mapped while the output is written: writing over it would change the input under us
+        fprintf(stderr, "--out must be another folder than --dir\n");
+        return 2;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<unsigned> indices = host_list_animations(dir);
+    std::vector<MigrateResult> results(indices.size());
+    ThreadPool pool(threads);
+    //One animation per task: they differ too much in size for larger chunks to even out
+    pool.parallel_for(0, (int)indices.size(), 1, [&](int i) {
+        migrate(dir, out_dir, indices[i], dedup, &results[i]);
+    });
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    int failed = 0;
+    int legacy = 0;
+    int truncated = 0;
+    uint64_t bytes_in = 0;
+    uint64_t bytes_out = 0;
+    uint64_t frames_in = 0;
+    uint64_t frames_out = 0;
+    std::vector<AnimCatalogEntry> entries;
+    for (const MigrateResult &r : results)
+    {
+        if (!r.ok)
+        {
+            fprintf(stderr, "A%u: %s\n", r.index, r.error.c_str());
+            failed++;
+            continue;
+        }
+        legacy += r.flags_in == 0;
+        if (r.intact_frames >= 0)
+        {
+            fprintf(stderr, "A%u: legacy-truncated, %d of %d frames intact, the rest of the pixels are dark\n",
+                    r.index, r.intact_frames, r.frames_in);
+            truncated++;
+        }
+        bytes_in += r.bytes_in;
+        bytes_out += r.bytes_out;
+        frames_in += r.frames_in;
+        frames_out += r.frames_out;
+        entries.push_back(r.entry);
+    }
+    printf("Converted %zu of %zu animations (%d without tables, %d saved at half length) on %u threads in %.3f s\n",
+           indices.size() - failed, indices.size(), legacy, truncated, pool.get_num_threads(), seconds);
+    if (seconds > 0)
+    {
+        printf("%.0f animations/s, %.0f frames/s, %.1f MB/s read\n",
+               (indices.size() - failed) / seconds, frames_in / seconds, bytes_in / 1e6 / seconds);
+    }
+    printf("Frames: %llu -> %llu, data: %.2f MB -> %.2f MB (including the power tables)\n",
+           (unsigned long long)frames_in, (unsigned long long)frames_out, bytes_in / 1e6, bytes_out / 1e6);
+
+    std::string error;
+    if (catalog)
+    {
+        if (!host_write_catalog(out_dir, entries, &error))
+        {
+            fprintf(stderr, "%s\n", error.c_str());
+            return 1;
+        }
+        printf("Catalog of %zu animations saved to '%s'\n", entries.size(), (out_dir + "/" + CATALOG_FILENAME).c_str());
+    }
+    if (report_path != nullptr)
+    {
+        if (!write_report(report_path, results))
+        {
+            fprintf(stderr, "write to '%s' failed\n", report_path);
+            return 1;
+        }
+        printf("Report saved to '%s'\n", report_path);
+    }
+    return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,131 @@
+/*
+  anim_scan.cpp - lists every animation in a folder with size, length and brightness
+  Copyright (c) 2019 Simen E. Sørensen.
+
+  Build: g++ -std=c++17 -O2 -o anim_scan anim_scan.cpp HostAnimation.cpp
+
+  Usage: anim_scan [--dir <path>] [--thumbs] [--catalog]
+
+  The data files are memory mapped instead of read, so only the pages that are
+  actually looked at are loaded from disk. Scanning a copy of a whole SD card
+  takes about as long as reading the config files.
+  --thumbs prints the first frame of every animation as ASCII art.
+  --catalog writes the catalog of the folder (CATALOG.bin, see Catalog.h), so a card
+            filled on a PC does not need AnimCatalog::rebuild() on the display.
+*/
+
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "HostAnimation.h"
+
+static void print_thumbnail(const HostAnimation &anim)
+{
+    static const char shades[] = " .:-=+*#%@";
+    const uint16_t *pixels = anim.frame(0);
+    //Top row first, like the display is seen
+    for (int y = anim.rows - 1; y >= 0; y--)
+    {
+        printf("    ");
+        for (int x = 0; x < anim.cols; x++)
+        {
+            uint32_t value = pixels[y * anim.cols + x];
+            if (value > DUTY_CYCLE_RESOLUTION)
+            {
+                value = DUTY_CYCLE_RESOLUTION;
+            }
+            putchar(shades[value * (sizeof(shades) - 2) / DUTY_CYCLE_RESOLUTION]);
+        }
+        putchar('\n');
+    }
+}
+
+int main(int argc, char **argv)
+{
+    std::string dir = ".";
+    bool thumbs = false;
+    bool catalog = false;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--dir") == 0 && i + 1 < argc)
+        {
+            dir = argv[++i];
+        }
+        else if (strcmp(argv[i], "--thumbs") == 0)
+        {
+            thumbs = true;
+        }
+        else if (strcmp(argv[i], "--catalog") == 0)
+        {
+            catalog = true;
+        }
+        else
+        {
+            fprintf(stderr, "usage: anim_scan [--dir <path>] [--thumbs] [--catalog]\n");
+            return 2;
+        }
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<unsigned> indices = host_list_animations(dir);
+    int failed = 0;
+    uint64_t total_bytes = 0;
+    std::vector<AnimCatalogEntry> entries;
+    printf("%6s %9s %7s %7s %7s %7s\n", "index", "size", "frames", "ticks", "max", "mean");
+    for (unsigned index : indices)
+    {
+        HostAnimation anim;
+        std::string error;
+        if (!anim.map_from_dir(dir, index, &error))
+        {
+            fprintf(stderr, "A%u: %s\n", index, error.c_str());
+            failed++;
+            continue;
+        }
+        size_t frame_len = (size_t)anim.cols * anim.rows;
+        uint16_t max_value = 0;
+        uint64_t sum = 0;
+        for (int f = 0; f < anim.num_frames; f++)
+        {
+            const uint16_t *pixels = anim.frame(f);
+            for (size_t i = 0; i < frame_len; i++)
+            {
+                sum += pixels[i];
+                if (pixels[i] > max_value)
+                {
+                    max_value = pixels[i];
+                }
+            }
+        }
+        uint64_t count = (uint64_t)frame_len * anim.num_frames;
+        total_bytes += anim_frame_offset(anim.num_frames, anim.cols, anim.rows);
+        printf("%6u %4dx%-4d %7d %7u %7u %7u\n", index, anim.cols, anim.rows, anim.num_frames,
+               anim.get_total_duration(), max_value, count == 0 ? 0 : (unsigned)(sum / count));
+        AnimCatalogEntry entry;
+        if (catalog && anim.make_catalog_entry(index, &entry))
+        {
+            entries.push_back(entry);
+        }
+        if (thumbs && anim.num_frames > 0)
+        {
+            print_thumbnail(anim);
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("%zu animations, %.1f MB of frames, %d failed, %.3f s\n",
+           indices.size() - failed, total_bytes / 1e6, failed, seconds);
+    if (catalog)
+    {
+        std::string error;
+        if (!host_write_catalog(dir, entries, &error))
+        {
+            fprintf(stderr, "%s\n", error.c_str());
+            return 1;
+        }
+        printf("Catalog of %zu animations saved to '%s'\n", entries.size(), (dir + "/" + CATALOG_FILENAME).c_str());
+    }
+    return failed == 0 ? 0 : 1;
+}
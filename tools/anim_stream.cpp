@@ -0,0 +1,383 @@
+/*
+  anim_stream.cpp - renders a scene on the PC and streams the frames to the display
+  Copyright (c) 2019 Simen E. Sørensen.
+
+  Build: g++ -std=c++17 -O2 -pthread -o anim_stream anim_stream.cpp HostScene.cpp HostAnimation.cpp -lutil
+
+  Usage: anim_stream <scene.txt> (--port <device> | --loopback) [--dir <path>] [--loops <n>] [--fps <n>]
+
+  The scene (see HostScene.h) is played tick by tick through three stages, each on its own
+  thread and connected by lock-free single producer/single consumer queues:
+    read      pages in the frames every layer shows at the tick (the files are memory mapped)
+    composite merges the layers into the output frame, exactly like anim_bake
+    transmit  encodes the frame as a key frame or a delta (FrameProtocol.h) and writes it
+  On the display, FrameReceiver decodes the packets.
+
+  --port      writes to a serial device, e.g. /dev/ttyACM0 for the Teensy's USB serial
+  --loopback  writes to a pseudo terminal instead, and decodes the packets on the other end
+              with the same decoder as FrameReceiver. Every received frame is checked against
+              a frame rendered directly from the scene, and the latency from the start of the
+              read stage to the decoded frame is measured.
+  --loops     plays the scene this many times (default 1)
+  --fps       plays this many ticks per second (default 0: as fast as possible)
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fcntl.h>
+#include <poll.h>
+#include <pty.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <termios.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "../FrameProtocol.h"
+#include "HostScene.h"
+#include "SpscQueue.h"
+
+#define STREAM_QUEUE_SIZE 16
+
+typedef std::chrono::steady_clock Clock;
+
+struct StreamFrame
+{
+    int tick = -1; //-1 marks the end of the stream
+    int64_t start_ns = 0;
+    std::vector<uint16_t> pixels;
+};
+
+struct StreamStats
+{
+    uint64_t bytes = 0;
+    int frames = 0;
+    int key_frames = 0;
+    double busy_s[3] = {0, 0, 0}; //Time spent working (not waiting) in each stage
+};
+
+static int64_t now_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+}
+
+static bool set_raw(int fd)
+{
+    struct termios tio;
+    if (tcgetattr(fd, &tio) != 0)
+    {
+        return false;
+    }
+    cfmakeraw(&tio);
+    return tcsetattr(fd, TCSANOW, &tio) == 0;
+}
+
+static bool write_all(int fd, const uint8_t *data, size_t len)
+{
+    while (len > 0)
+    {
+        ssize_t n = write(fd, data, len);
+        if (n < 0)
+        {
+            return false;
+        }
+        data += n;
+        len -= n;
+    }
+    return true;
+}
+
+//Stage 1: touches every frame used at the tick so that the composite stage never waits for the disk
+//Ticks are paced here, at the start of the pipeline, so that the latency is measured from when the tick was due
+static void read_stage(const HostScene &scene, int total_ticks, int fps, SpscQueue<StreamFrame, STREAM_QUEUE_SIZE> *out, StreamStats *stats)
+{
+    volatile uint32_t sink = 0;
+    auto first = Clock::now();
+    for (int t = 0; t <= total_ticks; t++)
+    {
+        StreamFrame item;
+        if (t < total_ticks)
+        {
+            if (fps > 0)
+            {
+                std::this_thread::sleep_until(first + std::chrono::nanoseconds((int64_t)t * 1000000000 / fps));
+            }
+            auto busy = Clock::now();
+            item.tick = t;
+            item.start_ns = now_ns();
+            int tick = t % scene.ticks;
+            for (const HostLayer &layer : scene.layers)
+            {
+                if (tick < (int)layer.frame_at_tick.size())
+                {
+                    const uint16_t *pixels = layer.anim.frame(layer.frame_at_tick[tick]);
+                    size_t len = (size_t)layer.anim.cols * layer.anim.rows;
+                    for (size_t i = 0; i < len; i += 2048) //One read per 4 kB page
+                    {
+                        sink += pixels[i];
+                    }
+                }
+            }
+            stats->busy_s[0] += std::chrono::duration<double>(Clock::now() - busy).count();
+        }
+        out->push(std::move(item));
+    }
+}
+
+//Stage 2: merges the layers into a frame buffer taken from "recycled"
+static void composite_stage(const HostScene &scene, SpscQueue<StreamFrame, STREAM_QUEUE_SIZE> *in,
+                            SpscQueue<StreamFrame, STREAM_QUEUE_SIZE> *out,
+                            SpscQueue<std::vector<uint16_t>, STREAM_QUEUE_SIZE * 2> *recycled, StreamStats *stats)
+{
+    const size_t frame_len = (size_t)scene.cols * scene.rows;
+    while (true)
+    {
+        StreamFrame item;
+        in->pop(&item);
+        if (item.tick >= 0)
+        {
+            auto busy = Clock::now();
+            if (!recycled->try_pop(&item.pixels))
+            {
+                item.pixels.resize(frame_len);
+            }
+            host_render_scene_tick(scene, item.tick % scene.ticks, item.pixels.data());
+            stats->busy_s[1] += std::chrono::duration<double>(Clock::now() - busy).count();
+        }
+        bool end = item.tick < 0;
+        out->push(std::move(item));
+        if (end)
+        {
+            return;
+        }
+    }
+}
+
+//Stage 3: encodes against the previous frame and writes the packet
+static void transmit_stage(const HostScene &scene, int fd, SpscQueue<StreamFrame, STREAM_QUEUE_SIZE> *in,
+                           SpscQueue<std::vector<uint16_t>, STREAM_QUEUE_SIZE * 2> *recycled,
+                           std::atomic<int64_t> *start_by_seq, StreamStats *stats)
+{
+    std::vector<uint16_t> prev;
+    std::vector<uint8_t> packet(FRAME_MAX_PACKET);
+    while (true)
+    {
+        StreamFrame item;
+        in->pop(&item);
+        if (item.tick < 0)
+        {
+            return;
+        }
+        auto busy = Clock::now();
+        uint8_t seq = item.tick & 0xFF;
+        bool key = prev.empty() || item.tick % FRAME_KEY_INTERVAL == 0;
+        int len = frame_encode(item.pixels.data(), key ? nullptr : prev.data(), scene.cols, scene.rows, seq, packet.data());
+        stats->key_frames += packet[2] == FRAME_PACKET_KEY;
+        start_by_seq[seq].store(item.start_ns, std::memory_order_relaxed);
+        if (!write_all(fd, packet.data(), len))
+        {
+            perror("write");
+            exit(1);
+        }
+        stats->bytes += len;
+        stats->frames++;
+        stats->busy_s[2] += std::chrono::duration<double>(Clock::now() - busy).count();
+        //Keep this frame for the next delta and give the old buffer back to the composite stage
+        std::swap(prev, item.pixels);
+        if (!item.pixels.empty())
+        {
+            recycled->try_push(std::move(item.pixels));
+        }
+    }
+}
+
+struct LoopbackResult
+{
+    int frames = 0;
+    int mismatches = 0;
+    uint32_t errors = 0;
+    std::vector<double> latency_ms;
+};
+
+//The display end of --loopback: the same decoder as FrameReceiver, reading from the other side of the pty
+static void receive_stage(const HostScene &scene, int fd, int total_ticks, std::atomic<int64_t> *start_by_seq,
+                          const std::atomic<bool> *sending_done, LoopbackResult *result)
+{
+    FrameDecoder *decoder = new FrameDecoder();
+    std::vector<uint16_t> expected((size_t)scene.cols * scene.rows);
+    uint8_t buf[4096];
+    while (result->frames < total_ticks)
+    {
+        //Give up if nothing has arrived for a while after the last frame was sent (packets were lost)
+        struct pollfd pfd = {fd, POLLIN, 0};
+        if (poll(&pfd, 1, 500) == 0)
+        {
+            if (sending_done->load())
+            {
+                break;
+            }
+            continue;
+        }
+        ssize_t n = read(fd, buf, sizeof(buf));
+        if (n <= 0)
+        {
+            break;
+        }
+        for (ssize_t i = 0; i < n; i++)
+        {
+            if (!frame_decoder_push(decoder, buf[i]))
+            {
+                continue;
+            }
+            int64_t done = now_ns();
+            result->latency_ms.push_back((done - start_by_seq[decoder->seq].load(std::memory_order_relaxed)) / 1e6);
+            host_render_scene_tick(scene, result->frames % scene.ticks, expected.data());
+            if (decoder->cols != scene.cols || decoder->rows != scene.rows ||
+                memcmp(decoder->pixels, expected.data(), expected.size() * sizeof(uint16_t)) != 0)
+            {
+                result->mismatches++;
+            }
+            result->frames++;
+        }
+    }
+    result->errors = decoder->errors;
+    delete decoder;
+}
+
+int main(int argc, char **argv)
+{
+    const char *scene_path = nullptr;
+    const char *port = nullptr;
+    bool loopback = false;
+    std::string dir;
+    int loops = 1;
+    int fps = 0;
+    bool usage = false;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--port") == 0 && i + 1 < argc)
+        {
+            port = argv[++i];
+        }
+        else if (strcmp(argv[i], "--loopback") == 0)
+        {
+            loopback = true;
+        }
+        else if (strcmp(argv[i], "--dir") == 0 && i + 1 < argc)
+        {
+            dir = argv[++i];
+        }
+        else if (strcmp(argv[i], "--loops") == 0 && i + 1 < argc)
+        {
+            loops = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--fps") == 0 && i + 1 < argc)
+        {
+            fps = atoi(argv[++i]);
+        }
+        else if (scene_path == nullptr && argv[i][0] != '-')
+        {
+            scene_path = argv[i];
+        }
+        else
+        {
+            usage = true;
+        }
+    }
+    if (usage || scene_path == nullptr || (port == nullptr) == !loopback || loops < 1)
+    {
+        fprintf(stderr, "usage: %s <scene.txt> (--port <device> | --loopback) [--dir <path>] [--loops <n>] [--fps <n>]\n", argv[0]);
+        return 2;
+    }
+
+    HostScene scene;
+    if (!host_read_scene(scene_path, &scene) || !host_load_scene_layers(dir, &scene))
+    {
+        return 1;
+    }
+    if (scene.ticks == 0 || (size_t)scene.cols * scene.rows > FRAME_MAX_PIXELS || scene.cols > 255 || scene.rows > 255)
+    {
+        fprintf(stderr, "%s: nothing to stream, or the canvas is larger than %d pixels\n", scene_path, FRAME_MAX_PIXELS);
+        return 1;
+    }
+    const int total_ticks = scene.ticks * loops;
+
+    int out_fd;
+    int in_fd = -1;
+    if (loopback)
+    {
+        if (openpty(&out_fd, &in_fd, nullptr, nullptr, nullptr) != 0)
+        {
+            perror("openpty");
+            return 1;
+        }
+        set_raw(in_fd);
+    }
+    else
+    {
+        out_fd = open(port, O_RDWR | O_NOCTTY);
+        if (out_fd < 0)
+        {
+            perror(port);
+            return 1;
+        }
+    }
+    set_raw(out_fd);
+
+    static SpscQueue<StreamFrame, STREAM_QUEUE_SIZE> read_to_composite;
+    static SpscQueue<StreamFrame, STREAM_QUEUE_SIZE> composite_to_transmit;
+    static SpscQueue<std::vector<uint16_t>, STREAM_QUEUE_SIZE * 2> recycled;
+    static std::atomic<int64_t> start_by_seq[256];
+    std::atomic<bool> sending_done(false);
+    StreamStats stats;
+    LoopbackResult received;
+
+    auto start = Clock::now();
+    std::thread receiver;
+    if (loopback)
+    {
+        receiver = std::thread(receive_stage, std::cref(scene), in_fd, total_ticks, start_by_seq, &sending_done, &received);
+    }
+    std::thread reader(read_stage, std::cref(scene), total_ticks, fps, &read_to_composite, &stats);
+    std::thread compositor(composite_stage, std::cref(scene), &read_to_composite, &composite_to_transmit, &recycled, &stats);
+    transmit_stage(scene, out_fd, &composite_to_transmit, &recycled, start_by_seq, &stats);
+    reader.join();
+    compositor.join();
+    sending_done = true;
+    double sent_s = std::chrono::duration<double>(Clock::now() - start).count();
+    if (loopback)
+    {
+        receiver.join();
+    }
+
+    printf("Sent %d frames (%d key frames) in %.3f s: %.0f frames/s, %.1f kB/s, %.1f bytes/frame (key frame: %d bytes)\n",
+           stats.frames, stats.key_frames, sent_s, stats.frames / sent_s, stats.bytes / sent_s / 1000.0,
+           (double)stats.bytes / stats.frames, FRAME_HEADER_SIZE + 2 + scene.cols * scene.rows * 2 + 4);
+    printf("Busy time per stage: read %.3f s, composite %.3f s, transmit %.3f s\n",
+           stats.busy_s[0], stats.busy_s[1], stats.busy_s[2]);
+    int rtn = 0;
+    if (loopback)
+    {
+        std::vector<double> &latency = received.latency_ms;
+        std::sort(latency.begin(), latency.end());
+        double sum = 0;
+        for (double l : latency)
+        {
+            sum += l;
+        }
+        printf("Received %d frames, %d differ from the scene, %u packet errors\n", received.frames, received.mismatches, received.errors);
+        if (!latency.empty())
+        {
+            printf("Latency: mean %.3f ms, p99 %.3f ms, max %.3f ms\n", sum / latency.size(),
+                   latency[latency.size() * 99 / 100], latency.back());
+        }
+        rtn = (received.frames == total_ticks && received.mismatches == 0 && received.errors == 0) ? 0 : 1;
+        close(in_fd);
+    }
+    close(out_fd);
+    return rtn;
+}
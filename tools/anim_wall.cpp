@@ -0,0 +1,257 @@
+/*
+  anim_wall.cpp - renders a scene for a wall of several Fetch panels, one panel per task
+  Copyright (c) 2019 Simen E. Sørensen.
+
+  Build: g++ -std=c++17 -O2 -pthread -o anim_wall anim_wall.cpp HostScene.cpp HostAnimation.cpp
+
+  Usage: anim_wall <scene.txt> --panels <x> <y> [--panel <cols> <rows>] [--dir <path>]
+                   [--threads <n>] [--zigzag] [--out <file>] [--verify] [--scaling]
+
+  The canvas of the scene is set to the size of the wall (panels of 19x10 pixels unless
+  --panel is given). Every panel is a tile of the canvas, placed and packed by WallLayout.h
+  exactly like TiledCanvas does on the display: each tile
+  of each tick is rendered on its own (only the layers that overlap it touch its pixels) and
+  packed the way its panel is mounted, spread over a thread pool.
+  --zigzag     every other row of panels is mounted upside down and chained back, so the
+               chain runs along the bottom row and back along the row above (and so on)
+  --out        writes the packed wall frames, one after the other, in chain order
+  --verify     renders the whole canvas on one thread as well and checks every panel
+  --scaling    renders the wall with 1, 2, 4 ... threads and prints the panel frames per second
+*/
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "HostScene.h"
+#include "ThreadPool.h"
+#include "../WallLayout.h"
+
+struct Wall
+{
+    WallLayout layout = {1, 1, 19, 10};
+    bool zigzag = false;
+
+    int panel_pixels() const { return wall_panel_pixels(layout); }
+    int frame_pixels() const { return panel_pixels() * wall_num_tiles(layout); }
+};
+
+//Copies a tile to where its panel is in the packed frame, turned like TiledCanvas::pack_tile() does
+static void pack_tile(const Wall &wall, int tile, const uint16_t *pixels, uint16_t *packed_frame)
+{
+    int chain_pos = tile;
+    bool upside_down = false;
+    if (wall.zigzag)
+    {
+        chain_pos = wall_zigzag_chain_pos(wall.layout, tile);
+        upside_down = wall_zigzag_upside_down(wall.layout, tile);
+    }
+    wall_pack_tile(wall.layout, pixels, upside_down, upside_down, &packed_frame[chain_pos * wall.panel_pixels()]);
+}
+
+//Renders and packs every tile of every tick into "packed" (ticks wall frames)
+static void render_wall(const HostScene &scene, const Wall &wall, int ticks, std::vector<uint16_t> *packed, ThreadPool *pool)
+{
+    const int num_tiles = wall_num_tiles(wall.layout);
+    packed->assign((size_t)wall.frame_pixels() * ticks, 0);
+    uint16_t *out = packed->data();
+    auto render = [&](int job) {
+        int tick = job / num_tiles;
+        int tile = job % num_tiles;
+        uint16_t pixels[wall.panel_pixels()];
+        host_render_scene_region(scene, tick, wall_tile_x(wall.layout, tile), wall_tile_y(wall.layout, tile),
+                                 wall.layout.panel_cols, wall.layout.panel_rows, pixels);
+        pack_tile(wall, tile, pixels, &out[(size_t)tick * wall.frame_pixels()]);
+    };
+    const int jobs = ticks * num_tiles;
+    if (pool == nullptr)
+    {
+        for (int job = 0; job < jobs; job++)
+        {
+            render(job);
+        }
+        return;
+    }
+    //A single panel is too little work for a task of its own, so every task gets a run of them
+    int chunk = jobs / (int)(pool->get_num_threads() * 8) + 1;
+    pool->parallel_for(0, jobs, chunk, render);
+}
+
+//Renders the whole canvas one tick at a time on one thread, and checks every packed panel against it
+static bool verify_wall(const HostScene &scene, const Wall &wall, int ticks, const std::vector<uint16_t> &packed)
+{
+    std::vector<uint16_t> canvas((size_t)scene.cols * scene.rows);
+    std::vector<uint16_t> tile_pixels(wall.panel_pixels());
+    std::vector<uint16_t> expected(wall.frame_pixels());
+    for (int t = 0; t < ticks; t++)
+    {
+        host_render_scene_tick(scene, t, canvas.data());
+        for (int tile = 0; tile < wall_num_tiles(wall.layout); tile++)
+        {
+            const int tile_x = wall_tile_x(wall.layout, tile);
+            const int tile_y = wall_tile_y(wall.layout, tile);
+            for (int y = 0; y < wall.layout.panel_rows; y++)
+            {
+                memcpy(&tile_pixels[y * wall.layout.panel_cols], &canvas[(tile_y + y) * scene.cols + tile_x],
+                       wall.layout.panel_cols * sizeof(uint16_t));
+            }
+            pack_tile(wall, tile, tile_pixels.data(), expected.data());
+        }
+        if (memcmp(expected.data(), &packed[(size_t)t * wall.frame_pixels()], expected.size() * sizeof(uint16_t)) != 0)
+        {
+            fprintf(stderr, "tick %d differs from the single threaded render\n", t);
+            return false;
+        }
+    }
+    return true;
+}
+
+static double seconds_since(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char **argv)
+{
+    const char *scene_path = nullptr;
+    const char *out_path = nullptr;
+    std::string dir;
+    unsigned threads = 0;
+    bool verify = false;
+    bool scaling = false;
+    Wall wall;
+    bool has_panels = false;
+    bool usage_error = false;
+    for (int i = 1; i < argc && !usage_error; i++)
+    {
+        if (strcmp(argv[i], "--panels") == 0 && i + 2 < argc)
+        {
+            wall.layout.panels_x = atoi(argv[++i]);
+            wall.layout.panels_y = atoi(argv[++i]);
+            has_panels = true;
+        }
+        else if (strcmp(argv[i], "--panel") == 0 && i + 2 < argc)
+        {
+            wall.layout.panel_cols = atoi(argv[++i]);
+            wall.layout.panel_rows = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--dir") == 0 && i + 1 < argc)
+        {
+            dir = argv[++i];
+        }
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+        {
+            threads = (unsigned)atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--out") == 0 && i + 1 < argc)
+        {
+            out_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--zigzag") == 0)
+        {
+            wall.zigzag = true;
+        }
+        else if (strcmp(argv[i], "--verify") == 0)
+        {
+            verify = true;
+        }
+        else if (strcmp(argv[i], "--scaling") == 0)
+        {
+            scaling = true;
+        }
+        else if (scene_path == nullptr && argv[i][0] != '-')
+        {
+            scene_path = argv[i];
+        }
+        else
+        {
+            usage_error = true;
+        }
+    }
+    if (scene_path == nullptr || !has_panels || usage_error)
+    {
+        fprintf(stderr, "usage: %s <scene.txt> --panels <x> <y> [--panel <cols> <rows>] [--dir <path>]\n"
+                        "       [--threads <n>] [--zigzag] [--out <file>] [--verify] [--scaling]\n", argv[0]);
+        return 2;
+    }
+    if (wall.layout.panels_x <= 0 || wall.layout.panels_y <= 0 || wall.layout.panel_cols <= 0 || wall.layout.panel_rows <= 0)
+    {
+        fprintf(stderr, "the number and size of the panels must be positive\n");
+        return 2;
+    }
+
+    HostScene scene;
+    if (!host_read_scene(scene_path, &scene) || !host_load_scene_layers(dir, &scene))
+    {
+        return 1;
+    }
+    scene.cols = wall.layout.panels_x * wall.layout.panel_cols;
+    scene.rows = wall.layout.panels_y * wall.layout.panel_rows;
+    const int ticks = scene.ticks;
+    const int num_tiles = wall_num_tiles(wall.layout);
+
+    ThreadPool pool(threads);
+    std::vector<uint16_t> packed;
+    auto start = std::chrono::steady_clock::now();
+    render_wall(scene, wall, ticks, &packed, &pool);
+    double seconds = seconds_since(start);
+    printf("Rendered %d ticks of a %dx%d wall (%d panels, %dx%d pixels) in %.3f s on %u threads: %.0f panel frames/s\n",
+           ticks, wall.layout.panels_x, wall.layout.panels_y, num_tiles, scene.cols, scene.rows, seconds, pool.get_num_threads(),
+           seconds > 0 ? ticks * num_tiles / seconds : 0.0);
+
+    if (verify)
+    {
+        if (!verify_wall(scene, wall, ticks, packed))
+        {
+            return 1;
+        }
+        printf("Every panel matches the single threaded render of the whole canvas\n");
+    }
+
+    if (scaling)
+    {
+        //The same work on more threads: the panel frames per second should grow with the threads
+        unsigned max_threads = std::thread::hardware_concurrency();
+        double single = 0;
+        printf("%8s %16s %10s\n", "threads", "panel frames/s", "speedup");
+        for (unsigned n = 1; n <= max_threads; n *= 2)
+        {
+            ThreadPool scaling_pool(n);
+            std::vector<uint16_t> output;
+            start = std::chrono::steady_clock::now();
+            int runs = 0;
+            do
+            {
+                render_wall(scene, wall, ticks, &output, &scaling_pool);
+                runs++;
+            } while (seconds_since(start) < 0.5);
+            double rate = (double)runs * ticks * num_tiles / seconds_since(start);
+            if (n == 1)
+            {
+                single = rate;
+            }
+            printf("%8u %16.0f %9.2fx\n", n, rate, rate / single);
+        }
+    }
+
+    if (out_path != nullptr)
+    {
+        FILE *file = fopen(out_path, "wb");
+        if (file == nullptr || fwrite(packed.data(), sizeof(uint16_t), packed.size(), file) != packed.size())
+        {
+            fprintf(stderr, "write to '%s' failed\n", out_path);
+            if (file != nullptr)
+            {
+                fclose(file);
+            }
+            return 1;
+        }
+        fclose(file);
+        printf("Saved %d packed wall frames (%d panels each) to '%s'\n", ticks, num_tiles, out_path);
+    }
+    return 0;
+}